@@ -0,0 +1,89 @@
+#pragma once
+
+#include <stdint.h>
+#include "latency_stats.h"
+
+// 低功耗timelapse的醒着时间统计（与硬件无关，时间由调用方传入，毫秒，允许millis()回绕）
+// 每张照片的周期 = 上一张拍完到这一张拍完，其中light sleep的时间由slept()累加，
+// 其余都算醒着（拍摄、醒来后WiFi重连、SD写入、轮询按键）。按醒着/睡眠的电流估算平均电流和续航
+class AwakeMeter {
+public:
+  void reset(uint32_t nowMs) {
+    cycleStart = nowMs;
+    cycleSleptMs = 0;
+    awakeMs = 0;
+    asleepMs = 0;
+    sleeps = 0;
+    lastAwakeMs = 0;
+    lastReconnectMs = 0;
+    awakePerShot.reset();
+    reconnectTime.reset();
+    cycleReconnectMs = 0;
+  }
+
+  // 一次light sleep结束后调用
+  void slept(uint32_t ms) {
+    cycleSleptMs += ms;
+    sleeps++;
+  }
+
+  // 醒来后WiFi重连结束时调用（重连期间醒着，已包含在这个周期醒着的时间里，这里另外统计）
+  void reconnected(uint32_t ms) {
+    cycleReconnectMs += ms;
+    reconnectTime.add(ms * 1000);
+  }
+
+  // 预计的重连时间：有记录时取平均值，否则为fallbackMs
+  uint32_t expectedReconnectMs(uint32_t fallbackMs) const {
+    return reconnectTime.count ? reconnectTime.averageUs() / 1000 : fallbackMs;
+  }
+
+  // 一张拍完（无论成败）时调用，结算这个周期
+  void shotDone(uint32_t nowMs) {
+    uint32_t cycle = nowMs - cycleStart;
+    uint32_t sleptMs = cycleSleptMs < cycle ? cycleSleptMs : cycle;
+    awakeMs += cycle - sleptMs;
+    asleepMs += sleptMs;
+    lastAwakeMs = cycle - sleptMs;
+    awakePerShot.add(lastAwakeMs * 1000);
+    lastReconnectMs = cycleReconnectMs;
+    cycleStart = nowMs;
+    cycleSleptMs = 0;
+    cycleReconnectMs = 0;
+  }
+
+  // 醒着的时间占比（千分比）
+  uint32_t dutyPermille() const {
+    uint64_t total = awakeMs + asleepMs;
+    return total ? (uint32_t)(awakeMs * 1000 / total) : 1000;
+  }
+
+  // 按醒着awakeMa、睡眠sleepUa估算的平均电流（微安）
+  uint32_t averageCurrentUa(uint32_t awakeMa, uint32_t sleepUa) const {
+    uint64_t total = awakeMs + asleepMs;
+    if (!total) {
+      return awakeMa * 1000;
+    }
+    return (uint32_t)((awakeMs * awakeMa * 1000 + asleepMs * sleepUa) / total);
+  }
+
+  // 估算batteryMah容量的电池能拍多少小时
+  uint32_t batteryHours(uint32_t batteryMah, uint32_t awakeMa, uint32_t sleepUa) const {
+    uint32_t ua = averageCurrentUa(awakeMa, sleepUa);
+    return ua ? (uint32_t)((uint64_t)batteryMah * 1000 / ua) : 0;
+  }
+
+  // 统计信息
+  uint64_t awakeMs = 0;      // 已结算周期里醒着的总时间
+  uint64_t asleepMs = 0;     // 已结算周期里light sleep的总时间
+  uint32_t sleeps = 0;       // light sleep次数
+  uint32_t lastAwakeMs = 0;  // 最近一个周期醒着的时间
+  uint32_t lastReconnectMs = 0; // 最近一个周期里WiFi重连的时间
+  LatencyStats awakePerShot; // 每张照片周期里醒着的时间（微秒）
+  LatencyStats reconnectTime; // 每次醒来后WiFi重连的时间（微秒）
+
+private:
+  uint32_t cycleStart = 0;
+  uint32_t cycleSleptMs = 0;
+  uint32_t cycleReconnectMs = 0;
+};
@@ -0,0 +1,30 @@
+#pragma once
+
+// 相机framesize编号对应的分辨率（esp32-camera的framesize_t定义）
+inline bool framesizeDimensions(int framesize, int& width, int& height) {
+  static const int sizes[][2] = {
+    {96, 96},     // 0
+    {160, 120},   // 1 QQVGA
+    {128, 128},   // 2
+    {176, 144},   // 3 QCIF
+    {240, 176},   // 4 HQVGA
+    {240, 240},   // 5
+    {320, 240},   // 6 QVGA
+    {320, 320},   // 7
+    {400, 296},   // 8 CIF
+    {480, 320},   // 9 HVGA
+    {640, 480},   // 10 VGA
+    {800, 600},   // 11 SVGA
+    {1024, 768},  // 12 XGA
+    {1280, 720},  // 13 HD
+    {1280, 1024}, // 14 SXGA
+    {1600, 1200}, // 15 UXGA
+  };
+
+  if (framesize < 0 || framesize >= (int)(sizeof(sizes) / sizeof(sizes[0]))) {
+    return false;
+  }
+  width = sizes[framesize][0];
+  height = sizes[framesize][1];
+  return true;
+}
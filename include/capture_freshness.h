@@ -0,0 +1,103 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "camera_framesize.h"
+#include "jpeg_utils.h"
+
+// 拍照新鲜度判断结果
+enum CaptureVerdict {
+  CAPTURE_FRESH = 0,    // 确认是新帧
+  CAPTURE_STALE = 1,    // 确认是旧帧（相机缓冲区中的上一帧），需要重新请求
+  CAPTURE_UNKNOWN = 2   // 无法判断（头部不完整等），按新帧处理
+};
+
+// 帧指纹：长度 + 整帧数据的FNV-1a哈希（熵编码数据每帧都不同）
+struct FrameFingerprint {
+  uint32_t size;
+  uint32_t hash;
+};
+
+// 增量计算指纹，数据可以分块到达（边下载边写SD卡时使用）
+class FrameHasher {
+public:
+  void update(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+      hash ^= data[i];
+      hash *= 16777619u;
+    }
+    size += len;
+  }
+
+  FrameFingerprint result() const {
+    FrameFingerprint fp = {size, hash};
+    return fp;
+  }
+
+private:
+  uint32_t size = 0;
+  uint32_t hash = 2166136261u;
+};
+
+inline FrameFingerprint fingerprintFrame(const uint8_t* data, size_t size) {
+  FrameHasher hasher;
+  hasher.update(data, size);
+  return hasher.result();
+}
+
+// 拍照新鲜度检测（与硬件无关）
+// 相机的/api/v1/capture会先返回缓冲区里的旧帧，原来的做法是固定发两次请求并sleep。
+// 这里改为检查返回的帧：分辨率与刚设置的framesize不符，或与上一次拍到的帧完全相同，
+// 才认为是旧帧并重新请求
+class CaptureFreshness {
+public:
+  // 设置期望的framesize（切换分辨率后调用），未知编号时不检查尺寸
+  void expectFramesize(int framesize) {
+    if (!framesizeDimensions(framesize, expectedWidth, expectedHeight)) {
+      expectedWidth = 0;
+      expectedHeight = 0;
+    }
+  }
+
+  // 根据帧开头部分（含SOF）判断分辨率是否符合期望
+  CaptureVerdict checkHeader(const uint8_t* data, size_t len) const {
+    if (expectedWidth == 0) {
+      return CAPTURE_UNKNOWN;
+    }
+    int width, height;
+    if (!parseJpegSize(data, len, width, height)) {
+      return CAPTURE_UNKNOWN;
+    }
+    return (width == expectedWidth && height == expectedHeight) ? CAPTURE_FRESH : CAPTURE_STALE;
+  }
+
+  // 完整帧与上一次接受的帧相同则为旧帧
+  CaptureVerdict checkFrame(const FrameFingerprint& fp) const {
+    if (hasLast && fp.size == last.size && fp.hash == last.hash) {
+      return CAPTURE_STALE;
+    }
+    return CAPTURE_FRESH;
+  }
+
+  // 记录本次接受的帧及其请求次数
+  void accept(const FrameFingerprint& fp, int attempts) {
+    last = fp;
+    hasLast = true;
+    shots++;
+    if (attempts <= 1) {
+      singleRequestShots++;
+    }
+    extraRequests += attempts > 1 ? attempts - 1 : 0;
+  }
+
+  // 统计信息
+  uint32_t shots = 0;               // 成功拍摄数
+  uint32_t singleRequestShots = 0;  // 一次请求即拿到新帧的次数
+  uint32_t extraRequests = 0;       // 因旧帧而追加的请求数
+
+private:
+  int expectedWidth = 0;
+  int expectedHeight = 0;
+  FrameFingerprint last = {0, 0};
+  bool hasLast = false;
+};
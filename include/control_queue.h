@@ -0,0 +1,97 @@
+#pragma once
+
+#include <mutex>
+#include <stdint.h>
+#include <string.h>
+
+#define CONTROL_QUEUE_CAPACITY 8   // 最多同时挂起的不同参数数量
+#define CONTROL_VAR_MAX_LEN 24     // 参数名最大长度（含结尾0）
+
+// 一条待发送的参数更新
+struct ControlUpdate {
+  char var[CONTROL_VAR_MAX_LEN];
+  int value;
+};
+
+// 参数更新队列（与硬件无关）
+// 同一参数尚未发出时再次设置只更新数值（后写覆盖），不新增请求；
+// 发送顺序按参数第一次入队的先后，保证framesize/quality等依赖顺序不变
+class ControlQueue {
+public:
+  // 入队，参数表已满时返回false
+  bool set(const char* var, int value) {
+    std::lock_guard<std::mutex> guard(lock);
+    requested++;
+
+    for (int i = 0; i < count; i++) {
+      if (strcmp(entries[i].var, var) == 0) {
+        entries[i].value = value;
+        coalesced++;
+        return true;
+      }
+    }
+
+    if (count >= CONTROL_QUEUE_CAPACITY) {
+      rejected++;
+      return false;
+    }
+
+    strncpy(entries[count].var, var, CONTROL_VAR_MAX_LEN - 1);
+    entries[count].var[CONTROL_VAR_MAX_LEN - 1] = '\0';
+    entries[count].value = value;
+    count++;
+    return true;
+  }
+
+  // 取出最早入队的更新，发送完成后需调用complete()
+  bool pop(ControlUpdate& out) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (count == 0) {
+      return false;
+    }
+
+    out = entries[0];
+    for (int i = 1; i < count; i++) {
+      entries[i - 1] = entries[i];
+    }
+    count--;
+    inFlight++;
+    issued++;
+    return true;
+  }
+
+  // 标记一条已取出的更新发送结束
+  void complete(bool success) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (inFlight > 0) {
+      inFlight--;
+    }
+    if (!success) {
+      failed++;
+    }
+  }
+
+  // 队列为空且没有正在发送的更新
+  bool idle() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return count == 0 && inFlight == 0;
+  }
+
+  int pending() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return count;
+  }
+
+  // 统计信息
+  uint32_t requested = 0;   // set()调用次数
+  uint32_t coalesced = 0;   // 被合并（未单独发出）的次数
+  uint32_t issued = 0;      // 实际发出的请求数
+  uint32_t failed = 0;      // 发送失败数
+  uint32_t rejected = 0;    // 队列满被拒绝数
+
+private:
+  mutable std::mutex lock;
+  ControlUpdate entries[CONTROL_QUEUE_CAPACITY];
+  int count = 0;
+  int inFlight = 0;
+};
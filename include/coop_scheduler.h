@@ -0,0 +1,206 @@
+#pragma once
+
+#include <stdint.h>
+#include "latency_stats.h"
+
+// 协作式任务调度器（与硬件无关，时钟由调用方注入，微秒，允许回绕）
+// 每个job有优先级（数字小的先运行）、时间预算和周期（0为每轮都运行）。job收到截止时刻，
+// 应在截止前主动返回（例如接收流数据按时间而不是按字节数分段）；超出预算只计数，不会被打断。
+// 每轮runOnce()按优先级运行到期的job，统计每个job的耗时和CPU占比，以及每轮的耗时和最坏情况。
+// 设置了单轮预算时，剩余时间放不下的低优先级job推迟到下一轮（连续推迟不超过一轮，不会饿死）
+#define COOP_MAX_JOBS 8
+
+typedef uint32_t (*CoopClock)();
+// job函数：deadlineUs为本次运行的截止时刻，返回是否做了实际工作
+typedef bool (*CoopJobFn)(void* ctx, uint32_t deadlineUs);
+
+struct CoopJob {
+  const char* name;
+  uint8_t priority;
+  uint32_t budgetUs;
+  uint32_t periodUs;     // 0：每轮都运行
+  CoopJobFn fn;
+  void* ctx;
+  uint32_t nextRunUs;    // 周期job下次到期的时刻
+  bool deferredLast;     // 上一轮因单轮预算被推迟，本轮不再推迟
+
+  // 统计信息（resetStats()清零）
+  uint32_t runs;
+  uint32_t busyRuns;     // 返回true（做了实际工作）的次数
+  uint32_t overruns;     // 超出预算的次数
+  uint32_t deferred;     // 因单轮预算被推迟的次数
+  uint64_t busyUs;       // 累计运行时间
+  uint32_t maxUs;        // 单次最长运行时间
+};
+
+class CoopScheduler {
+public:
+  explicit CoopScheduler(CoopClock clockFn = nullptr) : clock(clockFn) {}
+
+  void setClock(CoopClock clockFn) {
+    clock = clockFn;
+  }
+
+  // 单轮预算（微秒），0为不限制
+  void setIterationBudget(uint32_t us) {
+    iterationBudgetUs = us;
+  }
+
+  // 添加job，返回编号（超过上限返回-1）。运行顺序按优先级，同优先级按添加顺序
+  // 周期job在添加后的第一轮就运行
+  int addJob(const char* name, uint8_t priority, uint32_t budgetUs, uint32_t periodUs,
+             CoopJobFn fn, void* ctx = nullptr) {
+    if (jobCount >= COOP_MAX_JOBS || fn == nullptr) {
+      return -1;
+    }
+    if (jobCount == 0) {
+      lastClockUs = now();
+    }
+    int pos = jobCount;
+    while (pos > 0 && jobs[order[pos - 1]].priority > priority) {
+      order[pos] = order[pos - 1];
+      pos--;
+    }
+    order[pos] = jobCount;
+    CoopJob& job = jobs[jobCount];
+    job.name = name;
+    job.priority = priority;
+    job.budgetUs = budgetUs;
+    job.periodUs = periodUs;
+    job.fn = fn;
+    job.ctx = ctx;
+    job.nextRunUs = now();
+    job.deferredLast = false;
+    clearJobStats(job);
+    return jobCount++;
+  }
+
+  // 运行一轮，返回是否有job做了实际工作（没有时调用方可以让出CPU）
+  bool runOnce() {
+    if (resetRequested) {
+      resetRequested = false;
+      resetStats();
+    }
+
+    uint32_t start = now();
+    wallUs += start - lastClockUs;
+    bool worked = false;
+    bool ranAny = false;
+
+    for (int i = 0; i < jobCount; i++) {
+      CoopJob& job = jobs[order[i]];
+      uint32_t t = now();
+      if (job.periodUs && (int32_t)(t - job.nextRunUs) < 0) {
+        continue;
+      }
+
+      // 剩余的单轮预算放不下这个job：推迟到下一轮（每轮至少运行一个job）
+      if (iterationBudgetUs && ranAny && !job.deferredLast &&
+          (t - start) + job.budgetUs > iterationBudgetUs) {
+        job.deferred++;
+        job.deferredLast = true;
+        continue;
+      }
+      job.deferredLast = false;
+
+      bool didWork = job.fn(job.ctx, t + job.budgetUs);
+      uint32_t end = now();
+      uint32_t us = end - t;
+      ranAny = true;
+      job.runs++;
+      job.busyUs += us;
+      if (us > job.maxUs) {
+        job.maxUs = us;
+      }
+      if (us > job.budgetUs) {
+        job.overruns++;
+      }
+      if (didWork) {
+        job.busyRuns++;
+        worked = true;
+      }
+
+      // 周期job：从计划时刻推进，落后一个周期以上时从现在起算，不连续补跑
+      if (job.periodUs) {
+        job.nextRunUs += job.periodUs;
+        if ((int32_t)(end - job.nextRunUs) >= 0) {
+          job.nextRunUs = end + job.periodUs;
+        }
+      }
+    }
+
+    uint32_t end = now();
+    iterations.add(end - start);
+    if (!worked) {
+      idleIterations++;
+    }
+    wallUs += end - start;
+    lastClockUs = end;
+    return worked;
+  }
+
+  int count() const {
+    return jobCount;
+  }
+
+  const CoopJob& job(int id) const {
+    return jobs[id];
+  }
+
+  // job的CPU占比（千分比）：运行时间 / 统计开始以来的时间（含两轮之间调用方让出CPU的时间）
+  uint32_t sharePermille(int id) const {
+    return wallUs ? (uint32_t)(jobs[id].busyUs * 1000 / wallUs) : 0;
+  }
+
+  // 所有job合计的CPU占比（千分比）
+  uint32_t busyPermille() const {
+    uint64_t busy = 0;
+    for (int i = 0; i < jobCount; i++) {
+      busy += jobs[i].busyUs;
+    }
+    return wallUs ? (uint32_t)(busy * 1000 / wallUs) : 0;
+  }
+
+  // 清零统计，从现在重新计算占比
+  void resetStats() {
+    for (int i = 0; i < jobCount; i++) {
+      clearJobStats(jobs[i]);
+    }
+    iterations.reset();
+    idleIterations = 0;
+    wallUs = 0;
+    lastClockUs = now();
+  }
+
+  // 其他任务读完统计后调用：由运行runOnce()的任务在下一轮开始时清零，避免跨任务改写计数
+  void requestReset() {
+    resetRequested = true;
+  }
+
+  // 统计信息
+  LatencyStats iterations;      // 每轮耗时（maxUs为最坏情况）
+  uint32_t idleIterations = 0;  // 没有job做实际工作的轮数
+  uint64_t wallUs = 0;          // 统计开始以来的时间
+
+private:
+  uint32_t now() const {
+    return clock ? clock() : 0;
+  }
+
+  static void clearJobStats(CoopJob& job) {
+    job.runs = 0;
+    job.busyRuns = 0;
+    job.overruns = 0;
+    job.deferred = 0;
+    job.busyUs = 0;
+    job.maxUs = 0;
+  }
+
+  CoopClock clock;
+  CoopJob jobs[COOP_MAX_JOBS];
+  uint8_t order[COOP_MAX_JOBS];  // 按优先级排好的运行顺序
+  int jobCount = 0;
+  uint32_t iterationBudgetUs = 0;
+  uint32_t lastClockUs = 0;
+  volatile bool resetRequested = false;
+};
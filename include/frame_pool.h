@@ -0,0 +1,103 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+
+// 帧槽：指向池内缓冲区，size为有效JPEG长度，seq为发布序号，stampUs为发布时间戳
+// width/height为SOF中的图像尺寸（生产者发布前填写，0为未知），串流中途切换分辨率时每帧自带尺寸
+struct FrameSlot {
+  uint8_t* data;
+  size_t size;
+  uint32_t seq;
+  uint32_t stampUs;
+  uint16_t width;
+  uint16_t height;
+};
+
+// 三缓冲帧池（单生产者/单消费者，无锁）
+// 生产者（流解析器）直接写入writeSlot()，publish()后与中间槽交换；
+// 消费者（显示）acquire()时与中间槽交换，拿到的始终是最新一帧（latest frame wins）。
+// 两端各自独占一个槽，任何时刻都不会读写同一块内存，因此不会出现帧撕裂，也无需拷贝
+class FramePool {
+public:
+  static const int SLOT_COUNT = 3;
+
+  // storage需至少SLOT_COUNT * slotCapacity字节
+  void init(uint8_t* storage, size_t slotCapacity) {
+    capacity = slotCapacity;
+    for (int i = 0; i < SLOT_COUNT; i++) {
+      slots[i].data = storage + i * slotCapacity;
+      slots[i].size = 0;
+      slots[i].seq = 0;
+      slots[i].stampUs = 0;
+      slots[i].width = 0;
+      slots[i].height = 0;
+    }
+    backIndex = 0;
+    middle.store(1, std::memory_order_relaxed);
+    frontIndex = 2;
+    nextSeq = 0;
+  }
+
+  size_t slotCapacity() const {
+    return capacity;
+  }
+
+  // ---- 生产者端 ----
+
+  // 当前可写入的槽（生产者独占）
+  FrameSlot& writeSlot() {
+    return slots[backIndex];
+  }
+
+  // 发布写入完成的帧，返回新的可写槽
+  FrameSlot& publish(size_t size, uint32_t stampUs = 0) {
+    slots[backIndex].size = size;
+    slots[backIndex].seq = ++nextSeq;
+    slots[backIndex].stampUs = stampUs;
+    uint8_t prev = middle.exchange(backIndex | FRESH_BIT, std::memory_order_acq_rel);
+    if (prev & FRESH_BIT) {
+      // 上一帧还没被显示就被新帧替换
+      framesReplaced++;
+    }
+    backIndex = prev & INDEX_MASK;
+    framesPublished++;
+    return slots[backIndex];
+  }
+
+  // ---- 消费者端 ----
+
+  // 获取最新发布的帧；没有新帧时返回nullptr
+  // 返回的槽在下一次acquire()之前一直有效
+  const FrameSlot* acquire() {
+    if (!(middle.load(std::memory_order_acquire) & FRESH_BIT)) {
+      return nullptr;
+    }
+    uint8_t prev = middle.exchange(frontIndex, std::memory_order_acq_rel);
+    frontIndex = prev & INDEX_MASK;
+    framesConsumed++;
+    return &slots[frontIndex];
+  }
+
+  // 是否有尚未取走的新帧
+  bool hasFresh() const {
+    return middle.load(std::memory_order_acquire) & FRESH_BIT;
+  }
+
+  // 统计信息（各自只由一端写入）
+  uint32_t framesPublished = 0;   // 生产者：发布帧数
+  uint32_t framesReplaced = 0;    // 生产者：未显示即被替换的帧数
+  uint32_t framesConsumed = 0;    // 消费者：取走帧数
+
+private:
+  static const uint8_t FRESH_BIT = 0x80;
+  static const uint8_t INDEX_MASK = 0x03;
+
+  FrameSlot slots[SLOT_COUNT];
+  size_t capacity = 0;
+  uint8_t backIndex = 0;              // 生产者独占
+  uint8_t frontIndex = 2;             // 消费者独占
+  std::atomic<uint8_t> middle{1};     // 共享交换槽（索引 | 新帧标志）
+  uint32_t nextSeq = 0;
+};
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// JPEG辅助函数（与硬件无关）
+
+// 从数据中解析JPEG尺寸
+inline bool parseJpegSize(const uint8_t* data, size_t size, int& width, int& height) {
+  if (size < 2) {
+    return false;
+  }
+
+  // 查找SOF标记 (SOF0或SOF2)
+  for (size_t i = 0; i < size - 1; ++i) {
+    if (data[i] == 0xFF) {
+      uint8_t marker = data[i + 1];
+      if (marker == 0xC0 || marker == 0xC2) {
+        // SOF标记数据格式:
+    // 2字节: 段长度
+    // 1字节: 精度
+    // 2字节: 高度
+    // 2字节: 宽度
+        if (i + 9 >= size) {
+          return false;
+        }
+        height = (data[i + 5] << 8) | data[i + 6];
+        width = (data[i + 7] << 8) | data[i + 8];
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+// 提取完整的JPEG帧（从SOI到EOI）
+inline size_t trimToEOI(uint8_t* data, size_t size) {
+  if (size < 2) {
+    return 0;
+  }
+
+  size_t soiPos = 0;
+  // 查找SOI标记
+  for (; soiPos < size - 1; ++soiPos) {
+    if (data[soiPos] == 0xFF && data[soiPos + 1] == 0xD8) {
+      break;
+    }
+  }
+
+  if (soiPos >= size - 1) {
+    return 0; // SOI未找到
+  }
+
+  size_t eoiPos = soiPos + 2;
+  // 查找EOI标记
+  for (; eoiPos < size - 1; ++eoiPos) {
+    if (data[eoiPos] == 0xFF && data[eoiPos + 1] == 0xD9) {
+      break;
+    }
+  }
+
+  if (eoiPos >= size - 1) {
+    // EOI未找到，丢弃当前帧
+    return 0;
+  }
+
+  // 返回有效的JPEG长度 (从SOI到EOI)
+  return eoiPos - soiPos + 2;
+}
+
+// 分块到达的JPEG数据的SOI/EOI校验（边收边写时使用，不需要缓存整帧）
+// 要求数据以SOI开头，记录最后一个EOI结束的位置
+class JpegStreamCheck {
+public:
+  void feed(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+      uint8_t b = data[i];
+      if (total + i < 2) {
+        // 前两个字节必须是FF D8
+        if (b != (total + i == 0 ? 0xFF : 0xD8)) {
+          badStart = true;
+        }
+      } else if (prevFF && b == 0xD9) {
+        eoiEnd = total + i + 1;
+      }
+      prevFF = (b == 0xFF);
+    }
+    total += len;
+  }
+
+  // 以SOI开头并且出现过EOI
+  bool complete() const {
+    return !badStart && total >= 2 && eoiEnd > 0;
+  }
+
+  size_t bytes() const {
+    return total;
+  }
+
+  // 最后一个EOI之后的多余字节数
+  size_t trailingBytes() const {
+    return eoiEnd > 0 ? total - eoiEnd : total;
+  }
+
+private:
+  size_t total = 0;
+  size_t eoiEnd = 0;
+  bool prevFF = false;
+  bool badStart = false;
+};
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// 延迟统计（微秒），用于帧从发布到显示、解码等耗时
+struct LatencyStats {
+  uint32_t count = 0;
+  uint64_t totalUs = 0;
+  uint32_t maxUs = 0;
+
+  void add(uint32_t us) {
+    count++;
+    totalUs += us;
+    if (us > maxUs) {
+      maxUs = us;
+    }
+  }
+
+  uint32_t averageUs() const {
+    return count ? (uint32_t)(totalUs / count) : 0;
+  }
+
+  void reset() {
+    count = 0;
+    totalUs = 0;
+    maxUs = 0;
+  }
+};
+
+// 延迟直方图（按毫秒分桶），用于控制请求等需要看分布的场景
+// 桶上限：<5、<10、<20、<50、<100、<200、<500、>=500 ms
+struct LatencyHistogram {
+  static const int BUCKET_COUNT = 8;
+
+  static uint32_t bucketLimitMs(int bucket) {
+    static const uint32_t limits[BUCKET_COUNT - 1] = {5, 10, 20, 50, 100, 200, 500};
+    return bucket < BUCKET_COUNT - 1 ? limits[bucket] : UINT32_MAX;
+  }
+
+  uint32_t buckets[BUCKET_COUNT] = {0};
+  LatencyStats stats;
+
+  void add(uint32_t us) {
+    stats.add(us);
+    uint32_t ms = us / 1000;
+    int bucket = 0;
+    while (bucket < BUCKET_COUNT - 1 && ms >= bucketLimitMs(bucket)) {
+      bucket++;
+    }
+    buckets[bucket]++;
+  }
+
+  // 估算百分位（返回所在桶的上限，单位ms；落在最后一个桶时返回最大值）
+  uint32_t percentileMs(uint32_t percent) const {
+    if (stats.count == 0) {
+      return 0;
+    }
+    uint32_t target = (stats.count * percent + 99) / 100;
+    uint32_t seen = 0;
+    for (int i = 0; i < BUCKET_COUNT - 1; i++) {
+      seen += buckets[i];
+      if (seen >= target) {
+        return bucketLimitMs(i);
+      }
+    }
+    return stats.maxUs / 1000;
+  }
+
+  void reset() {
+    for (int i = 0; i < BUCKET_COUNT; i++) {
+      buckets[i] = 0;
+    }
+    stats.reset();
+  }
+};
+
+// 跨任务的延迟统计：一个任务add()，另一个任务take()取走当前窗口并清零，不需要加锁
+// 各字段分别原子交换，窗口边界上的一个样本可能只计入count或total，不会读到写了一半的值
+struct SharedLatencyStats {
+  std::atomic<uint32_t> count{0};
+  std::atomic<uint32_t> totalUs{0};  // 一个统计窗口内的累计（窗口为秒级，不会溢出）
+  std::atomic<uint32_t> maxUs{0};
+
+  void add(uint32_t us) {
+    count.fetch_add(1, std::memory_order_relaxed);
+    totalUs.fetch_add(us, std::memory_order_relaxed);
+    uint32_t seen = maxUs.load(std::memory_order_relaxed);
+    while (us > seen && !maxUs.compare_exchange_weak(seen, us, std::memory_order_relaxed)) {
+    }
+  }
+
+  LatencyStats take() {
+    LatencyStats window;
+    window.count = count.exchange(0, std::memory_order_relaxed);
+    window.totalUs = totalUs.exchange(0, std::memory_order_relaxed);
+    window.maxUs = maxUs.exchange(0, std::memory_order_relaxed);
+    return window;
+  }
+};
@@ -0,0 +1,259 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define AVI_HEADER_SIZE 512          // 文件头（hdrl + JUNK + movi列表头）占一个扇区，第一帧从扇区边界开始
+#define AVI_CHUNK_HEADER_SIZE 8      // 块头：fourcc + 长度
+#define AVI_INDEX_ENTRY_SIZE 16      // idx1每条记录的字节数
+#define AVI_MOVI_FOURCC_OFFSET (AVI_HEADER_SIZE - 4) // 'movi'所在位置，idx1中的偏移量以此为基准
+#define AVI_MIN_FRAME_BYTES (16 * 1024) // 按此估算索引区容量（帧越小索引越先用完）
+
+#define AVIF_HASINDEX 0x10
+#define AVIIF_KEYFRAME 0x10
+
+inline void aviPut16(uint8_t* p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+inline void aviPut32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+inline uint32_t aviGet32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void aviPutChunk(uint8_t* p, const char* fourcc, uint32_t size) {
+  memcpy(p, fourcc, 4);
+  aviPut32(p + 4, size);
+}
+
+// 提交一帧时要写入的内容，按成员顺序写：任意一步之后掉电，文件都还能按RIFF结构解析，
+// 且包含这一步之前提交的所有帧
+struct AviFrameCommit {
+  uint32_t tailOffset;                          // 帧数据之后：补齐字节 + 新的JUNK头（后面的空闲区）
+  uint8_t tail[1 + AVI_CHUNK_HEADER_SIZE];
+  size_t tailLen;
+  uint32_t chunkOffset;                         // 帧块头'00dc'（数据写完、校验通过后才写，覆盖原JUNK头）
+  uint8_t chunk[AVI_CHUNK_HEADER_SIZE];
+  uint32_t entryOffset;                         // 索引项
+  uint8_t entry[AVI_INDEX_ENTRY_SIZE];
+  uint32_t indexOffset;                         // idx1块头（长度加一项）
+  uint8_t index[AVI_CHUNK_HEADER_SIZE];
+  uint8_t header[AVI_HEADER_SIZE];              // 文件头（帧数、movi长度），写在偏移0
+};
+
+// 单文件MJPEG AVI录制（与硬件无关，只负责布局和编码，读写文件由调用方完成）
+// 文件预先分配allocated字节，录制中的布局：
+//   [文件头 512][movi: 00dc帧...][JUNK 空闲区][idx1 索引区（容量固定）][预分配的剩余部分]
+// 每帧只写自己的数据和几个小块头，不创建文件、不更新目录项，也不逐帧分配簇。
+// 索引项逐帧写入文件末尾的固定区域，RIFF长度只覆盖到最后一个索引项，之后的预分配区域被播放器忽略，
+// 所以掉电后文件仍是合法的AVI，包含最后提交的那一帧。
+// 结束时截断到finalSize()，空间允许时先把索引搬到movi之后（见canCompact()）
+class MjpegAviRecorder {
+public:
+  // 开始新文件，allocated太小时返回false
+  bool begin(int frameWidth, int frameHeight, uint32_t microsPerFrame, uint32_t allocated) {
+    width = frameWidth;
+    height = frameHeight;
+    usPerFrame = microsPerFrame;
+    allocatedBytes = allocated;
+    indexCapacity = allocated / AVI_MIN_FRAME_BYTES;
+    indexRegion = allocated - AVI_CHUNK_HEADER_SIZE - indexCapacity * AVI_INDEX_ENTRY_SIZE;
+    moviEnd = AVI_HEADER_SIZE;
+    frames = 0;
+    maxFrameBytes = 0;
+    finished = false;
+    return indexCapacity > 0 && indexRegion >= AVI_HEADER_SIZE + 2 * AVI_CHUNK_HEADER_SIZE;
+  }
+
+  // 新文件要写入的初始内容：文件头、movi之后的JUNK头、空的idx1头
+  void buildInitial(uint8_t header[AVI_HEADER_SIZE], uint8_t gap[AVI_CHUNK_HEADER_SIZE],
+                    uint8_t index[AVI_CHUNK_HEADER_SIZE]) const {
+    buildHeader(header);
+    buildGap(gap);
+    aviPutChunk(index, "idx1", 0);
+  }
+
+  uint32_t frameCount() const {
+    return frames;
+  }
+
+  uint32_t allocated() const {
+    return allocatedBytes;
+  }
+
+  // 下一帧的块头位置，JPEG数据从其后8字节开始写
+  uint32_t nextChunkOffset() const {
+    return moviEnd;
+  }
+
+  uint32_t nextDataOffset() const {
+    return moviEnd + AVI_CHUNK_HEADER_SIZE;
+  }
+
+  // 下一帧JPEG数据最多可写的字节数（要留出补齐字节和JUNK头），索引满时为0
+  size_t frameCapacity() const {
+    if (finished || frames >= indexCapacity) {
+      return 0;
+    }
+    uint32_t reserved = moviEnd + 2 * AVI_CHUNK_HEADER_SIZE + 1;
+    return reserved < indexRegion ? indexRegion - reserved : 0;
+  }
+
+  // 帧数据（size字节，已写在nextDataOffset()）校验通过后提交
+  void commitFrame(uint32_t size, AviFrameCommit& out) {
+    uint32_t chunkOffset = moviEnd;
+    uint32_t padded = size + (size & 1);
+    moviEnd = chunkOffset + AVI_CHUNK_HEADER_SIZE + padded;
+    if (size > maxFrameBytes) {
+      maxFrameBytes = size;
+    }
+
+    out.tailOffset = chunkOffset + AVI_CHUNK_HEADER_SIZE + size;
+    out.tailLen = 0;
+    if (size & 1) {
+      out.tail[out.tailLen++] = 0;
+    }
+    buildGap(out.tail + out.tailLen);
+    out.tailLen += AVI_CHUNK_HEADER_SIZE;
+
+    out.chunkOffset = chunkOffset;
+    aviPutChunk(out.chunk, "00dc", size);
+
+    out.entryOffset = indexRegion + AVI_CHUNK_HEADER_SIZE + frames * AVI_INDEX_ENTRY_SIZE;
+    memcpy(out.entry, "00dc", 4);
+    aviPut32(out.entry + 4, AVIIF_KEYFRAME);
+    aviPut32(out.entry + 8, chunkOffset - AVI_MOVI_FOURCC_OFFSET);
+    aviPut32(out.entry + 12, size);
+
+    frames++;
+    out.indexOffset = indexRegion;
+    aviPutChunk(out.index, "idx1", frames * AVI_INDEX_ENTRY_SIZE);
+    buildHeader(out.header);
+  }
+
+  // idx1块头的位置：录制中在文件末尾的索引区，finish()之后紧跟在movi之后
+  uint32_t indexOffset() const {
+    return finished ? moviEnd : indexRegion;
+  }
+
+  // ---- 结束录制 ----
+  // 录制中的文件本身就是合法的AVI，结束时只需截断到finalSize()去掉预分配的剩余部分。
+  // canCompact()时还可以把索引搬到movi之后，连同空闲区一起去掉，每一步之后文件仍然有效：
+  //   1. 把索引区中的frameCount()项（indexEntriesOffset()起）按顺序拷贝到finalEntriesOffset()
+  //      （目标在原JUNK空闲区内；目标在源之前，逐块先读后写即可）
+  //   2. finish()：先写gap（新索引之后到原索引末尾的JUNK，盖住原idx1头），
+  //      再把idx1头写到indexOffset()，最后写文件头
+  //   3. 截断到finalSize()。截断失败时文件仍然有效，只是保留了预分配的空间
+
+  bool canCompact() const {
+    return !finished &&
+           finalEntriesOffset() + frames * AVI_INDEX_ENTRY_SIZE + AVI_CHUNK_HEADER_SIZE <= indexRegion;
+  }
+
+  uint32_t indexEntriesOffset() const {
+    return indexRegion + AVI_CHUNK_HEADER_SIZE;
+  }
+
+  uint32_t finalEntriesOffset() const {
+    return moviEnd + AVI_CHUNK_HEADER_SIZE;
+  }
+
+  void finish(uint8_t gap[AVI_CHUNK_HEADER_SIZE], uint32_t& gapOffset, uint8_t index[AVI_CHUNK_HEADER_SIZE],
+              uint8_t header[AVI_HEADER_SIZE]) {
+    uint32_t oldEnd = finalSize();
+    finished = true;
+    gapOffset = finalSize();
+    aviPutChunk(gap, "JUNK", oldEnd - gapOffset - AVI_CHUNK_HEADER_SIZE);
+    aviPutChunk(index, "idx1", frames * AVI_INDEX_ENTRY_SIZE);
+    buildHeader(header);
+  }
+
+  // RIFF数据结束的位置（finish()之后即最终文件大小）
+  uint32_t finalSize() const {
+    return indexOffset() + AVI_CHUNK_HEADER_SIZE + frames * AVI_INDEX_ENTRY_SIZE;
+  }
+
+private:
+  // movi之后到索引区之间的JUNK块头
+  void buildGap(uint8_t* out) const {
+    aviPutChunk(out, "JUNK", indexRegion - moviEnd - AVI_CHUNK_HEADER_SIZE);
+  }
+
+  void buildHeader(uint8_t* out) const {
+    memset(out, 0, AVI_HEADER_SIZE);
+    uint32_t fps = usPerFrame ? (1000000 + usPerFrame / 2) / usPerFrame : 1;
+    uint32_t bufferSize = maxFrameBytes ? maxFrameBytes : AVI_MIN_FRAME_BYTES;
+
+    uint8_t* p = out;
+    aviPutChunk(p, "RIFF", finalSize() - AVI_CHUNK_HEADER_SIZE);
+    memcpy(p + 8, "AVI ", 4);
+    p += 12;
+
+    // LIST hdrl：avih(64) + LIST strl(strh 64 + strf 48)
+    aviPutChunk(p, "LIST", 4 + 64 + 12 + 64 + 48);
+    memcpy(p + 8, "hdrl", 4);
+    p += 12;
+
+    aviPutChunk(p, "avih", 56);
+    aviPut32(p + 8, usPerFrame);
+    aviPut32(p + 12, bufferSize * fps);       // dwMaxBytesPerSec
+    aviPut32(p + 20, AVIF_HASINDEX);
+    aviPut32(p + 24, frames);                 // dwTotalFrames
+    aviPut32(p + 32, 1);                      // dwStreams
+    aviPut32(p + 36, bufferSize);             // dwSuggestedBufferSize
+    aviPut32(p + 40, width);
+    aviPut32(p + 44, height);
+    p += 64;
+
+    aviPutChunk(p, "LIST", 4 + 64 + 48);
+    memcpy(p + 8, "strl", 4);
+    p += 12;
+
+    aviPutChunk(p, "strh", 56);
+    memcpy(p + 8, "vids", 4);
+    memcpy(p + 12, "MJPG", 4);
+    aviPut32(p + 28, usPerFrame);             // dwScale
+    aviPut32(p + 32, 1000000);                // dwRate
+    aviPut32(p + 40, frames);                 // dwLength
+    aviPut32(p + 44, bufferSize);
+    aviPut32(p + 48, 0xFFFFFFFFu);            // dwQuality
+    aviPut16(p + 60, (uint16_t)width);        // rcFrame.right
+    aviPut16(p + 62, (uint16_t)height);       // rcFrame.bottom
+    p += 64;
+
+    aviPutChunk(p, "strf", 40);               // BITMAPINFOHEADER
+    aviPut32(p + 8, 40);
+    aviPut32(p + 12, width);
+    aviPut32(p + 16, height);
+    aviPut16(p + 20, 1);                      // biPlanes
+    aviPut16(p + 22, 24);                     // biBitCount
+    memcpy(p + 24, "MJPG", 4);
+    aviPut32(p + 28, (uint32_t)width * height * 3);
+    p += 48;
+
+    // 填充到扇区末尾，movi列表头占最后12字节
+    uint8_t* moviList = out + AVI_HEADER_SIZE - 12;
+    aviPutChunk(p, "JUNK", (uint32_t)(moviList - p - AVI_CHUNK_HEADER_SIZE));
+    aviPutChunk(moviList, "LIST", moviEnd - (AVI_HEADER_SIZE - 4));
+    memcpy(moviList + 8, "movi", 4);
+  }
+
+  int width = 0;
+  int height = 0;
+  uint32_t usPerFrame = 0;
+  uint32_t allocatedBytes = 0;
+  uint32_t indexCapacity = 0;
+  uint32_t indexRegion = 0;
+  uint32_t moviEnd = AVI_HEADER_SIZE;
+  uint32_t frames = 0;
+  uint32_t maxFrameBytes = 0;
+  bool finished = false;
+};
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// MJPEG流分块解析器
+// 与硬件无关：只处理内存中的数据块，不依赖Arduino/WiFi，可在Linux主机上直接编译
+// 使用memchr批量查找0xFF（库实现按字长扫描），只在0xFF之后检查标记字节，
+// 数据块末尾的0xFF会保留为待定状态，与下一块的首字节组合判断SOI/EOI
+class MjpegParser {
+public:
+  MjpegParser() {
+    reset();
+  }
+
+  // 设置帧写入缓冲区，下一个SOI开始写入；传入nullptr时后续帧将被跳过
+  void setBuffer(uint8_t* buffer, size_t capacity) {
+    frameBuffer = buffer;
+    frameCapacity = capacity;
+  }
+
+  // 重置解析状态（流重连后调用），不清除统计计数
+  void reset() {
+    frameIndex = 0;
+    inFrame = false;
+    pendingFF = false;
+    ready = false;
+  }
+
+  // 解析一块数据，返回本次消费的字节数
+  // 检测到完整帧(SOI..EOI)时立即返回，frameReady()为true，
+  // 调用方取走帧并调用consumeFrame()后，再用剩余数据继续调用feed()
+  size_t feed(const uint8_t* data, size_t len) {
+    if (ready) {
+      return 0;
+    }
+
+    size_t i = 0;
+    while (i < len) {
+      // 上一个字节是0xFF：检查当前字节是否为标记
+      if (pendingFF) {
+        uint8_t marker = data[i++];
+        pendingFF = false;
+
+        if (marker == 0xD8) {
+          // 检测到SOI，无条件重新开始一帧，确保缓冲区从SOI开始
+          startFrame();
+          continue;
+        }
+
+        if (!inFrame) {
+          pendingFF = (marker == 0xFF);
+          continue;
+        }
+
+        if (!append(&marker, 1)) {
+          continue;
+        }
+
+        if (marker == 0xD9) {
+          // 检测到EOI，帧完成
+          inFrame = false;
+          ready = true;
+          framesCompleted++;
+          bytesScanned += i;
+          return i;
+        }
+
+        pendingFF = (marker == 0xFF);
+        continue;
+      }
+
+      // 批量查找下一个0xFF
+      const uint8_t* ff = (const uint8_t*)memchr(data + i, 0xFF, len - i);
+      size_t end = ff ? (size_t)(ff - data) + 1 : len;
+
+      // 帧内数据（含0xFF本身）整段拷贝，超长帧在append中被丢弃
+      bool ffDropped = false;
+      if (inFrame) {
+        size_t room = frameCapacity - frameIndex;
+        // 与逐字节解析保持一致：恰好触发溢出的0xFF不参与标记配对
+        ffDropped = !append(data + i, end - i) && (end - i == room);
+      }
+
+      pendingFF = (ff != nullptr) && !ffDropped;
+      i = end;
+    }
+
+    bytesScanned += len;
+    return len;
+  }
+
+  // 是否有完整帧等待取走
+  bool frameReady() const {
+    return ready;
+  }
+
+  uint8_t* frameData() const {
+    return frameBuffer;
+  }
+
+  size_t frameSize() const {
+    return frameIndex;
+  }
+
+  // 确认已取走当前帧，解析器回到等待SOI的状态
+  void consumeFrame() {
+    ready = false;
+    frameIndex = 0;
+  }
+
+  // 统计信息
+  uint64_t bytesScanned = 0;      // 已扫描的字节数
+  uint32_t framesCompleted = 0;   // 完整帧数量
+  uint32_t framesOverflowed = 0;  // 超出缓冲区而丢弃的帧数量
+  uint32_t framesSkipped = 0;     // 无可用缓冲区而跳过的帧数量
+
+private:
+  void startFrame() {
+    frameIndex = 0;
+    if (frameBuffer == nullptr || frameCapacity < 2) {
+      inFrame = false;
+      framesSkipped++;
+      return;
+    }
+    frameBuffer[frameIndex++] = 0xFF;
+    frameBuffer[frameIndex++] = 0xD8;
+    inFrame = true;
+  }
+
+  // 追加帧数据，超出缓冲区时丢弃整帧并返回false
+  bool append(const uint8_t* src, size_t n) {
+    if (frameIndex + n >= frameCapacity) {
+      frameIndex = 0;
+      inFrame = false;
+      pendingFF = false;
+      framesOverflowed++;
+      return false;
+    }
+    memcpy(frameBuffer + frameIndex, src, n);
+    frameIndex += n;
+    return true;
+  }
+
+  uint8_t* frameBuffer = nullptr;
+  size_t frameCapacity = 0;
+  size_t frameIndex = 0;
+  bool inFrame = false;
+  bool pendingFF = false;
+  bool ready = false;
+};
@@ -0,0 +1,371 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include "mjpeg_parser.h"
+
+// multipart/x-mixed-replace MJPEG流读取器
+// 与硬件无关：只处理内存中的数据块，可在Linux主机上直接编译。接口与MjpegParser相同。
+// 从响应头的Content-Type取得boundary，逐个解析part头；有Content-Length的part按长度整段拷贝进帧缓冲，
+// 不再逐字节找FF D8/FF D9；part没有Content-Length（或响应没有boundary）时退回MjpegParser的标记扫描。
+// 响应为Transfer-Encoding: chunked时先去掉分块长度行，分块边界可以落在JPEG数据中间
+#define MULTIPART_BOUNDARY_MAX 76   // "--" + boundary（RFC 2046最长70字符）
+#define MULTIPART_LINE_MAX 128      // part头单行保留的长度（更长的行截断，只用于匹配）
+#define MULTIPART_HEADER_LINES_MAX 32 // part头超过这么多行视为数据错乱，重新找boundary
+
+class MultipartMjpegReader {
+public:
+  MultipartMjpegReader() {
+    reset();
+  }
+
+  // 按响应头配置（连接建立后、第一次feed之前调用）
+  // contentType：响应的Content-Type，取boundary参数；为空或没有boundary时整个流用标记扫描
+  // chunked：响应为Transfer-Encoding: chunked
+  void begin(const char* contentType, bool chunkedEncoding) {
+    delimiter[0] = '\0';
+    delimiterLen = 0;
+    chunked = chunkedEncoding;
+
+    const char* p = contentType ? findParam(contentType, "boundary=") : nullptr;
+    if (p) {
+      if (*p == '"') {
+        p++;
+      }
+      size_t n = 0;
+      while (p[n] && p[n] != '"' && p[n] != ';' && p[n] != ' ' && p[n] != '\r' && p[n] != '\n') {
+        n++;
+      }
+      if (n > 0 && n + 2 < MULTIPART_BOUNDARY_MAX) {
+        delimiter[0] = '-';
+        delimiter[1] = '-';
+        memcpy(delimiter + 2, p, n);
+        delimiterLen = n + 2;
+        delimiter[delimiterLen] = '\0';
+      }
+    }
+    reset();
+  }
+
+  bool hasBoundary() const {
+    return delimiterLen > 0;
+  }
+
+  // 设置帧写入缓冲区；传入nullptr时后续帧将被跳过
+  void setBuffer(uint8_t* buffer, size_t capacity) {
+    frameBuffer = buffer;
+    frameCapacity = capacity;
+    scanner.setBuffer(buffer, capacity);
+  }
+
+  // 重置解析状态（流重连后调用），保留begin()的配置，不清除统计计数
+  void reset() {
+    state = hasBoundary() ? PART_SEEK : PART_SCAN;
+    chunkState = CHUNK_SIZE;
+    chunkRemaining = 0;
+    chunkSizeDigits = false;
+    chunkExtension = false;
+    lineLen = 0;
+    headerLines = 0;
+    partLength = -1;
+    remaining = 0;
+    frameIndex = 0;
+    ready = false;
+    scanner.reset();
+  }
+
+  // 解析一块数据，返回本次消费的字节数
+  // 完整帧就绪时立即返回，frameReady()为true，调用方取走帧并调用consumeFrame()后，再用剩余数据继续调用feed()
+  size_t feed(const uint8_t* data, size_t len) {
+    if (ready) {
+      return 0;
+    }
+
+    size_t i = 0;
+    while (i < len && !ready) {
+      if (!chunked) {
+        i += feedPayload(data + i, len - i);
+        continue;
+      }
+
+      if (chunkState == CHUNK_DATA) {
+        size_t n = len - i < chunkRemaining ? len - i : (size_t)chunkRemaining;
+        size_t used = feedPayload(data + i, n);
+        i += used;
+        chunkRemaining -= used;
+        if (chunkRemaining == 0) {
+          chunkState = CHUNK_SIZE;
+          chunkSizeDigits = false;
+          chunkExtension = false;
+        }
+        continue;
+      }
+
+      if (chunkState == CHUNK_END) {
+        // 最后一个分块（长度0）之后的数据不再属于响应
+        i = len;
+        break;
+      }
+
+      // 分块长度行：十六进制长度[;扩展]\r\n，数据后的\r\n当作空行跳过
+      uint8_t c = data[i++];
+      if (c == '\n') {
+        if (chunkSizeDigits) {
+          chunkState = chunkRemaining ? CHUNK_DATA : CHUNK_END;
+        }
+        chunkSizeDigits = false;
+        chunkExtension = false;
+      } else if (c == ';') {
+        chunkExtension = true;
+      } else if (!chunkExtension) {
+        int v = hexValue(c);
+        if (v >= 0) {
+          if (!chunkSizeDigits) {
+            chunkRemaining = 0;
+            chunkSizeDigits = true;
+          }
+          chunkRemaining = (chunkRemaining << 4) | (uint32_t)v;
+        }
+      }
+    }
+
+    bytesScanned += i;
+    return i;
+  }
+
+  // 是否有完整帧等待取走
+  bool frameReady() const {
+    return ready;
+  }
+
+  uint8_t* frameData() const {
+    return frameBuffer;
+  }
+
+  size_t frameSize() const {
+    return frameIndex;
+  }
+
+  // 确认已取走当前帧
+  void consumeFrame() {
+    ready = false;
+    frameIndex = 0;
+    scanner.consumeFrame();
+  }
+
+  // 统计信息
+  uint64_t bytesScanned = 0;      // 已处理的字节数（含part头和分块长度行）
+  uint64_t bytesMarkerScanned = 0; // 其中走标记扫描的字节数
+  uint32_t framesCompleted = 0;   // 完整帧数量
+  uint32_t framesByLength = 0;    // 其中按Content-Length读取的帧
+  uint32_t framesByScan = 0;      // 其中按FF D8/FF D9扫描得到的帧
+  uint32_t framesOverflowed = 0;  // 超出缓冲区而丢弃的帧数量
+  uint32_t framesSkipped = 0;     // 无可用缓冲区而跳过的帧数量
+  uint32_t partsMalformed = 0;    // part头错乱或内容不是JPEG而丢弃的part
+
+private:
+  enum PartState {
+    PART_SEEK,      // 找boundary行
+    PART_HEADERS,   // 读part头直到空行
+    PART_BODY,      // 按Content-Length拷贝
+    PART_DISCARD,   // 按Content-Length丢弃（放不下或没有缓冲区）
+    PART_SCAN       // 没有长度，标记扫描
+  };
+
+  enum ChunkState {
+    CHUNK_SIZE,
+    CHUNK_DATA,
+    CHUNK_END
+  };
+
+  // 在params中不区分大小写地查找name，返回值的起始位置
+  static const char* findParam(const char* params, const char* name) {
+    size_t n = strlen(name);
+    for (const char* p = params; *p; p++) {
+      if (strncasecmp(p, name, n) == 0) {
+        return p + n;
+      }
+    }
+    return nullptr;
+  }
+
+  static int hexValue(uint8_t c) {
+    if (c >= '0' && c <= '9') {
+      return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+      return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+      return c - 'A' + 10;
+    }
+    return -1;
+  }
+
+  // 处理去掉分块编码之后的数据，返回消费的字节数（帧就绪时可能少于len）
+  size_t feedPayload(const uint8_t* data, size_t len) {
+    switch (state) {
+      case PART_BODY: {
+        size_t n = len < remaining ? len : remaining;
+        memcpy(frameBuffer + frameIndex, data, n);
+        frameIndex += n;
+        remaining -= n;
+        if (remaining == 0) {
+          finishPart();
+        }
+        return n;
+      }
+
+      case PART_DISCARD: {
+        size_t n = len < remaining ? len : remaining;
+        remaining -= n;
+        if (remaining == 0) {
+          state = PART_SEEK;
+        }
+        return n;
+      }
+
+      case PART_SCAN: {
+        uint32_t overflowed = scanner.framesOverflowed;
+        uint32_t skipped = scanner.framesSkipped;
+        size_t used = scanner.feed(data, len);
+        bytesMarkerScanned += used;
+        framesOverflowed += scanner.framesOverflowed - overflowed;
+        framesSkipped += scanner.framesSkipped - skipped;
+        if (scanner.frameReady()) {
+          frameIndex = scanner.frameSize();
+          ready = true;
+          framesCompleted++;
+          framesByScan++;
+          // 有boundary时这一part到此结束，之后回到part头解析
+          if (hasBoundary()) {
+            state = PART_SEEK;
+          }
+        }
+        return used;
+      }
+
+      default:
+        return feedLine(data, len);
+    }
+  }
+
+  // boundary行和part头按行处理（每帧只有几行，用memchr找行尾）
+  size_t feedLine(const uint8_t* data, size_t len) {
+    const uint8_t* nl = (const uint8_t*)memchr(data, '\n', len);
+    size_t take = nl ? (size_t)(nl - data) + 1 : len;
+    size_t keep = nl ? take - 1 : take;
+    if (lineLen + keep > MULTIPART_LINE_MAX - 1) {
+      keep = MULTIPART_LINE_MAX - 1 - lineLen;
+    }
+    memcpy(line + lineLen, data, keep);
+    lineLen += keep;
+    if (!nl) {
+      return take;
+    }
+
+    if (lineLen > 0 && line[lineLen - 1] == '\r') {
+      lineLen--;
+    }
+    line[lineLen] = '\0';
+    handleLine();
+    lineLen = 0;
+    return take;
+  }
+
+  bool isDelimiter() const {
+    if (lineLen >= delimiterLen && memcmp(line, delimiter, delimiterLen) == 0) {
+      return true;
+    }
+    // 有的服务器在Content-Type里写的boundary已经带了"--"，正文中不再重复
+    return delimiterLen > 4 && delimiter[2] == '-' && delimiter[3] == '-' &&
+           lineLen >= delimiterLen - 2 && memcmp(line, delimiter + 2, delimiterLen - 2) == 0;
+  }
+
+  void handleLine() {
+    if (isDelimiter()) {
+      state = PART_HEADERS;
+      partLength = -1;
+      headerLines = 0;
+      return;
+    }
+    if (state != PART_HEADERS) {
+      return;
+    }
+
+    if (lineLen > 0) {
+      if (strncasecmp(line, "Content-Length:", 15) == 0) {
+        char* end = nullptr;
+        unsigned long value = strtoul(line + 15, &end, 10);
+        partLength = end != line + 15 ? (long)value : -1;
+      }
+      if (++headerLines > MULTIPART_HEADER_LINES_MAX) {
+        partsMalformed++;
+        state = PART_SEEK;
+      }
+      return;
+    }
+
+    // 空行：part头结束
+    if (partLength < 0) {
+      scanner.reset();
+      state = PART_SCAN;
+    } else if (frameBuffer == nullptr) {
+      framesSkipped++;
+      startDiscard();
+    } else if ((size_t)partLength >= frameCapacity) {
+      framesOverflowed++;
+      startDiscard();
+    } else if (partLength == 0) {
+      partsMalformed++;
+      state = PART_SEEK;
+    } else {
+      frameIndex = 0;
+      remaining = (size_t)partLength;
+      state = PART_BODY;
+    }
+  }
+
+  void startDiscard() {
+    remaining = (size_t)partLength;
+    state = PART_DISCARD;
+  }
+
+  // 按长度读完一个part：只检查开头的SOI，不扫描内容
+  void finishPart() {
+    state = PART_SEEK;
+    if (frameIndex < 2 || frameBuffer[0] != 0xFF || frameBuffer[1] != 0xD8) {
+      partsMalformed++;
+      frameIndex = 0;
+      return;
+    }
+    ready = true;
+    framesCompleted++;
+    framesByLength++;
+  }
+
+  MjpegParser scanner;
+  char delimiter[MULTIPART_BOUNDARY_MAX + 1];
+  size_t delimiterLen = 0;
+  bool chunked = false;
+
+  PartState state = PART_SCAN;
+  ChunkState chunkState = CHUNK_SIZE;
+  uint32_t chunkRemaining = 0;
+  bool chunkSizeDigits = false;
+  bool chunkExtension = false;
+
+  char line[MULTIPART_LINE_MAX];
+  size_t lineLen = 0;
+  int headerLines = 0;
+  long partLength = -1;
+  size_t remaining = 0;
+
+  uint8_t* frameBuffer = nullptr;
+  size_t frameCapacity = 0;
+  size_t frameIndex = 0;
+  bool ready = false;
+};
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define COUNTER_RECORD_SIZE 16          // 单条计数记录的字节数
+#define COUNTER_RECORD_MAGIC 0x544E4350u // "PCNT"
+
+// CRC-32（IEEE），按位计算，记录只有十几个字节
+inline uint32_t counterCrc32(const uint8_t* data, size_t len) {
+  uint32_t crc = 0xFFFFFFFFu;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+    }
+  }
+  return ~crc;
+}
+
+inline void counterPut32(uint8_t* p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+inline uint32_t counterGet32(const uint8_t* p) {
+  return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// 持久化计数器（与硬件无关，只负责编码和选择记录，读写文件由调用方完成）
+// 记录格式（小端）：magic | generation | value | crc32，共16字节。
+// 两个槽（两个文件）轮流覆盖写入，掉电时最多损坏正在写的那一个，
+// 加载时取CRC正确且generation最大的记录；两个都无效时由调用方扫描目录重建后reset()。
+// 号码在使用前先持久化（reserve），掉电最多留下空号，不会重复使用已占用的号码
+class PersistedCounter {
+public:
+  // 用两个槽的内容加载，都无效时返回false
+  bool load(const uint8_t* slotA, size_t lenA, const uint8_t* slotB, size_t lenB) {
+    uint32_t genA = 0, valueA = 0, genB = 0, valueB = 0;
+    bool okA = decode(slotA, lenA, genA, valueA);
+    bool okB = decode(slotB, lenB, genB, valueB);
+    if (!okA && !okB) {
+      loaded = false;
+      return false;
+    }
+    // generation回绕后差值仍为小正数，按有符号差比较
+    bool useA = okA && (!okB || (int32_t)(genA - genB) > 0);
+    generation = useA ? genA : genB;
+    nextValue = useA ? valueA : valueB;
+    loaded = true;
+    return true;
+  }
+
+  // 扫描重建后设置下一个可用号码（下次reserve时写入）
+  void reset(uint32_t next) {
+    nextValue = next;
+    loaded = true;
+  }
+
+  bool isLoaded() const {
+    return loaded;
+  }
+
+  uint32_t peek() const {
+    return nextValue;
+  }
+
+  // 取一个号码，record为需要写入第slot个槽（0或1）的新记录
+  uint32_t reserve(uint8_t record[COUNTER_RECORD_SIZE], int& slot) {
+    uint32_t value = nextValue;
+    nextValue++;
+    generation++;
+    slot = generation & 1;
+    counterPut32(record, COUNTER_RECORD_MAGIC);
+    counterPut32(record + 4, generation);
+    counterPut32(record + 8, nextValue);
+    counterPut32(record + 12, counterCrc32(record, 12));
+    return value;
+  }
+
+private:
+  static bool decode(const uint8_t* p, size_t len, uint32_t& gen, uint32_t& value) {
+    if (!p || len < COUNTER_RECORD_SIZE || counterGet32(p) != COUNTER_RECORD_MAGIC) {
+      return false;
+    }
+    if (counterGet32(p + 12) != counterCrc32(p, 12)) {
+      return false;
+    }
+    gen = counterGet32(p + 4);
+    value = counterGet32(p + 8);
+    return true;
+  }
+
+  uint32_t generation = 0;
+  uint32_t nextValue = 0;
+  bool loaded = false;
+};
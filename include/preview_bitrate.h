@@ -0,0 +1,260 @@
+#pragma once
+
+#include <stdint.h>
+#include "camera_framesize.h"
+
+// 预览码率自适应（与硬件无关，时间由调用方传入，毫秒，允许millis()回绕）
+// 档位表按开销从低到高排列（framesize + quality），调用方每个统计窗口（约1秒）传入
+// 收到的帧数、字节数、平均解码耗时和RSSI，控制器按目标帧率上下调档：
+//   降档：连续downWindows个窗口帧率低于目标的downFpsPermille，或解码跟不上目标帧率。
+//         按本窗口实测吞吐量和各档每帧字节数估算能达到目标帧率的最高档，一次降到位。
+//   升档：连续upWindows个窗口帧率达到目标的upFpsPermille，RSSI不低于rssiUpMinDbm，
+//         且估算的解码耗时放得下。升档后probeWindows个窗口内又降回来算试探失败，
+//         该档在probeHoldMs内不再尝试，连续失败时等待时间翻倍（最多probeHoldMaxMs），避免来回振荡；
+//         RSSI比失败时高出rssiRecoverDb以上（信号变好）时提前解除。
+// 每档的每帧字节数和解码耗时在该档运行时测得；没到过的档按像素数×(2+quality)从已测的档折算
+#define PREVIEW_MAX_LEVELS 8
+
+struct PreviewLevel {
+  uint8_t framesize;
+  uint8_t quality;  // UnitCamS3的quality档位，数字大画质高、帧大
+};
+
+// 一个统计窗口
+struct PreviewSample {
+  uint32_t windowMs;     // 窗口长度
+  uint32_t frames;       // 收到的完整帧数
+  uint32_t bytes;        // 收到的字节数
+  uint32_t decodeAvgUs;  // 平均解码+绘制耗时（没有解码时为0）
+  int rssi;              // dBm
+};
+
+struct PreviewAdaptConfig {
+  uint32_t targetFps = 20;
+  uint32_t downFpsPermille = 850;       // 低于目标的85%算差窗口
+  uint32_t upFpsPermille = 950;         // 达到目标的95%算好窗口
+  uint32_t decodeHeadroomPermille = 800; // 解码耗时不超过帧间隔的80%
+  uint8_t downWindows = 2;
+  uint8_t upWindows = 3;
+  uint8_t settleWindows = 1;            // 调档后丢弃的窗口（切换中的旧分辨率帧、可能的重连）
+  uint8_t probeWindows = 5;             // 升档后这么多窗口内降回算试探失败
+  uint32_t probeHoldMs = 10000;
+  uint32_t probeHoldMaxMs = 60000;
+  int rssiUpMinDbm = -75;               // 低于这个信号强度不升档
+  int rssiRecoverDb = 6;
+};
+
+class PreviewBitrateController {
+public:
+  void begin(const PreviewLevel* levels, int count, int startLevel, const PreviewAdaptConfig& cfg) {
+    ladder = levels;
+    levelCount = count > PREVIEW_MAX_LEVELS ? PREVIEW_MAX_LEVELS : count;
+    config = cfg;
+    current = startLevel < 0 ? 0 : (startLevel >= levelCount ? levelCount - 1 : startLevel);
+    for (int i = 0; i < PREVIEW_MAX_LEVELS; i++) {
+      bytesPerFrame[i] = 0;
+      decodeUs[i] = 0;
+      holdMs[i] = config.probeHoldMs;
+      blockedUntilMs[i] = 0;
+      blockedRssi[i] = 0;
+      blocked[i] = false;
+    }
+    goodRun = 0;
+    badRun = 0;
+    skipWindows = 0;
+    windowsSinceUp = 0xFF;
+  }
+
+  // 暂停读取（拍照等）后调用：下一个窗口包含暂停时间，丢弃
+  void discardWindow() {
+    if (skipWindows < 1) {
+      skipWindows = 1;
+    }
+  }
+
+  // 传入一个窗口，返回是否换了档位（新档位见level()/currentLevel()）
+  bool update(const PreviewSample& s, uint32_t nowMs) {
+    if (s.windowMs == 0) {
+      return false;
+    }
+    windows++;
+    lastFpsX10 = s.frames * 10000 / s.windowMs;
+    if (skipWindows > 0) {
+      skipWindows--;
+      return false;
+    }
+    if (windowsSinceUp < 0xFF) {
+      windowsSinceUp++;
+      // 在升上来的档位稳定运行超过试探窗口：算成功，这一档的等待时间恢复初始值
+      if (windowsSinceUp > config.probeWindows) {
+        holdMs[current] = config.probeHoldMs;
+        windowsSinceUp = 0xFF;
+      }
+    }
+
+    // 记录本档的实测值
+    if (s.frames > 0) {
+      learn(bytesPerFrame[current], s.bytes / s.frames);
+      if (s.decodeAvgUs > 0) {
+        learn(decodeUs[current], s.decodeAvgUs);
+      }
+    }
+
+    uint32_t frameIntervalUs = 1000000 / config.targetFps;
+    uint32_t fpsX1000 = (uint32_t)((uint64_t)s.frames * 1000000 / s.windowMs);
+    bool decodeBehind = s.decodeAvgUs > frameIntervalUs;
+    bool bad = fpsX1000 < config.targetFps * config.downFpsPermille || decodeBehind;
+    bool good = !decodeBehind && fpsX1000 >= config.targetFps * config.upFpsPermille;
+
+    if (bad) {
+      badWindows++;
+      goodRun = 0;
+      if (++badRun >= config.downWindows && current > 0) {
+        stepDown(s, nowMs);
+        return true;
+      }
+      return false;
+    }
+    badRun = 0;
+    if (!good) {
+      goodRun = 0;
+      return false;
+    }
+
+    if (++goodRun < config.upWindows || current + 1 >= levelCount) {
+      return false;
+    }
+    int next = current + 1;
+    if (s.rssi < config.rssiUpMinDbm) {
+      rssiHeld++;
+      return false;
+    }
+    if (blocked[next] && (int32_t)(nowMs - blockedUntilMs[next]) < 0) {
+      if (s.rssi < blockedRssi[next] + config.rssiRecoverDb) {
+        return false;
+      }
+      holdMs[next] = config.probeHoldMs;
+    }
+    uint32_t nextDecode = estimate(decodeUs, next);
+    if ((uint64_t)nextDecode * 1000 > (uint64_t)frameIntervalUs * config.decodeHeadroomPermille) {
+      decodeHeld++;
+      return false;
+    }
+
+    blocked[next] = false;
+    setLevel(next);
+    windowsSinceUp = 0;
+    stepsUp++;
+    return true;
+  }
+
+  int level() const {
+    return current;
+  }
+
+  int count() const {
+    return levelCount;
+  }
+
+  const PreviewLevel& currentLevel() const {
+    return ladder[current];
+  }
+
+  // 估算的每帧字节数（没有数据时为0）
+  uint32_t estimatedBytesPerFrame(int lvl) const {
+    return estimate(bytesPerFrame, lvl);
+  }
+
+  // 统计信息
+  uint32_t windows = 0;        // 收到的窗口数
+  uint32_t badWindows = 0;     // 帧率不足或解码跟不上的窗口数
+  uint32_t stepsUp = 0;
+  uint32_t stepsDown = 0;
+  uint32_t failedProbes = 0;   // 升档后很快又降回来的次数
+  uint32_t rssiHeld = 0;       // 因RSSI太低没有升档的次数
+  uint32_t decodeHeld = 0;     // 因估算解码耗时放不下没有升档的次数
+  uint32_t lastFpsX10 = 0;     // 最近一个窗口的帧率×10
+
+private:
+  static void learn(uint32_t& value, uint32_t sample) {
+    value = value ? (value * 3 + sample) / 4 : sample;
+  }
+
+  // 档位的相对开销：像素数×(2+quality)
+  uint64_t cost(int lvl) const {
+    int width = 0, height = 0;
+    framesizeDimensions(ladder[lvl].framesize, width, height);
+    return (uint64_t)width * height * (2 + ladder[lvl].quality);
+  }
+
+  // 取实测值，没有时从最近的已测档位按开销折算
+  uint32_t estimate(const uint32_t* measured, int lvl) const {
+    if (measured[lvl]) {
+      return measured[lvl];
+    }
+    for (int d = 1; d < levelCount; d++) {
+      int lower = lvl - d;
+      int upper = lvl + d;
+      if (lower >= 0 && measured[lower] && cost(lower)) {
+        return (uint32_t)(measured[lower] * cost(lvl) / cost(lower));
+      }
+      if (upper < levelCount && measured[upper] && cost(upper)) {
+        return (uint32_t)(measured[upper] * cost(lvl) / cost(upper));
+      }
+    }
+    return 0;
+  }
+
+  void stepDown(const PreviewSample& s, uint32_t nowMs) {
+    // 升档后很快降回：这一档暂停试探，连续失败等待翻倍
+    if (windowsSinceUp != 0xFF) {
+      failedProbes++;
+      blocked[current] = true;
+      blockedUntilMs[current] = nowMs + holdMs[current];
+      blockedRssi[current] = s.rssi;
+      holdMs[current] *= 2;
+      if (holdMs[current] > config.probeHoldMaxMs) {
+        holdMs[current] = config.probeHoldMaxMs;
+      }
+    }
+
+    // 按实测吞吐量找能达到目标帧率的最高档（至少降一档）
+    uint64_t bytesPerSec = (uint64_t)s.bytes * 1000 / s.windowMs;
+    uint32_t frameIntervalUs = 1000000 / config.targetFps;
+    int next = current - 1;
+    while (next > 0) {
+      uint64_t need = (uint64_t)estimate(bytesPerFrame, next) * config.targetFps;
+      uint32_t decode = estimate(decodeUs, next);
+      if (need <= bytesPerSec &&
+          (uint64_t)decode * 1000 <= (uint64_t)frameIntervalUs * config.decodeHeadroomPermille) {
+        break;
+      }
+      next--;
+    }
+    setLevel(next);
+    windowsSinceUp = 0xFF;
+    stepsDown++;
+  }
+
+  void setLevel(int lvl) {
+    current = lvl;
+    goodRun = 0;
+    badRun = 0;
+    skipWindows = config.settleWindows;
+  }
+
+  const PreviewLevel* ladder = nullptr;
+  int levelCount = 0;
+  int current = 0;
+  PreviewAdaptConfig config;
+  uint32_t bytesPerFrame[PREVIEW_MAX_LEVELS] = {0};
+  uint32_t decodeUs[PREVIEW_MAX_LEVELS] = {0};
+  uint32_t holdMs[PREVIEW_MAX_LEVELS] = {0};
+  uint32_t blockedUntilMs[PREVIEW_MAX_LEVELS] = {0};
+  int blockedRssi[PREVIEW_MAX_LEVELS] = {0};
+  bool blocked[PREVIEW_MAX_LEVELS] = {false};
+  uint8_t goodRun = 0;
+  uint8_t badRun = 0;
+  uint8_t skipWindows = 0;
+  uint8_t windowsSinceUp = 0xFF;  // 升档后的窗口数，0xFF为不在试探中
+};
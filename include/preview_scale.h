@@ -0,0 +1,49 @@
+#pragma once
+
+// 预览显示模式
+enum PreviewMode {
+  PREVIEW_MODE_FIT = 0,   // 按1/2、1/4、1/8缩小解码，完整视野放入屏幕
+  PREVIEW_MODE_CROP = 1   // 选择仍能铺满屏幕的最小缩放，居中裁切
+};
+
+// 预览摆放参数：scale为解码缩放分母(1/2/4/8)，x/y为左上角（可为负，表示居中裁切）
+struct PreviewPlacement {
+  int scale;
+  int x;
+  int y;
+  int width;
+  int height;
+};
+
+// 根据JPEG尺寸计算缩放解码比例和显示位置（与硬件无关）
+inline PreviewPlacement computePreviewPlacement(int imgWidth, int imgHeight,
+                                                int screenWidth, int screenHeight,
+                                                PreviewMode mode) {
+  PreviewPlacement p;
+  p.scale = 1;
+
+  for (int s = 1; s <= 8; s <<= 1) {
+    int w = (imgWidth + s - 1) / s;
+    int h = (imgHeight + s - 1) / s;
+
+    if (mode == PREVIEW_MODE_FIT) {
+      // 取第一个能完整放入屏幕的比例，都放不下则用1/8
+      p.scale = s;
+      if (w <= screenWidth && h <= screenHeight) {
+        break;
+      }
+    } else {
+      // 取最后一个仍能铺满屏幕的比例
+      if (w < screenWidth || h < screenHeight) {
+        break;
+      }
+      p.scale = s;
+    }
+  }
+
+  p.width = (imgWidth + p.scale - 1) / p.scale;
+  p.height = (imgHeight + p.scale - 1) / p.scale;
+  p.x = (screenWidth - p.width) / 2;
+  p.y = (screenHeight - p.height) / 2;
+  return p;
+}
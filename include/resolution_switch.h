@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include "camera_framesize.h"
+#include "latency_stats.h"
+
+// 串流分辨率切换跟踪（与硬件无关，时间由调用方传入，毫秒，允许millis()回绕）
+// 发出framesize控制命令时调用request()，之后每帧按SOF解析出的尺寸调用frame()，
+// 尺寸与新framesize一致的第一帧即切换完成，记录 控制请求到第一帧新分辨率 的延迟。
+// 串流保持不断开时为在线切换；期间重连过（切换前主动断开、或看门狗判定卡住）的计入重连切换。
+// 超过timeoutMs仍然只有旧分辨率的帧，由调用方重连串流
+class ResolutionSwitch {
+public:
+  // 发出framesize控制命令（未知编号时不跟踪）
+  void request(int framesize, uint32_t nowMs) {
+    int width, height;
+    if (!framesizeDimensions(framesize, width, height)) {
+      pending = false;
+      return;
+    }
+    expectedWidth = width;
+    expectedHeight = height;
+    requestMs = nowMs;
+    pending = true;
+    reconnected = false;
+    fallbackDone = false;
+    requests++;
+  }
+
+  // 切换期间串流重新连接过
+  void noteReconnect() {
+    if (pending) {
+      reconnected = true;
+    }
+  }
+
+  // 一帧的尺寸（解析失败时传0），返回这一帧是否完成了切换
+  bool frame(int width, int height, uint32_t nowMs) {
+    if (width > 0) {
+      currentWidth = width;
+      currentHeight = height;
+    }
+    if (!pending) {
+      return false;
+    }
+    if (width != expectedWidth || height != expectedHeight) {
+      oldFrames++;
+      return false;
+    }
+    pending = false;
+    lastLatencyMs = nowMs - requestMs;
+    lastWasLive = !reconnected;
+    if (lastWasLive) {
+      liveLatency.add(lastLatencyMs * 1000);
+    } else {
+      reconnectLatency.add(lastLatencyMs * 1000);
+    }
+    return true;
+  }
+
+  // 请求后超过timeoutMs仍未出现新分辨率的帧（每次请求只返回一次true）
+  bool timedOut(uint32_t nowMs, uint32_t timeoutMs) {
+    if (!pending || fallbackDone || nowMs - requestMs < timeoutMs) {
+      return false;
+    }
+    fallbackDone = true;
+    fallbacks++;
+    return true;
+  }
+
+  bool isPending() const {
+    return pending;
+  }
+
+  // 最近一帧的尺寸
+  int width() const {
+    return currentWidth;
+  }
+
+  int height() const {
+    return currentHeight;
+  }
+
+  // 统计信息
+  uint32_t requests = 0;          // 跟踪的切换次数
+  uint32_t oldFrames = 0;         // 切换请求之后仍收到的旧分辨率帧数
+  uint32_t fallbacks = 0;         // 超时后由调用方重连的次数
+  uint32_t lastLatencyMs = 0;     // 最近一次切换的延迟
+  bool lastWasLive = false;       // 最近一次切换是否没有重连
+  LatencyStats liveLatency;       // 在线切换：控制请求到第一帧新分辨率（微秒）
+  LatencyStats reconnectLatency;  // 重连切换：控制请求到第一帧新分辨率（微秒）
+
+private:
+  bool pending = false;
+  bool reconnected = false;
+  bool fallbackDone = false;
+  int expectedWidth = 0;
+  int expectedHeight = 0;
+  int currentWidth = 0;
+  int currentHeight = 0;
+  uint32_t requestMs = 0;
+};
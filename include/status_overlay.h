@@ -0,0 +1,163 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+
+// 状态文字叠加层（与硬件无关，绘制由调用方的painter完成）
+// 每个字段是屏幕上固定的矩形，只有文字变化、到期清除或被画面覆盖的字段才需要重画，
+// 避免每次刷新都把所有文字和背景推送到LCD
+#define OVERLAY_MAX_FIELDS 8
+#define OVERLAY_TEXT_MAX 64
+
+enum OverlayAlign {
+  OVERLAY_ALIGN_LEFT = 0,
+  OVERLAY_ALIGN_RIGHT = 1
+};
+
+struct OverlayField {
+  int16_t x;
+  int16_t y;
+  int16_t w;
+  int16_t h;
+  uint8_t align;
+  bool dirty;
+  bool timed;         // 到expireMs自动清空
+  uint32_t expireMs;
+  char text[OVERLAY_TEXT_MAX];
+};
+
+class StatusOverlay {
+public:
+  // 清空所有字段定义
+  void reset() {
+    fieldCount = 0;
+  }
+
+  // 定义一个字段，返回编号（超过上限返回-1）
+  int addField(int x, int y, int w, int h, OverlayAlign align = OVERLAY_ALIGN_LEFT) {
+    if (fieldCount >= OVERLAY_MAX_FIELDS) {
+      return -1;
+    }
+    OverlayField& f = fields[fieldCount];
+    f.x = x;
+    f.y = y;
+    f.w = w;
+    f.h = h;
+    f.align = align;
+    f.dirty = true;
+    f.timed = false;
+    f.expireMs = 0;
+    f.text[0] = '\0';
+    return fieldCount++;
+  }
+
+  // 设置文字，只有内容变化时才标记为需要重画
+  void set(int id, const char* text) {
+    if (!valid(id)) {
+      return;
+    }
+    OverlayField& f = fields[id];
+    f.timed = false;
+    if (strncmp(f.text, text, OVERLAY_TEXT_MAX - 1) != 0) {
+      strncpy(f.text, text, OVERLAY_TEXT_MAX - 1);
+      f.text[OVERLAY_TEXT_MAX - 1] = '\0';
+      f.dirty = true;
+    }
+  }
+
+  void setf(int id, const char* fmt, ...) {
+    char text[OVERLAY_TEXT_MAX];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    set(id, text);
+  }
+
+  // 显示一段时间后自动清空（提示信息）
+  void showFor(int id, const char* text, uint32_t nowMs, uint32_t durationMs) {
+    if (!valid(id)) {
+      return;
+    }
+    set(id, text);
+    fields[id].timed = true;
+    fields[id].expireMs = nowMs + durationMs;
+  }
+
+  // 清空到期的提示，需要重画（用背景盖掉）
+  void expire(uint32_t nowMs) {
+    for (int i = 0; i < fieldCount; i++) {
+      OverlayField& f = fields[i];
+      if (f.timed && (int32_t)(nowMs - f.expireMs) >= 0) {
+        f.timed = false;
+        f.text[0] = '\0';
+        f.dirty = true;
+      }
+    }
+  }
+
+  // 矩形区域被其他内容（一帧预览画面）覆盖：与之相交、且有文字的字段需要重画
+  void invalidateRect(int x, int y, int w, int h) {
+    for (int i = 0; i < fieldCount; i++) {
+      OverlayField& f = fields[i];
+      if (f.text[0] && f.x < x + w && x < f.x + f.w && f.y < y + h && y < f.y + f.h) {
+        f.dirty = true;
+      }
+    }
+  }
+
+  // 整屏被清空或重画（唤醒屏幕、切换界面）
+  void invalidateAll() {
+    for (int i = 0; i < fieldCount; i++) {
+      fields[i].dirty = true;
+    }
+  }
+
+  int count() const {
+    return fieldCount;
+  }
+
+  bool dirty() const {
+    for (int i = 0; i < fieldCount; i++) {
+      if (fields[i].dirty) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  // 重画需要重画的字段：painter(const OverlayField&)负责用背景填充矩形并绘制文字（文字为空时只填充）
+  // 返回重画的字段数
+  template <typename Painter>
+  int paint(Painter&& painter) {
+    int painted = 0;
+    for (int i = 0; i < fieldCount; i++) {
+      OverlayField& f = fields[i];
+      if (!f.dirty) {
+        continue;
+      }
+      painter(f);
+      f.dirty = false;
+      painted++;
+      paintedPixels += (uint32_t)f.w * f.h;
+    }
+    paintedFields += painted;
+    paintCalls++;
+    return painted;
+  }
+
+  // 统计信息
+  uint32_t paintCalls = 0;      // paint()调用次数
+  uint32_t paintedFields = 0;   // 实际重画的字段数
+  uint32_t paintedPixels = 0;   // 重画的像素数（每像素2字节送往LCD，不含文字本身）
+
+private:
+  bool valid(int id) const {
+    return id >= 0 && id < fieldCount;
+  }
+
+  OverlayField fields[OVERLAY_MAX_FIELDS];
+  int fieldCount = 0;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+#include "latency_stats.h"
+
+// 状态栏遥测缓存（与硬件无关，采样由调用方执行，时间单位毫秒，允许millis()回绕）
+// SD卡剩余空间的查询要遍历FAT，只按慢周期完整采样；两次采样之间按写入任务报告的文件长度变化增减。
+// 电量读ADC并换算，同样按周期采样。界面每帧只读缓存值
+class StatusTelemetry {
+public:
+  void begin(uint32_t freeSpacePeriodMs, uint32_t batteryPeriodMs) {
+    freePeriod = freeSpacePeriodMs;
+    batteryPeriod = batteryPeriodMs;
+    freeValid = false;
+    batteryValid = false;
+  }
+
+  // 删除、截断文件等会释放空间的操作之后调用，下次立即重新采样
+  void invalidateFreeSpace() {
+    freeValid = false;
+  }
+
+  bool freeSpaceDue(uint32_t nowMs) const {
+    return !freeValid || nowMs - freeSampledMs >= freePeriod;
+  }
+
+  // 完整采样的结果，costUs为查询耗时
+  void setFreeSpace(uint64_t bytes, uint32_t nowMs, uint32_t costUs) {
+    sampledFree = bytes;
+    grownAtSample = grown;
+    freeSampledMs = nowMs;
+    freeValid = true;
+    freeSpaceCost.add(costUs);
+  }
+
+  // 文件长度变化了bytes字节，截断时为负（只由写入任务调用；loop只读，32位读写是原子的）
+  void noteGrowth(int32_t bytes) {
+    grown = grown + (uint32_t)bytes;
+  }
+
+  // 上次采样减去之后文件长度的净增长（不计簇对齐，下次采样时校正）
+  uint64_t freeSpace() const {
+    int32_t since = (int32_t)(grown - grownAtSample);
+    if (since < 0) {
+      return sampledFree + (uint32_t)-since;
+    }
+    return (uint64_t)since < sampledFree ? sampledFree - since : 0;
+  }
+
+  bool batteryDue(uint32_t nowMs) const {
+    return !batteryValid || nowMs - batterySampledMs >= batteryPeriod;
+  }
+
+  void setBattery(int percent, uint32_t nowMs, uint32_t costUs) {
+    batteryPercent = percent;
+    batterySampledMs = nowMs;
+    batteryValid = true;
+    batteryCost.add(costUs);
+  }
+
+  int battery() const {
+    return batteryPercent;
+  }
+
+  // 统计信息（每次完整采样的耗时，微秒）
+  LatencyStats freeSpaceCost;
+  LatencyStats batteryCost;
+
+private:
+  uint32_t freePeriod = 60000;
+  uint32_t batteryPeriod = 10000;
+  bool freeValid = false;
+  bool batteryValid = false;
+  uint64_t sampledFree = 0;
+  uint32_t freeSampledMs = 0;
+  uint32_t grownAtSample = 0;
+  volatile uint32_t grown = 0;   // 净增长，按32位回绕计算差值
+  int batteryPercent = 0;
+  uint32_t batterySampledMs = 0;
+};
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+
+// 流水线工作者标识（位掩码）
+#define PIPELINE_WORKER_INGEST 0x01  // 网络接收+解析
+#define PIPELINE_WORKER_DECODE 0x02  // JPEG解码+显示
+#define PIPELINE_WORKERS_ALL (PIPELINE_WORKER_INGEST | PIPELINE_WORKER_DECODE)
+
+// 流水线暂停闸门（与硬件无关，只依赖std::atomic）
+// UI端requestPause()后等待isPaused()，之后即可独占网络流和屏幕；
+// 工作者每轮开始调用enter()，返回false表示应当停驻等待。
+// 工作者先清除自己的停驻位再读取暂停请求，保证UI看到停驻位时工作者确实没有在执行
+class PipelineGate {
+public:
+  // ---- UI端 ----
+
+  void requestPause() {
+    pauseRequested.store(true);
+  }
+
+  void resume() {
+    pauseRequested.store(false);
+  }
+
+  bool isPauseRequested() const {
+    return pauseRequested.load();
+  }
+
+  // mask中的工作者是否都已停驻
+  bool isPaused(uint8_t mask) const {
+    return (parkedMask.load() & mask) == mask;
+  }
+
+  // ---- 工作者端 ----
+
+  // 每轮工作前调用，返回true表示可以继续执行
+  bool enter(uint8_t worker) {
+    parkedMask.fetch_and((uint8_t)~worker);
+    if (pauseRequested.load()) {
+      parkedMask.fetch_or(worker);
+      return false;
+    }
+    return true;
+  }
+
+private:
+  std::atomic<bool> pauseRequested{false};
+  std::atomic<uint8_t> parkedMask{0};
+};
@@ -0,0 +1,170 @@
+#pragma once
+
+#include <stdint.h>
+#include "latency_stats.h"
+
+// 串流卡住检测与重连退避（与硬件无关，时间由调用方传入，毫秒，允许millis()回绕）
+// 连接建立后超过stallMs没有完整的帧即判定卡住（连接还在但不再发数据，或只有数据解析不出帧），
+// 调用方断开后按退避时间重连：画面正常时断开的第一次立即重连，之后连接失败或重连后仍然卡住，
+// 等待时间从backoffMinMs开始每次翻倍，最多backoffMaxMs；收到一帧后退避清零。
+// 统计卡住次数、从判定卡住到恢复出帧的时间，以及画面冻结（最后一帧到恢复后第一帧）的最长时间
+class StreamWatchdog {
+public:
+  void begin(uint32_t stallTimeoutMs, uint32_t minBackoffMs, uint32_t maxBackoffMs) {
+    stallMs = stallTimeoutMs;
+    backoffMinMs = minBackoffMs;
+    backoffMaxMs = maxBackoffMs;
+    streaming = false;
+    recovering = false;
+    backoffMs = 0;
+    nextAttemptMs = 0;
+  }
+
+  // 连接建立（收到200响应）
+  void connected(uint32_t nowMs) {
+    streaming = true;
+    lastProgressMs = nowMs;
+    bytesSinceFrame = 0;
+    connects++;
+  }
+
+  // 读到数据（不算进度，只用于区分卡住时是否还有数据）
+  void noteBytes(uint32_t bytes) {
+    bytesSinceFrame += bytes;
+  }
+
+  // 完整的一帧
+  void noteFrame(uint32_t nowMs) {
+    lastProgressMs = nowMs;
+    lastFrameMs = nowMs;
+    hasFrame = true;
+    bytesSinceFrame = 0;
+    backoffMs = 0;
+    if (recovering) {
+      recovering = false;
+      recoverTime.add((nowMs - stallDeclaredMs) * 1000);
+      uint32_t freeze = nowMs - freezeStartMs;
+      lastFreezeMs = freeze;
+      if (freeze > longestFreezeMs) {
+        longestFreezeMs = freeze;
+      }
+    }
+  }
+
+  // 连接中超过stallMs没有新帧
+  bool stalled(uint32_t nowMs) const {
+    return streaming && nowMs - lastProgressMs >= stallMs;
+  }
+
+  // 调用方断开了卡住的连接
+  void stallDetected(uint32_t nowMs) {
+    stalls++;
+    if (bytesSinceFrame > 0) {
+      stallsWithData++;
+    }
+    lost(nowMs);
+  }
+
+  // 对方关闭了连接
+  void dropped(uint32_t nowMs) {
+    drops++;
+    lost(nowMs);
+  }
+
+  // 连接失败（连不上或响应不是200）
+  void connectFailed(uint32_t nowMs) {
+    connectFailures++;
+    streaming = false;
+    if (!recovering) {
+      startFreeze(nowMs);
+    }
+    scheduleRetry(nowMs);
+  }
+
+  // 主动重连（切换分辨率等），settleMs后再连接，不计入卡住统计；之后若卡住，冻结时间从这里算起
+  void restart(uint32_t nowMs, uint32_t settleMs) {
+    streaming = false;
+    recovering = false;
+    backoffMs = 0;
+    nextAttemptMs = nowMs + settleMs;
+    lastFrameMs = nowMs;
+    hasFrame = true;
+  }
+
+  // 调用方暂停读取（例如UI独占屏幕）后恢复：暂停期间不算卡住
+  void resumed(uint32_t nowMs) {
+    lastProgressMs = nowMs;
+  }
+
+  bool isStreaming() const {
+    return streaming;
+  }
+
+  // 未连接时是否到了重连时刻
+  bool retryDue(uint32_t nowMs) const {
+    return !streaming && (int32_t)(nowMs - nextAttemptMs) >= 0;
+  }
+
+  uint32_t msUntilRetry(uint32_t nowMs) const {
+    if (streaming || (int32_t)(nowMs - nextAttemptMs) >= 0) {
+      return 0;
+    }
+    return nextAttemptMs - nowMs;
+  }
+
+  // 下一次失败后将等待的时间
+  uint32_t currentBackoffMs() const {
+    return backoffMs;
+  }
+
+  // 统计信息
+  uint32_t connects = 0;         // 建立连接次数
+  uint32_t stalls = 0;           // 判定卡住的次数
+  uint32_t stallsWithData = 0;   // 其中仍有数据但解析不出帧的次数
+  uint32_t drops = 0;            // 对方关闭连接的次数
+  uint32_t connectFailures = 0;  // 连接失败次数
+  uint32_t lastFreezeMs = 0;     // 最近一次画面冻结的时间
+  uint32_t longestFreezeMs = 0;  // 画面冻结的最长时间
+  LatencyStats recoverTime;      // 判定卡住（或断开）到恢复出帧的时间（微秒）
+
+private:
+  void lost(uint32_t nowMs) {
+    streaming = false;
+    if (!recovering) {
+      startFreeze(nowMs);
+      // 画面正常时断开：立即重连
+      nextAttemptMs = nowMs;
+      return;
+    }
+    scheduleRetry(nowMs);
+  }
+
+  void startFreeze(uint32_t nowMs) {
+    recovering = true;
+    stallDeclaredMs = nowMs;
+    freezeStartMs = hasFrame ? lastFrameMs : nowMs;
+  }
+
+  void scheduleRetry(uint32_t nowMs) {
+    backoffMs = backoffMs ? backoffMs * 2 : backoffMinMs;
+    if (backoffMs > backoffMaxMs) {
+      backoffMs = backoffMaxMs;
+    }
+    nextAttemptMs = nowMs + backoffMs;
+  }
+
+  uint32_t stallMs = 1500;
+  uint32_t backoffMinMs = 20;
+  uint32_t backoffMaxMs = 2000;
+
+  bool streaming = false;
+  bool recovering = false;
+  bool hasFrame = false;
+  uint32_t lastProgressMs = 0;
+  uint32_t lastFrameMs = 0;
+  uint32_t bytesSinceFrame = 0;
+  uint32_t stallDeclaredMs = 0;
+  uint32_t freezeStartMs = 0;
+  uint32_t backoffMs = 0;
+  uint32_t nextAttemptMs = 0;
+};
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+#include "latency_stats.h"
+
+// 拍摄超时（上一张还没拍完，下一张已经到点）时的处理方式
+enum TimelapseOverrun {
+  TIMELAPSE_SKIP = 0,      // 跳过错过的时刻，下一张对齐到之后的第一个整数倍时刻（张数少于理论值，时间轴不变）
+  TIMELAPSE_CATCH_UP = 1   // 逐张补拍错过的时刻（不等待），追上后恢复正常间隔；最多补拍maxCatchUp张，其余跳过
+};
+
+// timelapse拍摄时刻调度（与硬件无关，时间由调用方传入，毫秒，允许millis()回绕）
+// 第k张的计划时刻固定为 起点 + k*间隔，不以上一张拍完的时间为基准，
+// 所以拍摄耗时不会累积成漂移；超时按TimelapseOverrun确定性地跳过或补拍
+class TimelapseScheduler {
+public:
+  // 从nowMs开始，第一张在nowMs + intervalMs
+  void start(uint32_t nowMs, uint32_t intervalMs, TimelapseOverrun overrunPolicy = TIMELAPSE_SKIP,
+             uint32_t maxCatchUpShots = 3) {
+    interval = intervalMs ? intervalMs : 1;
+    policy = overrunPolicy;
+    maxCatchUp = maxCatchUpShots;
+    nextDue = nowMs + interval;
+    slot = 1;
+    catchUpRun = 0;
+    shots = 0;
+    skipped = 0;
+    lateness.reset();
+  }
+
+  // 改变间隔：从最近一个计划时刻重新起算（已拍摄的时间轴不变）
+  void setInterval(uint32_t nowMs, uint32_t intervalMs) {
+    uint32_t anchor = nextDue - interval;
+    interval = intervalMs ? intervalMs : 1;
+    nextDue = anchor + interval;
+    // 新间隔更短时，锚点之后已经错过的时刻直接跳过
+    if ((int32_t)(nowMs - nextDue) > 0) {
+      uint32_t missed = (nowMs - nextDue) / interval;
+      nextDue += missed * interval;
+      slot += missed;
+    }
+  }
+
+  uint32_t intervalMs() const {
+    return interval;
+  }
+
+  // 当前这张的计划时刻
+  uint32_t dueMs() const {
+    return nextDue;
+  }
+
+  // 第几个计划时刻（从1开始，跳过的时刻也计数），计划时刻 = 起点 + slotIndex()*间隔
+  uint32_t slotIndex() const {
+    return slot;
+  }
+
+  bool due(uint32_t nowMs) const {
+    return (int32_t)(nowMs - nextDue) >= 0;
+  }
+
+  // 距离下一张还有多久（已到点时为0），用于倒计时显示和决定loop等待多久
+  uint32_t msUntilDue(uint32_t nowMs) const {
+    return due(nowMs) ? 0 : nextDue - nowMs;
+  }
+
+  // 开始拍摄（startMs）时调用，记录相对计划时刻的延迟
+  void shotStarted(uint32_t startMs) {
+    uint32_t late = (int32_t)(startMs - nextDue) > 0 ? startMs - nextDue : 0;
+    lateness.add(late * 1000);
+  }
+
+  // 拍摄结束（无论成功与否）后调用，推进到下一个计划时刻
+  void shotFinished(uint32_t nowMs) {
+    shots++;
+    nextDue += interval;
+    slot++;
+    if (!due(nowMs)) {
+      catchUpRun = 0;
+      return;
+    }
+    // 超时：下一个时刻也已经过去
+    if (policy == TIMELAPSE_CATCH_UP && catchUpRun < maxCatchUp) {
+      catchUpRun++;
+      return;
+    }
+    // 跳到之后的第一个计划时刻（严格晚于nowMs）
+    uint32_t missed = (nowMs - nextDue) / interval + 1;
+    nextDue += missed * interval;
+    slot += missed;
+    skipped += missed;
+    catchUpRun = 0;
+  }
+
+  // 统计信息
+  uint32_t shots = 0;     // 已拍摄（含失败）
+  uint32_t skipped = 0;   // 因超时跳过的计划时刻
+  LatencyStats lateness;  // 开始拍摄相对计划时刻的延迟，只反映loop的轮询粒度，不随张数累积
+
+private:
+  uint32_t interval = 5000;
+  uint32_t nextDue = 0;
+  uint32_t slot = 0;
+  uint32_t maxCatchUp = 3;
+  uint32_t catchUpRun = 0;
+  TimelapseOverrun policy = TIMELAPSE_SKIP;
+};
@@ -0,0 +1,236 @@
+#pragma once
+
+#include <mutex>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "latency_stats.h"
+
+#define WRITE_BEHIND_MAX_BUFFERS 4   // 借用缓冲区数量上限
+#define WRITE_BEHIND_MAX_JOBS 8      // 队列深度上限
+#define WRITE_BEHIND_PATH_MAX 64     // 目标路径最大长度（含结尾0）
+
+// 写盘任务选项
+#define WRITE_JOB_APPEND 0x01   // 追加到文件末尾（否则覆盖）
+#define WRITE_JOB_SYNC 0x02     // 写完立即flush到卡上（否则按写入者的flush策略）
+#define WRITE_JOB_CLOSE 0x04    // 写完关闭文件（否则写入者保持打开，供同一文件的后续追加任务使用）
+#define WRITE_JOB_SEEK 0x08     // 写到已有文件的offset处（不截断，超出文件末尾时文件扩展）
+
+// 一条写盘任务
+// buffer>=0表示借用缓冲区（acquireBuffer/submit），-1表示队列自己分配的数据副本（submitCopy）；
+// stampUs为调用方给定的起始时间（用于统计端到端延迟），offset只对WRITE_JOB_SEEK有效
+struct WriteJob {
+  char path[WRITE_BEHIND_PATH_MAX];
+  uint8_t* data;
+  size_t size;
+  uint32_t offset;
+  uint32_t stampUs;
+  int buffer;
+  uint8_t flags;
+};
+
+// 写回队列（与硬件无关，只依赖std::mutex）
+// 生产者提交任务后立即返回，写入者next()按提交顺序取出，写完后complete()释放数据。
+// 两种提交方式：
+//   - 借用缓冲区：acquireBuffer()取空闲缓冲区，填好后submit()，全部在途时返回-1（连拍、拍照分块写入使用）
+//   - 数据副本：submitCopy()拷贝数据，待写字节数超过上限或队列满时返回false
+// 两种方式都由生产者在失败时等待或放弃（背压），排队的数据量始终有上限
+class WriteBehindQueue {
+public:
+  // 待写副本数据的字节上限
+  void setCopyLimit(size_t bytes) {
+    std::lock_guard<std::mutex> guard(lock);
+    copyLimit = bytes;
+  }
+
+  // 借入缓冲区（buffers[i]各自至少capacity字节），调用时不能有借用缓冲区的任务在途
+  void attachBuffers(uint8_t* const* buffers, int count, size_t capacity) {
+    std::lock_guard<std::mutex> guard(lock);
+    bufferCount = count > WRITE_BEHIND_MAX_BUFFERS ? WRITE_BEHIND_MAX_BUFFERS : count;
+    bufferSize = capacity;
+    for (int i = 0; i < bufferCount; i++) {
+      data[i] = buffers[i];
+      busy[i] = false;
+    }
+    stalled = false;
+  }
+
+  // 归还借入的缓冲区，调用前须等待相关任务写完
+  void detachBuffers() {
+    std::lock_guard<std::mutex> guard(lock);
+    bufferCount = 0;
+    bufferSize = 0;
+  }
+
+  size_t bufferCapacity() const {
+    return bufferSize;
+  }
+
+  uint8_t* bufferData(int buffer) const {
+    return data[buffer];
+  }
+
+  // ---- 生产者端 ----
+
+  // 取一个空闲缓冲区，没有时返回-1
+  int acquireBuffer() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (queued + inFlight < WRITE_BEHIND_MAX_JOBS) {
+      for (int i = 0; i < bufferCount; i++) {
+        if (!busy[i]) {
+          busy[i] = true;
+          stalled = false;
+          return i;
+        }
+      }
+    }
+    // 同一次等待中的重复调用只计一次
+    if (!stalled) {
+      stalled = true;
+      stalls++;
+    }
+    return -1;
+  }
+
+  // 放弃已取得但不再使用的缓冲区（例如拍摄失败）
+  void cancelBuffer(int buffer) {
+    std::lock_guard<std::mutex> guard(lock);
+    busy[buffer] = false;
+  }
+
+  // 提交借用缓冲区中的数据，缓冲区在complete()之前归写入者所有
+  void submit(int buffer, const char* path, size_t size, uint32_t stampUs,
+              uint8_t flags = WRITE_JOB_CLOSE, uint32_t offset = 0) {
+    std::lock_guard<std::mutex> guard(lock);
+    push(path, data[buffer], size, offset, stampUs, buffer, flags);
+  }
+
+  // 拷贝数据后提交，调用方的数据立即可以复用；超出上限时返回false
+  bool submitCopy(const char* path, const uint8_t* src, size_t size, uint32_t stampUs,
+                  uint8_t flags = WRITE_JOB_CLOSE, uint32_t offset = 0) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (queued + inFlight >= WRITE_BEHIND_MAX_JOBS || copyBytes + size > copyLimit) {
+      if (!stalled) {
+        stalled = true;
+        stalls++;
+      }
+      return false;
+    }
+    uint8_t* copy = (uint8_t*)malloc(size ? size : 1);
+    if (!copy) {
+      return false;
+    }
+    if (size > 0) {
+      memcpy(copy, src, size);
+    }
+    copyBytes += size;
+    stalled = false;
+    push(path, copy, size, offset, stampUs, -1, flags);
+    return true;
+  }
+
+  // ---- 写入者端 ----
+
+  // 取出最早提交的任务
+  bool next(WriteJob& out) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (queued == 0) {
+      return false;
+    }
+    out = jobs[head];
+    head = (head + 1) % WRITE_BEHIND_MAX_JOBS;
+    queued--;
+    inFlight++;
+    return true;
+  }
+
+  // 任务写完：释放数据，记录写盘耗时和从stampUs起的端到端延迟
+  void complete(const WriteJob& job, bool success, uint32_t writeUs, uint32_t nowUs) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (job.buffer >= 0) {
+      busy[job.buffer] = false;
+    } else {
+      free(job.data);
+      copyBytes -= job.size;
+    }
+    inFlight--;
+    if (success) {
+      written++;
+      bytesWritten += job.size;
+    } else {
+      failed++;
+    }
+    writeTime.add(writeUs);
+    jobLatency.add(nowUs - job.stampUs);
+  }
+
+  // 排队中加正在写的任务数
+  int depth() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return queued + inFlight;
+  }
+
+  bool idle() const {
+    return depth() == 0;
+  }
+
+  // 写盘吞吐（字节/秒，按写入者实际写盘的时间计算）
+  uint32_t bytesPerSecond() const {
+    return writeTime.totalUs ? (uint32_t)(bytesWritten * 1000000ull / writeTime.totalUs) : 0;
+  }
+
+  void resetStats() {
+    std::lock_guard<std::mutex> guard(lock);
+    submitted = 0;
+    written = 0;
+    failed = 0;
+    stalls = 0;
+    bytesWritten = 0;
+    maxDepth = 0;
+    writeTime.reset();
+    jobLatency.reset();
+  }
+
+  // 统计信息（读取时写入者可能仍在更新，仅用于日志）
+  uint32_t submitted = 0;     // 提交的任务数
+  uint32_t written = 0;       // 写入成功数
+  uint32_t failed = 0;        // 写入失败数
+  uint32_t stalls = 0;        // 生产者因缓冲区/队列已满而等待的次数（背压）
+  uint64_t bytesWritten = 0;
+  int maxDepth = 0;           // 最大队列深度
+  LatencyStats writeTime;     // 单个任务写盘耗时
+  LatencyStats jobLatency;    // stampUs到写完的延迟
+
+private:
+  void push(const char* path, uint8_t* bytes, size_t size, uint32_t offset, uint32_t stampUs,
+            int buffer, uint8_t flags) {
+    WriteJob& job = jobs[(head + queued) % WRITE_BEHIND_MAX_JOBS];
+    snprintf(job.path, sizeof(job.path), "%s", path);
+    job.data = bytes;
+    job.size = size;
+    job.offset = offset;
+    job.stampUs = stampUs;
+    job.buffer = buffer;
+    job.flags = flags;
+    queued++;
+    submitted++;
+    if (queued + inFlight > maxDepth) {
+      maxDepth = queued + inFlight;
+    }
+  }
+
+  mutable std::mutex lock;
+  uint8_t* data[WRITE_BEHIND_MAX_BUFFERS] = {};
+  bool busy[WRITE_BEHIND_MAX_BUFFERS] = {};
+  WriteJob jobs[WRITE_BEHIND_MAX_JOBS];
+  int bufferCount = 0;
+  size_t bufferSize = 0;
+  size_t copyBytes = 0;
+  size_t copyLimit = 64 * 1024;
+  int head = 0;
+  int queued = 0;
+  int inFlight = 0;
+  bool stalled = false;
+};
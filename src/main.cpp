@@ -7,14 +7,172 @@
 #include <SD.h>
 #include <cstring>
 #include <time.h>
+#include <unistd.h>
+#include "mjpeg_parser.h"
+#include "multipart_reader.h"
+#include "jpeg_utils.h"
+#include "frame_pool.h"
+#include "stream_pipeline.h"
+#include "preview_scale.h"
+#include "latency_stats.h"
+#include "control_queue.h"
+#include "capture_freshness.h"
+#include "write_behind.h"
+#include "persisted_counter.h"
+#include "mjpeg_avi.h"
+#include "timelapse_schedule.h"
+#include "awake_meter.h"
+#include "status_telemetry.h"
+#include "status_overlay.h"
+#include "coop_scheduler.h"
+#include "stream_watchdog.h"
+#include "resolution_switch.h"
+#include "preview_bitrate.h"
+#include <JPEGDEC.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+#include <esp_sleep.h>
+#include <esp_wifi.h>
+#include <esp_timer.h>
+#include <driver/gpio.h>
 
 // 全局配置
-#define GLOBAL_MAX_JPEG_SIZE 70 * 1024 // 70KB最大JPEG尺寸，进一步减小以节省内存
+#define GLOBAL_MAX_JPEG_SIZE 70 * 1024 // 70KB最大预览帧尺寸（拍照直接写SD卡，不受此限制）
+#define MJPEG_READ_CHUNK_SIZE 4096     // 每次从socket批量读取的字节数
+
+// 串流卡住检测：连接还在但超过STREAM_STALL_MS没有新帧就断开重连，重连失败按指数退避
+#define STREAM_STALL_MS 1500           // 判定卡住的无帧时间
+#define STREAM_BACKOFF_MIN_MS 20       // 重连退避的初始等待（画面正常时断开的第一次立即重连）
+#define STREAM_BACKOFF_MAX_MS 2000     // 重连退避的上限
+#define STREAM_RESTART_SETTLE_MS 0     // 主动重启串流前的等待（控制命令返回时相机已切换完成，原来固定500ms）
+#define RESOLUTION_SWITCH_TIMEOUT_MS 2000 // 在线切换分辨率后这么久仍只有旧分辨率的帧就重连串流
+#define STREAM_CONNECT_TIMEOUT_MS 1000 // 串流连接超时（原来使用HTTPClient默认值）
+
+// 拍照配置
+#define CAPTURE_MAX_ATTEMPTS 4         // 单次拍照最多请求次数（拿到旧帧时重试）
+#define CAPTURE_RETRY_BASE_MS 20       // 旧帧重试的初始轮询间隔（每次翻倍）
+#define CAPTURE_HEAD_SIZE 2048         // 用于判断分辨率的帧头读取长度
+#define CAPTURE_WRITE_CHUNK_SIZE (32 * 1024) // 拍照边收边写SD卡的块大小（FAT32常见簇大小，两块放在一个帧槽内）
+#define CAPTURE_TEMP_PATH "/images/.capture.tmp" // 拍照临时文件，校验通过后重命名
+
+// SD卡写入任务配置
+#define SD_WRITER_COPY_LIMIT (GLOBAL_MAX_JPEG_SIZE + 16 * 1024) // 排队中的数据副本上限（须放得下一帧预览帧）
+#define SD_WRITER_FLUSH_BYTES (64 * 1024) // 保持打开的文件每写入这么多字节flush一次
+#define SD_WRITER_WAIT_MS 5000         // 队列满时生产者最多等待的时间
+
+static_assert(2 * CAPTURE_WRITE_CHUNK_SIZE <= GLOBAL_MAX_JPEG_SIZE, "capture chunks must fit in one frame slot");
+
+// 连拍配置
+#define BURST_SHOT_COUNT 10            // 每次连拍张数
+#ifndef CAMERA_RESOLUTION_BURST
+#define CAMERA_RESOLUTION_BURST 10     // 10分辨率 (640*480)，连拍单张需放得进一个帧槽
+#endif
+
+// 双核流水线配置
+#define PIPELINE_INGEST_CORE 0         // 网络接收任务与WiFi协议栈同核
+#define PIPELINE_DECODE_CORE 1         // 解码显示任务与loop同核（UI/按键很轻）
+#define PIPELINE_TASK_STACK 8192
+
+// 协作式调度：每个任务里的工作作为job运行，带优先级和时间预算，统计CPU占比和每轮最坏耗时
+#define STREAM_INGEST_BUDGET_US 2000   // 接收job每次读到这个时间为止（原来按字节数，耗时随链路变化）
+#define STREAM_STATS_PERIOD_US 5000000 // 流解析统计的输出周期
+#define DECODE_BUDGET_US 30000         // 解码一帧的预算（解码不能中途返回，超出只计数）
+#define UI_INPUT_BUDGET_US 2000        // 按键处理的预算（拍照、连拍等阻塞操作计为超预算）
+#define SCHED_REPORT_PERIOD_US 10000000 // 输出各任务调度统计的周期
+#define TELEMETRY_JOB_PERIOD_US 1000000 // 遥测job检查采样周期的间隔
+#define TELEMETRY_JOB_BUDGET_US 5000   // 遥测采样的预算（剩余空间遍历FAT，完整采样常超出）
+#define TIMELAPSE_JOB_BUDGET_US 20000  // timelapse按键和刷新显示的预算（拍摄一张计为超预算）
+// 单轮预算：前面的job用掉预算后，放不下的低优先级job推迟一轮（统计、调档、调度报告）
+// 解码任务只有一个job，不设单轮预算
+#define INGEST_ITERATION_BUDGET_US 3000 // 接收job用满预算时统计和调档推迟一轮
+#define UI_ITERATION_BUDGET_US 25000   // 放得下按键、遥测和timelapse刷新，拍摄之后的调度报告推迟一轮
+
+// 预览码率自适应：按实测帧率、每帧字节数、解码耗时和RSSI在档位表中上下调整预览的framesize/quality
+#ifndef PREVIEW_ADAPT
+#define PREVIEW_ADAPT 1                // 0：固定CAMERA_RESOLUTION_LOW、quality 0（原来的做法）
+#endif
+#ifndef PREVIEW_TARGET_FPS
+#define PREVIEW_TARGET_FPS 20          // 要保持的预览帧率
+#endif
+#define PREVIEW_ADAPT_PERIOD_US 1000000 // 统计窗口
+
+// 串口日志：各项性能统计（[Stream]、[Sched]、[Adapt]等）都通过serialPrintf输出
+#ifndef ENABLE_SERIAL_LOG
+#define ENABLE_SERIAL_LOG 1            // 0：关闭串口日志
+#endif
+#define SERIAL_LOG_LINE_MAX 512        // 单行上限（多字段的统计行超过256字节）
+
+// 相机连接配置（可通过build_flags覆盖，例如指向tools/mock_unitcam.py模拟服务器）
+#ifndef CAMERA_BASE_URL
+#define CAMERA_BASE_URL "http://192.168.4.1"
+#endif
+#ifndef CAMERA_WIFI_SSID
+#define CAMERA_WIFI_SSID "UnitCamS3-WiFi"
+#endif
+#ifndef CAMERA_WIFI_PASSWORD
+#define CAMERA_WIFI_PASSWORD ""
+#endif
 
 // 相机分辨率常量
 #define CAMERA_RESOLUTION_HIGH 13     // 13高分辨率 (1280*720)，用于拍摄照片
 #define CAMERA_RESOLUTION_TIMELAPSE 10     // 10分辨率 (640*480)，用于延时摄影模式
+#ifndef TIMELAPSE_INTERVAL_MS
+#define TIMELAPSE_INTERVAL_MS 5000     // 默认拍摄间隔（timelapse中按=/-在预设间隔之间切换）
+#endif
+#ifndef TIMELAPSE_OVERRUN
+#define TIMELAPSE_OVERRUN TIMELAPSE_SKIP // 拍摄超过间隔时：TIMELAPSE_SKIP跳过错过的时刻，TIMELAPSE_CATCH_UP补拍
+#endif
+#define TIMELAPSE_MAX_CATCH_UP 3       // 补拍模式下连续补拍的上限
+#define TIMELAPSE_LOOP_MS 100          // timelapse模式loop的最长等待（按键、息屏、刷新显示）
 #define CAMERA_RESOLUTION_LOW 6       // 6低分辨率(320*240)，用于实时预览
+#ifndef CAMERA_RESOLUTION_FAST_SHUTTER
+#define CAMERA_RESOLUTION_FAST_SHUTTER 8   // 8分辨率(400*296)，快速快门模式的串流分辨率（单帧需小于预览帧上限）
+#endif
+#define FAST_SHUTTER_TIMEOUT_MS 2000   // 快速快门等待下一帧的超时时间
+#ifndef SNAPSHOT_NAME_TIMESTAMP
+#define SNAPSHOT_NAME_TIMESTAMP 1      // 时钟已同步时在照片序号后附加时间戳
+#endif
+#define SNAPSHOT_CLOCK_VALID_YEAR 2024 // 早于该年份视为时钟未同步（没有RTC/NTP时从1970年开始）
+
+// 状态栏遥测：剩余空间（遍历FAT）和电量（读ADC）按慢周期采样，界面每帧读缓存
+#define TELEMETRY_FREE_SPACE_PERIOD_MS 60000 // 剩余空间完整采样周期（之间按写入量递减）
+#define TELEMETRY_BATTERY_PERIOD_MS 10000    // 电量采样周期
+#define STATUS_OVERLAY_LOG_FRAMES 600        // 每刷新这么多次状态栏输出一次耗时统计
+#define LIVE_MESSAGE_MS 3000                 // 预览画面上提示文字的显示时间
+
+// 低功耗timelapse：息屏后两张之间light sleep（定时器或BtnA唤醒），light sleep不保持WiFi连接，醒来后重连
+#ifndef TIMELAPSE_LOW_POWER_DEFAULT
+#define TIMELAPSE_LOW_POWER_DEFAULT 0  // 1：启动后timelapse默认低功耗（按p键切换）
+#endif
+#define TIMELAPSE_LOW_POWER_SCREEN_OFF_MS 10000 // 低功耗模式下无操作息屏的时间
+#define TIMELAPSE_SLEEP_MIN_MS 200     // 能睡的时间不足这个值就不睡（唤醒和WiFi重连不划算）
+#define TIMELAPSE_WAKE_EARLY_MS 30     // 重连之外再提前唤醒的时间，拍摄仍落在计划时刻上
+#define TIMELAPSE_WIFI_RECONNECT_MS 1500 // 还没有重连记录时预计的重连时间（之后用实测平均值）
+#define TIMELAPSE_WIFI_WAIT_MS 5000    // 唤醒后等待WiFi重连的最长时间
+#define TIMELAPSE_WAKE_GPIO GPIO_NUM_0 // BtnA（键盘是扫描矩阵，不能作为唤醒源）
+// 续航估算用的电流，按实测修改
+#ifndef POWER_AWAKE_MA
+#define POWER_AWAKE_MA 150             // 醒着（WiFi收发、SD写入，屏幕熄灭）的平均电流
+#endif
+#ifndef POWER_SLEEP_UA
+#define POWER_SLEEP_UA 4000            // light sleep（射频关闭）时的平均电流
+#endif
+#ifndef POWER_BATTERY_MAH
+#define POWER_BATTERY_MAH 1400         // 电池容量
+#endif
+
+// timelapse AVI录制：每个会话的照片追加到一个预分配的MJPEG AVI里，不再每张照片一个文件
+#ifndef TIMELAPSE_AVI_DEFAULT
+#define TIMELAPSE_AVI_DEFAULT 0        // 1：启动后timelapse默认写AVI（按a键切换）
+#endif
+#ifndef TIMELAPSE_AVI_PREALLOC_MB
+#define TIMELAPSE_AVI_PREALLOC_MB 32   // 每个AVI文件预分配的大小，写满后换下一个文件
+#endif
+#define TIMELAPSE_AVI_FRAME_MAX (256 * 1024) // 剩余空间放不下这么大的一帧时换文件
+#define TIMELAPSE_AVI_PLAYBACK_FPS 10  // 回放帧率
+#define TIMELAPSE_AVI_WAIT_MS 30000    // 预分配/结束文件时等待写入任务的时间
+#define SD_MOUNT_POINT "/sd"           // SD.begin()默认的VFS挂载点（截断文件时需要完整路径）
 
 // 日志相关定义
 const char* LOG_HDR_KEYS[] = {"Server", "Content-Type", "Content-Length", "Cache-Control", "Connection"};
@@ -24,29 +182,48 @@ constexpr size_t LOG_HDR_KEYS_COUNT = sizeof(LOG_HDR_KEYS) / sizeof(LOG_HDR_KEYS
 typedef struct {
   bool isCaptureReq;        // 拍摄请求标志
   bool isRestartStream;     // 重启流请求标志
-  bool jpegReady;           // JPEG数据就绪标志
   
-  // 使用静态数组代替vector作为JPEG数据缓冲区
-  uint8_t jpegData[GLOBAL_MAX_JPEG_SIZE];
-  size_t jpegDataSize;
-  
-  // 缓存的图像尺寸（避免每帧都解析）
-  int cachedImgWidth;
-  int cachedImgHeight;
-  bool sizeCached;
+  unsigned long shutterTime; // 按下快门的时间（用于统计快门到保存的延迟）
 } AppState;
 
 AppState appState = {
   false,                   // isCaptureReq
   false,                   // isRestartStream
-  false,                   // jpegReady
-  {0},                     // jpegData
-  0,                       // jpegDataSize
-  0,                       // cachedImgWidth
-  0,                       // cachedImgHeight
-  false                    // sizeCached
+  0                        // shutterTime
 };
 
+// 帧池：流解析器直接写入空闲槽，显示端拿到最新帧的指针，无需逐帧拷贝
+// 拍照时流已停止，拍摄数据复用生产者槽，不再单独占用缓冲区
+static uint8_t frameStorage[FramePool::SLOT_COUNT * GLOBAL_MAX_JPEG_SIZE];
+FramePool framePool;
+
+// 流水线：接收任务写帧池，解码任务读帧池，loop处理UI和按键
+// UI需要独占网络流或屏幕时通过pipelineGate暂停两个任务
+PipelineGate pipelineGate;
+TaskHandle_t ingestTaskHandle = nullptr;
+TaskHandle_t decodeTaskHandle = nullptr;
+TaskHandle_t sdWriterTaskHandle = nullptr;
+
+// 调度器时钟（micros()在ESP32上为32位，回绕由调度器处理）
+uint32_t schedulerClock() {
+  return micros();
+}
+
+// 每个任务一个调度器，只由所在任务调用runOnce()
+CoopScheduler ingestScheduler(schedulerClock);  // 接收任务：串流读取、流统计
+CoopScheduler decodeScheduler(schedulerClock);  // 解码任务：解码显示
+CoopScheduler uiScheduler(schedulerClock);      // loop：按键和拍照、timelapse、遥测、调度统计
+
+// SD卡写回队列：所有SD卡写入都交给写入任务，loop不等待SPI写卡
+WriteBehindQueue sdWriteQueue;
+SharedLatencyStats frameLatency;       // 帧发布到显示完成的延迟（解码任务写，接收任务的统计job取走）
+SharedLatencyStats decodeTime;         // 单帧解码+绘制耗时
+
+// 预览解码：JPEGDEC支持在IDCT阶段按1/2、1/4、1/8缩小，解码量随比例下降
+JPEGDEC previewDecoder;
+PreviewMode previewMode = PREVIEW_MODE_FIT;
+PreviewPlacement lastPlacement = {0, 0, 0, 0, 0};
+
 // 屏幕分辨率常量定义
 const int SCREEN_WIDTH = 240;
 const int SCREEN_HEIGHT = 135;
@@ -73,18 +250,107 @@ const unsigned long keyDebounceDelay = 200; // 按键防抖动延迟200ms
 bool isTimelapseMode = false;        // 是否处于timelapse模式
 int timelapsePhotoCount = 0;         // 已拍摄照片数量
 int currentTimelapseSession = 0;     // 当前timelapse会话编号
-unsigned long timelapseLastShotTime = 0; // 上次拍摄时间
-const unsigned long timelapseInterval = 5000; // 拍摄间隔5秒
+// 拍摄时刻固定为 起点+k*间隔，拍摄耗时不会累积成漂移
+TimelapseScheduler timelapseSchedule;
+uint32_t timelapseIntervalMs = TIMELAPSE_INTERVAL_MS; // 当前拍摄间隔
+const uint32_t timelapseIntervalPresets[] = {500, 1000, 2000, 5000, 10000, 30000, 60000,
+                                             300000, 600000, 1800000, 3600000};
+constexpr int TIMELAPSE_INTERVAL_PRESET_COUNT = sizeof(timelapseIntervalPresets) / sizeof(timelapseIntervalPresets[0]);
 unsigned long timelapseStartTime = 0; // timelapse模式启动时间
 bool isScreenOff = false;             // 屏幕是否息屏
 unsigned long lastUserActionTime = 0; // 上次用户操作时间
 const unsigned long screenOffTimeout = 60000; // 1分钟无操作息屏
 String currentTimelapseDir = "";      // 当前timelapse会话的目录路径
+PersistedCounter timelapseSessionCounter; // timelapse会话编号（持久化在/images/timelapse/.counter0/1）
+bool isTimelapseAviMode = TIMELAPSE_AVI_DEFAULT; // timelapse是否写入AVI（否则每张一个JPEG文件）
+MjpegAviRecorder timelapseAvi;        // 当前AVI文件的布局
+char timelapseAviPath[WRITE_BEHIND_PATH_MAX] = ""; // 当前AVI文件路径（空表示没有打开的文件）
+int timelapseAviPart = 0;             // 当前会话中的第几个AVI文件
+bool isTimelapseLowPower = TIMELAPSE_LOW_POWER_DEFAULT; // timelapse是否在两张之间light sleep
+AwakeMeter timelapseAwake;            // 低功耗timelapse每张照片醒着的时间
+wifi_ps_type_t savedWifiPowerSave = WIFI_PS_MIN_MODEM; // 进入低功耗前的WiFi省电模式
+StatusTelemetry statusTelemetry;      // 剩余空间和电量的缓存
+LatencyStats statusOverlayTime;       // timelapse状态栏每次刷新的耗时
+
+// 状态文字叠加层：只重画变化的字段
+// timelapse界面由loop独占屏幕；预览界面的字段由解码任务在每帧之后叠加（流水线暂停时由loop绘制）
+StatusOverlay timelapseOverlay;
+int tlFieldPhotos, tlFieldNext, tlFieldInterval, tlFieldSpace, tlFieldBattery;
+StatusOverlay liveOverlay;
+int liveFieldMessage;
+SemaphoreHandle_t liveOverlayMutex = nullptr; // loop设置文字与解码任务绘制之间的互斥
+PersistedCounter snapshotCounter;         // 拍照/连拍序号（持久化在/images/.counter0/1）
+
+// 拍照新鲜度检测与快门延迟统计
+CaptureFreshness captureFreshness;
+LatencyStats shutterLatency;           // 按下快门到照片写入SD卡
+
+// sdWriterTask函数的前向声明
+void sdWriterTask(void* param);
 
 // 全局MJPEG流变量
 WiFiClient streamClient;
 HTTPClient streamHttp;
 
+// MJPEG流读取器：按part的Content-Length整段读取，没有长度时退回标记扫描
+MultipartMjpegReader streamReader;
+StreamWatchdog streamWatchdog;
+ResolutionSwitch resolutionSwitch;     // 串流分辨率切换：控制请求到第一帧新分辨率的延迟
+
+// 串流模式与预览档位
+bool isFastShutterMode = false;      // 快速快门模式：直接保存串流中的下一帧，不切换分辨率、不重连
+
+// 预览档位表（按开销从低到高），启动时在原来固定的设置上（CAMERA_RESOLUTION_LOW、quality 0）
+const PreviewLevel previewLadder[] = {
+  {3, 0},                      // 176x144
+  {4, 0},                      // 240x176
+  {CAMERA_RESOLUTION_LOW, 0},  // 320x240
+  {CAMERA_RESOLUTION_LOW, 1},
+  {CAMERA_RESOLUTION_LOW, 2},
+};
+#define PREVIEW_LADDER_START 2
+PreviewBitrateController previewBitrate;
+SharedLatencyStats previewDecodeWindow; // 当前统计窗口的解码耗时（解码任务写，码率自适应job取走）
+
+// 当前模式下的串流分辨率（快速快门模式保存串流帧，分辨率固定；预览按码率自适应的档位）
+int streamResolution() {
+  return isFastShutterMode ? CAMERA_RESOLUTION_FAST_SHUTTER : previewBitrate.currentLevel().framesize;
+}
+
+// 当前模式下的串流质量
+int streamQuality() {
+  return isFastShutterMode ? 0 : previewBitrate.currentLevel().quality;
+}
+
+// 控制通道：所有/api/v1/control和/api/v1/status请求复用同一个keep-alive连接，
+// 避免每条命令都重新建立TCP连接
+WiFiClient controlClient;
+HTTPClient controlHttp;
+SemaphoreHandle_t controlMutex = nullptr;
+
+// 参数更新队列：按键只负责入队（同一参数合并为最新值），由控制任务在后台集中发出
+ControlQueue controlQueue;
+TaskHandle_t controlTaskHandle = nullptr;
+
+// 每种控制命令的延迟直方图
+struct ControlMetric {
+  const char* name;
+  LatencyHistogram latency;
+  uint32_t failures;
+};
+
+ControlMetric controlMetrics[] = {
+  {"framesize", {}, 0},
+  {"quality", {}, 0},
+  {"special_effect", {}, 0},
+  {"brightness", {}, 0},
+  {"contrast", {}, 0},
+  {"saturation", {}, 0},
+  {"sharpness", {}, 0},
+  {"status", {}, 0},
+};
+constexpr size_t CONTROL_METRICS_COUNT = sizeof(controlMetrics) / sizeof(controlMetrics[0]);
+
 // 日志函数
 void logLine(const String& line) {
   Serial.println(line);
@@ -114,10 +380,12 @@ void logHttpResponseHeaders(const String& prefix, int code, HTTPClient& http) {
   }
 }
 
-// 记录原始串口数据
+// 记录原始串口数据（ENABLE_SERIAL_LOG为0时不输出）
 void serialPrintf(const char* format, ...) {
+#if !ENABLE_SERIAL_LOG
   return;
-  char buffer[256];
+#endif
+  char buffer[SERIAL_LOG_LINE_MAX];
   va_list args;
   va_start(args, format);
   vsnprintf(buffer, sizeof(buffer), format, args);
@@ -125,49 +393,21 @@ void serialPrintf(const char* format, ...) {
   Serial.print(buffer);
 }
 
-// 从数据中解析JPEG尺寸
-bool parseJpegSize(const uint8_t* data, size_t size, int& width, int& height) {
-  if (size < 2) {
-    return false;
-  }
-
-  // 查找SOF标记 (SOF0或SOF2)
-  for (size_t i = 0; i < size - 1; ++i) {
-    if (data[i] == 0xFF) {
-      uint8_t marker = data[i + 1];
-      if (marker == 0xC0 || marker == 0xC2) {
-        // SOF标记数据格式:
-    // 2字节: 段长度
-    // 1字节: 精度
-    // 2字节: 高度
-    // 2字节: 宽度
-        if (i + 9 >= size) {
-          return false;
-        }
-        height = (data[i + 5] << 8) | data[i + 6];
-        width = (data[i + 7] << 8) | data[i + 8];
-        return true;
-      }
-    }
-  }
-  return false;
-}
-
 // setCameraResolution函数的前向声明
 bool setCameraResolution(int resolution);
 
 // setCameraQuality函数的前向声明
 bool setCameraQuality(int quality);
 
-// setCameraSpecialEffect函数的前向声明
-bool setCameraSpecialEffect(int effect);
+// queueCameraControl函数的前向声明
+void queueCameraControl(const char* var, int value);
+
+// flushCameraControls函数的前向声明
+bool flushCameraControls(unsigned long timeoutMs);
 
 // getCameraConfig函数的前向声明
 bool getCameraConfig();
 
-// setCameraParameter函数的前向声明
-bool setCameraParameter(const String& paramName, int value);
-
 // displayLine函数的前向声明
 void displayLine(const String& text);
 
@@ -183,12 +423,24 @@ bool createTimelapseDir();
 // getSDCardFreeSpace函数的前向声明
 uint64_t getSDCardFreeSpace();
 
+// refreshStatusTelemetry函数的前向声明
+void refreshStatusTelemetry();
+
 // getBatteryPercentage函数的前向声明
 int getBatteryPercentage();
 
 // updateTimelapseDisplay函数的前向声明
 void updateTimelapseDisplay();
 
+// initStatusOverlays函数的前向声明
+void initStatusOverlays();
+
+// showLiveMessage函数的前向声明
+void showLiveMessage(const char* text, uint32_t durationMs = LIVE_MESSAGE_MS);
+
+// compositeLiveOverlay函数的前向声明
+void compositeLiveOverlay(int x, int y, int w, int h);
+
 // startTimelapseMode函数的前向声明
 void startTimelapseMode();
 
@@ -198,247 +450,727 @@ void stopTimelapseMode();
 // captureTimelapsePhoto函数的前向声明
 bool captureTimelapsePhoto();
 
-// 提取完整的JPEG帧（从SOI到EOI）
-static size_t trimToEOI(uint8_t* data, size_t size) {
-  if (size < 2) {
-    return 0;
-  }
-
-  size_t soiPos = 0;
-  // 查找SOI标记
-  for (; soiPos < size - 1; ++soiPos) {
-    if (data[soiPos] == 0xFF && data[soiPos + 1] == 0xD8) {
-      break;
-    }
-  }
-
-  if (soiPos >= size - 1) {
-    return 0; // SOI未找到
-  }
-
-  size_t eoiPos = soiPos + 2;
-  // 查找EOI标记
-  for (; eoiPos < size - 1; ++eoiPos) {
-    if (data[eoiPos] == 0xFF && data[eoiPos + 1] == 0xD9) {
-      break;
-    }
-  }
-
-  if (eoiPos >= size - 1) {
-    // EOI未找到，丢弃当前帧
-    return 0;
-  }
-
-  // 返回有效的JPEG长度 (从SOI到EOI)
-  return eoiPos - soiPos + 2;
-}
-
-// 通过相机快照接口获取并保存高清无边框JPEG
-bool captureSnapshot() {
-  // 稍等片刻以确保快照使用最新的capture_*参数
-  delay(500);
-
-  // 拍摄前停止MJPEG流以防止资源冲突
-  // logLine("Stopping MJPEG stream before capture...");
-  
-  // 使用全局变量直接停止流
-  streamHttp.end();
-  streamClient.stop();
-  
-  // 添加短暂延迟确保流完全停止
-  delay(500);
-  
-  // 设置高分辨率（拍摄前）
-  // logLine("Setting high resolution before capture...");
-  if (!setCameraResolution(CAMERA_RESOLUTION_HIGH)) {
-    // logLine("Failed to set high resolution");
-    return false;
-  }
-  
-  // 设置高质量（拍摄前）
-  if (!setCameraQuality(2)) {
-    // logLine("Failed to set high quality");
-    return false;
-  }
-  
-  // 获取最新图像数据
-  HTTPClient http;
-  
-  // 第一次请求：触发拍摄（忽略返回的旧图像数据）
-  const char* captureUrl = "http://192.168.4.1/api/v1/capture";
+// 发送一次拍照请求并读取帧头（SOF所在部分）判断是否为新帧
+// verdict为CAPTURE_STALE时已关闭http，调用方稍后重试；否则http保持打开，
+// head中已有headLen字节，remaining为剩余长度（未知为-1）。请求出错返回false
+bool openCaptureRequest(HTTPClient& http, const char* tag, uint8_t* head, size_t headCap,
+                        size_t& headLen, int& remaining, CaptureVerdict& verdict) {
+  const char* captureUrl = CAMERA_BASE_URL "/api/v1/capture";
   http.begin(captureUrl);
   // 使用简单的请求头，与Python代码保持一致
   http.addHeader("User-Agent", "M5Cardputer");
   http.setTimeout(15000);
+  logHttpRequestHeaders(tag, captureUrl, {{"User-Agent","M5Cardputer"}});
   
-  serialPrintf("[Snap] First request (trigger): GET %s\n", captureUrl);
+  serialPrintf("[%s] GET %s\n", tag, captureUrl);
   int code = http.GET();
-  
-  // 关闭第一次请求
-  http.end();
-  
-  // 等待相机处理新图像
-  // logLine("Waiting for camera to process new image...");
-  delay(500);
-  
-  // 第二次请求：获取新的图像数据
-  http.begin(captureUrl);
-  http.addHeader("User-Agent", "M5Cardputer");
-  http.setTimeout(15000);
-  logHttpRequestHeaders("snap", captureUrl, {{"User-Agent","M5Cardputer"}});
-  serialPrintf("[Snap] Second request (fetch): GET %s\n", captureUrl);
-  code = http.GET();
-  logHttpResponseHeaders("snap", code, http);
+  logHttpResponseHeaders(tag, code, http);
   
   if (code != 200) {
-    serialPrintf("[Snap] HTTP %d\n", code);
-    // logLine(String("[Snap] HTTP ") + code);
+    serialPrintf("[%s] HTTP %d\n", tag, code);
     http.end();
     return false;
   }
+  
   String ct = http.header("Content-Type");
-  serialPrintf("[Snap] CT: %s\n", ct.c_str());
-  // logLine(String("[Snap] CT=") + ct);
+  serialPrintf("[%s] CT: %s\n", tag, ct.c_str());
   
   // 验证内容类型是否为JPEG，但允许空内容类型（相机API可能不设置它）
   if (!ct.isEmpty() && !ct.startsWith("image/jpeg")) {
-    serialPrintf("[Snap] Unexpected content-type: %s\n", ct.c_str());
-    // logLine(String("[Snap] Unexpected content-type: ") + ct);
+    serialPrintf("[%s] Unexpected content-type: %s\n", tag, ct.c_str());
     http.end();
     return false;
   }
   
-  // 即使内容类型为空，由于状态为200，我们也会尝试将其作为JPEG处理
-  
   WiFiClient* s = http.getStreamPtr();
   s->setNoDelay(true);
   s->setTimeout(10000); // 增加流读取超时时间
   int len = http.getSize(); // 如果未知则为-1
-  // logLine(String("[Snap] content-length=") + len);
   
   // 如果Content-Length过大，可能是错误
   if (len > 5 * 1024 * 1024) { // 限制最大5MB
-    serialPrintf("[Snap] Content-Length too large: %d\n", len);
-    // logLine(String("[Snap] Content-Length too large: ") + len);
+    serialPrintf("[%s] Content-Length too large: %d\n", tag, len);
     http.end();
     return false;
   }
   
-  // 使用静态数组代替栈分配大数组
-  static uint8_t jpg[GLOBAL_MAX_JPEG_SIZE];
-  size_t jpgSize = 0;
+  // 读取帧头，SOF段在量化表/霍夫曼表之后，2KB足够
+  size_t want = headCap;
+  if (len > 0 && (size_t)len < want) {
+    want = len;
+  }
+  headLen = s->readBytes(head, want);
+  remaining = len > 0 ? len - (int)headLen : -1;
   
-  // 将数据读入静态数组
-  while (http.connected() && len && (jpgSize < GLOBAL_MAX_JPEG_SIZE)) {
-    int available = s->available();
-    if (available > 0) {
-      int bytesRead = s->readBytes(jpg + jpgSize, min(available, (int)(GLOBAL_MAX_JPEG_SIZE - jpgSize)));
-      jpgSize += bytesRead;
-      if (len > 0) {
-        len -= bytesRead;
-      }
+  verdict = captureFreshness.checkHeader(head, headLen);
+  if (verdict == CAPTURE_STALE) {
+    serialPrintf("[%s] Stale frame (resolution mismatch), retrying\n", tag);
+    http.end();
+  }
+  return true;
+}
+
+// 提交一个写盘任务（拷贝数据），队列满时等待写入任务腾出空间，超时返回false
+bool queueSdWrite(const char* path, const uint8_t* data, size_t size, uint8_t flags, uint32_t offset = 0) {
+  unsigned long start = millis();
+  while (!sdWriteQueue.submitCopy(path, data, size, micros(), flags, offset)) {
+    if (millis() - start > SD_WRITER_WAIT_MS) {
+      serialPrintf("[Writer] Queue full, dropped %s\n", path);
+      return false;
     }
+    delay(1);
+  }
+  xTaskNotifyGive(sdWriterTaskHandle);
+  return true;
+}
+
+// 等待已提交的写盘任务全部完成（读取刚写入的文件或重命名之前调用）
+bool waitSdWrites(unsigned long timeoutMs) {
+  unsigned long start = millis();
+  while (!sdWriteQueue.idle()) {
+    if (millis() - start > timeoutMs) {
+      return false;
+    }
+    delay(1);
+  }
+  return true;
+}
+
+// 读取计数器的一个槽（<dir>/.counter0或.counter1），返回读到的字节数
+size_t readCounterSlot(const char* dir, int slot, uint8_t* record) {
+  char path[WRITE_BEHIND_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/.counter%d", dir, slot);
+  File file = SD.open(path, FILE_READ);
+  if (!file) {
+    return 0;
   }
+  size_t len = file.read(record, COUNTER_RECORD_SIZE);
+  file.close();
+  return len;
+}
+
+// 从dir下的两个槽加载计数器，都无效时返回false
+bool loadCounter(PersistedCounter& counter, const char* dir) {
+  uint8_t recordA[COUNTER_RECORD_SIZE];
+  uint8_t recordB[COUNTER_RECORD_SIZE];
+  size_t lenA = readCounterSlot(dir, 0, recordA);
+  size_t lenB = readCounterSlot(dir, 1, recordB);
+  return counter.load(recordA, lenA, recordB, lenB);
+}
+
+// 取一个号码，新记录交给写入任务覆盖较旧的槽（先于之后提交的文件写入落盘）
+uint32_t reserveCounter(PersistedCounter& counter, const char* dir) {
+  uint8_t record[COUNTER_RECORD_SIZE];
+  int slot;
+  uint32_t value = counter.reserve(record, slot);
   
-  // 检查是否读取了完整数据
-  if (jpgSize >= GLOBAL_MAX_JPEG_SIZE) {
-    serialPrintf("[Snap] JPEG data too large, truncated\n");
-    // logLine("[Snap] JPEG数据过大，已截断");
-    http.end();
+  char path[WRITE_BEHIND_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/.counter%d", dir, slot);
+  queueSdWrite(path, record, sizeof(record), WRITE_JOB_CLOSE | WRITE_JOB_SYNC);
+  return value;
+}
+
+// 扫描/images下新格式文件名（<前缀>_<6位序号>...）中的最大序号（没有时为-1）
+// 只在计数文件丢失或损坏时用于重建，旧的纯时间戳文件名（8位日期）不参与
+long scanMaxSnapshotSequence() {
+  long maxSeq = -1;
+  File root = SD.open("/images");
+  if (root) {
+    File file = root.openNextFile();
+    while (file) {
+      String fileName = file.name();
+      int lastSlash = fileName.lastIndexOf('/');
+      if (lastSlash >= 0) {
+        fileName = fileName.substring(lastSlash + 1);
+      }
+      
+      int underscore = fileName.indexOf('_');
+      int digits = 0;
+      while (underscore >= 0 && underscore + 1 + digits < (int)fileName.length() &&
+             isDigit(fileName[underscore + 1 + digits])) {
+        digits++;
+      }
+      if (digits == 6) {
+        long seq = fileName.substring(underscore + 1, underscore + 7).toInt();
+        if (seq > maxSeq) {
+          maxSeq = seq;
+        }
+      }
+      
+      file = root.openNextFile();
+    }
+    root.close();
+  }
+  return maxSeq;
+}
+
+// 生成照片文件名"/images/<prefix>_<序号>[_YYYYMMDD_HHMMSS]"（不含扩展名）
+// 序号来自持久化计数器，不查找目录：同一秒内连续拍摄也不会覆盖已有照片。
+// 时钟未同步时省略时间戳，避免出现1970年的文件名
+void makeSnapshotName(char* out, size_t cap, const char* prefix) {
+  if (!snapshotCounter.isLoaded() && !loadCounter(snapshotCounter, "/images")) {
+    snapshotCounter.reset(scanMaxSnapshotSequence() + 1);
+    serialPrintf("Snapshot counter rebuilt by scan, next %u\n", (unsigned)snapshotCounter.peek());
+  }
+  uint32_t seq = reserveCounter(snapshotCounter, "/images");
+  
+  time_t now = time(nullptr);
+  struct tm *timeinfo = localtime(&now);
+  if (SNAPSHOT_NAME_TIMESTAMP && timeinfo && timeinfo->tm_year + 1900 >= SNAPSHOT_CLOCK_VALID_YEAR) {
+    snprintf(out, cap, "/images/%s_%06u_%04d%02d%02d_%02d%02d%02d", prefix, (unsigned)seq,
+             timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday,
+             timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
+  } else {
+    snprintf(out, cap, "/images/%s_%06u", prefix, (unsigned)seq);
+  }
+}
+
+// 把拍照响应边收边写入SD卡的path（先写已读取的帧头），
+// 同时校验SOI/EOI并计算指纹，不在内存中缓存整帧。
+// offset<0时覆盖写整个文件并在结束时关闭（临时文件CAPTURE_TEMP_PATH，成功时由调用方重命名）；
+// offset>=0时从该位置定位写入已有文件，最多limit字节，文件保持打开（timelapse AVI）。
+// 接收缓冲区是帧池生产者槽里的两块CAPTURE_WRITE_CHUNK_SIZE（拍摄期间流已停止），
+// 一块攒满后整块交给写入任务追加，另一块继续接收：每张照片只有几次整簇大小的写入，
+// 文件内写入位置始终按簇对齐，也不需要每张照片分配内存。
+// 返回时数据已写完
+bool streamCaptureToFile(HTTPClient& http, const char* tag, const char* path, long offset, size_t limit,
+                         const uint8_t* head, size_t headLen, int remaining, FrameFingerprint& fp) {
+  JpegStreamCheck check;
+  FrameHasher hasher;
+  uint32_t failedBefore = sdWriteQueue.failed;
+  bool ok = true;
+  bool first = true;
+  // 临时文件第一块覆盖写、之后追加；定位写入每块都带上自己的位置
+  uint8_t firstFlags = offset >= 0 ? WRITE_JOB_SEEK : 0;
+  uint8_t nextFlags = offset >= 0 ? WRITE_JOB_SEEK : WRITE_JOB_APPEND;
+  size_t submitted = 0;
+  if (limit > 0 && headLen > limit) {
+    serialPrintf("[%s] Frame larger than %u bytes\n", tag, (unsigned)limit);
     return false;
   }
   
-  // 提取完整的JPEG帧
-  size_t validSize = trimToEOI(jpg, jpgSize);
-  if (validSize == 0) {
-    serialPrintf("[Snap] Invalid JPEG data, no complete frame\n");
-    // logLine("[Snap] 无效的JPEG数据，没有完整帧");
-    http.end();
-    return false;
+  uint8_t* slot = framePool.writeSlot().data;
+  uint8_t* buffers[2] = {slot, slot + CAPTURE_WRITE_CHUNK_SIZE};
+  sdWriteQueue.attachBuffers(buffers, 2, CAPTURE_WRITE_CHUNK_SIZE);
+  
+  // 两块都空闲，第一块即槽的开头（帧头通常已在原地）
+  int buffer = sdWriteQueue.acquireBuffer();
+  uint8_t* chunk = sdWriteQueue.bufferData(buffer);
+  if (head != chunk) {
+    memcpy(chunk, head, headLen);
   }
+  size_t filled = headLen;
+  check.feed(chunk, headLen);
+  hasher.update(chunk, headLen);
   
-  // 保存到appState供以后使用
-  memcpy(appState.jpegData, jpg, validSize);
-  appState.jpegDataSize = validSize;
+  WiFiClient* s = http.getStreamPtr();
+  while (ok && remaining != 0) {
+    if (filled == CAPTURE_WRITE_CHUNK_SIZE) {
+      sdWriteQueue.submit(buffer, path, filled, micros(), first ? firstFlags : nextFlags,
+                          offset + submitted);
+      xTaskNotifyGive(sdWriterTaskHandle);
+      first = false;
+      submitted += filled;
+      filled = 0;
+      
+      // 等待另一块写完（写卡比网络慢时的背压）
+      unsigned long waitStart = millis();
+      while ((buffer = sdWriteQueue.acquireBuffer()) < 0 && millis() - waitStart < SD_WRITER_WAIT_MS) {
+        delay(1);
+      }
+      if (buffer < 0) {
+        ok = false;
+        break;
+      }
+      chunk = sdWriteQueue.bufferData(buffer);
+      continue;
+    }
+    
+    // 没有数据时让出CPU（等待一个tick），不空转查询available()
+    int available = s->available();
+    if (available <= 0) {
+      if (!http.connected()) {
+        break;
+      }
+      delay(1);
+      continue;
+    }
+    
+    // 一次取走socket中已有的数据（最多填满当前块）
+    int want = min(available, (int)(CAPTURE_WRITE_CHUNK_SIZE - filled));
+    if (remaining > 0 && want > remaining) {
+      want = remaining;
+    }
+    int bytesRead = s->read(chunk + filled, want);
+    if (bytesRead <= 0) {
+      break;
+    }
+    if (limit > 0 && check.bytes() + bytesRead > limit) {
+      serialPrintf("[%s] Frame larger than %u bytes\n", tag, (unsigned)limit);
+      ok = false;
+      break;
+    }
+    check.feed(chunk + filled, bytesRead);
+    hasher.update(chunk + filled, bytesRead);
+    filled += bytesRead;
+    if (remaining > 0) {
+      remaining -= bytesRead;
+    }
+  }
   
-  // 验证JPEG尺寸
-  int width, height;
-  if (parseJpegSize(appState.jpegData, appState.jpegDataSize, width, height)) {
-    serialPrintf("[Snap] JPEG size: %dx%d\n", width, height);
-    // logLine(String("[Snap] JPEG尺寸: ") + width + "x" + height);
+  // 最后一块（可能为空）落盘，临时文件同时关闭；写完后槽归还帧池
+  uint8_t lastFlags = offset >= 0 ? 0 : WRITE_JOB_CLOSE | WRITE_JOB_SYNC;
+  if (buffer >= 0) {
+    sdWriteQueue.submit(buffer, path, filled, micros(), (first ? firstFlags : nextFlags) | lastFlags,
+                        offset + submitted);
+    xTaskNotifyGive(sdWriterTaskHandle);
+  } else if (offset < 0) {
+    // 没有空闲块时用空任务关闭文件
+    queueSdWrite(path, nullptr, 0, WRITE_JOB_APPEND | WRITE_JOB_CLOSE);
   }
+  ok = waitSdWrites(SD_WRITER_WAIT_MS) && ok;
+  sdWriteQueue.detachBuffers();
   
-  http.end();
+  if (!ok || sdWriteQueue.failed != failedBefore) {
+    serialPrintf("[%s] SD write failed\n", tag);
+    return false;
+  }
+  if (remaining > 0) {
+    serialPrintf("[%s] Incomplete photo: %u bytes missing\n", tag, (unsigned)remaining);
+    return false;
+  }
+  if (!check.complete()) {
+    serialPrintf("[%s] Invalid JPEG data, no complete frame\n", tag);
+    return false;
+  }
+  if (check.trailingBytes() > 0) {
+    serialPrintf("[%s] %u bytes after EOI\n", tag, (unsigned)check.trailingBytes());
+  }
   
-  // 设置低分辨率（拍摄后）
-  // logLine("Setting low resolution after capture...");
-  if (!setCameraResolution(CAMERA_RESOLUTION_LOW)) {
-    // logLine("Failed to set low resolution");
+  fp = hasher.result();
+  serialPrintf("[%s] Written: %u bytes\n", tag, (unsigned)check.bytes());
+  return true;
+}
+
+// 把校验通过的临时文件重命名为最终文件名（FAT上rename不覆盖已有文件）
+bool commitCaptureFile(const char* path) {
+  if (SD.exists(path)) {
+    SD.remove(path);
+  }
+  if (!SD.rename(CAPTURE_TEMP_PATH, path)) {
+    serialPrintf("[Capture] Failed to rename to %s\n", path);
+    SD.remove(CAPTURE_TEMP_PATH);
     return false;
   }
+  return true;
+}
+
+// 通过相机快照接口获取高清无边框JPEG并直接保存到SD卡的path
+// 只发一次请求；返回的是相机缓冲区中的旧帧（分辨率不符或与上次相同）时才轮询重试
+bool captureSnapshot(const char* path) {
+  // 拍摄前停止MJPEG流以防止资源冲突（stop()同步关闭连接，无需额外等待）
+  // logLine("Stopping MJPEG stream before capture...");
+  streamHttp.end();
+  streamClient.stop();
   
-  // 设置低质量（拍摄后，恢复串流模式）
-  if (!setCameraQuality(0)) {
-    // logLine("Failed to set low quality");
+  // 设置高分辨率和高质量（拍摄前），两条命令一起入队，在同一连接上连续发出
+  queueCameraControl("framesize", CAMERA_RESOLUTION_HIGH);
+  queueCameraControl("quality", 2);
+  if (!flushCameraControls(15000)) {
+    // logLine("Failed to set high resolution");
     return false;
   }
+  captureFreshness.expectFramesize(CAMERA_RESOLUTION_HIGH);
+  
+  // 帧头借用帧池的生产者槽（拍摄期间流已停止）
+  uint8_t* head = framePool.writeSlot().data;
+  bool saved = false;
+  
+  for (int attempt = 1; attempt <= CAPTURE_MAX_ATTEMPTS; attempt++) {
+    // 拿到旧帧后短暂等待再请求（20ms起指数递增）
+    if (attempt > 1) {
+      delay(CAPTURE_RETRY_BASE_MS << (attempt - 2));
+    }
+    
+    HTTPClient http;
+    size_t headLen = 0;
+    int len = 0;
+    CaptureVerdict verdict;
+    if (!openCaptureRequest(http, "Snap", head, CAPTURE_HEAD_SIZE, headLen, len, verdict)) {
+      break;
+    }
+    if (verdict == CAPTURE_STALE) {
+      continue;
+    }
+    
+    // 验证JPEG尺寸
+    int width, height;
+    if (parseJpegSize(head, headLen, width, height)) {
+      serialPrintf("[Snap] JPEG size: %dx%d\n", width, height);
+      // logLine(String("[Snap] JPEG尺寸: ") + width + "x" + height);
+    }
+    
+    FrameFingerprint fp;
+    bool written = streamCaptureToFile(http, "Snap", CAPTURE_TEMP_PATH, -1, 0, head, headLen, len, fp);
+    http.end();
+    if (!written) {
+      SD.remove(CAPTURE_TEMP_PATH);
+      break;
+    }
+    
+    // 与上一次拍到的帧完全相同，说明仍是缓冲区里的旧帧
+    if (captureFreshness.checkFrame(fp) == CAPTURE_STALE && attempt < CAPTURE_MAX_ATTEMPTS) {
+      serialPrintf("[Snap] Stale frame (same as last shot), retrying\n");
+      SD.remove(CAPTURE_TEMP_PATH);
+      continue;
+    }
+    
+    captureFreshness.accept(fp, attempt);
+    serialPrintf("[Snap] Fresh frame after %d request(s)\n", attempt);
+    
+    saved = commitCaptureFile(path);
+    break;
+  }
+  
+  // 恢复低分辨率和低质量（拍摄后，恢复串流模式），失败时也要恢复
+  queueCameraControl("framesize", streamResolution());
+  queueCameraControl("quality", streamQuality());
+  resolutionSwitch.request(streamResolution(), millis());
+  if (!flushCameraControls(15000)) {
+    // logLine("Failed to set low resolution");
+  }
   
   // 拍摄后重启MJPEG流
   // logLine("Restarting MJPEG stream after capture...");
   appState.isRestartStream = true;
   
-  return true;
+  return saved;
 }
 
-// 处理MJPEG流
-void processMjpegStream(WiFiClient& client) {
-  static uint8_t jpegBuffer[GLOBAL_MAX_JPEG_SIZE];
-  static size_t jpegIndex = 0;
-  static bool inFrame = false;
-  static uint8_t lastByte = 0;
+// 连拍单张：拍照数据整张读入buf（拍摄期间不写SD卡），返回JPEG长度，失败返回0
+size_t fetchBurstShot(uint8_t* buf, size_t cap) {
+  for (int attempt = 1; attempt <= CAPTURE_MAX_ATTEMPTS; attempt++) {
+    if (attempt > 1) {
+      delay(CAPTURE_RETRY_BASE_MS << (attempt - 2));
+    }
+    
+    HTTPClient http;
+    size_t got = 0;
+    int len = 0;
+    CaptureVerdict verdict;
+    if (!openCaptureRequest(http, "Burst", buf, min(cap, (size_t)CAPTURE_HEAD_SIZE), got, len, verdict)) {
+      return 0;
+    }
+    if (verdict == CAPTURE_STALE) {
+      continue;
+    }
+    
+    WiFiClient* s = http.getStreamPtr();
+    while (len != 0 && got < cap) {
+      int available = s->available();
+      if (available <= 0) {
+        if (!http.connected()) {
+          break;
+        }
+        delay(1);
+        continue;
+      }
+      int want = min(available, (int)(cap - got));
+      if (len > 0 && want > len) {
+        want = len;
+      }
+      int bytesRead = s->readBytes(buf + got, want);
+      if (bytesRead <= 0) {
+        break;
+      }
+      got += bytesRead;
+      if (len > 0) {
+        len -= bytesRead;
+      }
+    }
+    http.end();
+    
+    // 没读完（断开或超出缓冲区）
+    if (len > 0 || (len < 0 && got >= cap)) {
+      serialPrintf("[Burst] Shot incomplete or larger than %u bytes\n", (unsigned)cap);
+      return 0;
+    }
+    
+    size_t size = trimToEOI(buf, got);
+    if (size == 0) {
+      serialPrintf("[Burst] Invalid JPEG data, no complete frame\n");
+      return 0;
+    }
+    
+    FrameFingerprint fp = fingerprintFrame(buf, size);
+    if (captureFreshness.checkFrame(fp) == CAPTURE_STALE && attempt < CAPTURE_MAX_ATTEMPTS) {
+      continue;
+    }
+    captureFreshness.accept(fp, attempt);
+    return size;
+  }
+  return 0;
+}
 
-  // 每次只处理一定数量的字节以避免阻塞
-  const int MAX_BYTES_PER_CALL = 2048;
+// 连拍：网络拍摄第k+1张的同时，写入任务把第k张写入SD卡
+// 连拍期间流水线已暂停，借用帧池的各个槽作为写回缓冲区；缓冲区用完时等待写入（背压）
+bool captureBurst(int shots) {
+  streamHttp.end();
+  streamClient.stop();
+  
+  queueCameraControl("framesize", CAMERA_RESOLUTION_BURST);
+  queueCameraControl("quality", 2);
+  if (!flushCameraControls(15000)) {
+    return false;
+  }
+  captureFreshness.expectFramesize(CAMERA_RESOLUTION_BURST);
+  
+  // 同一次连拍共用一个照片序号，文件按张数区分
+  // 取号会把计数器记录交给写入任务，放在清零统计之前，written只计连拍的照片
+  char prefix[48];
+  makeSnapshotName(prefix, sizeof(prefix), "BST");
+  
+  // 先让之前的写盘任务（包括计数器记录）完成，统计只包含本次连拍
+  waitSdWrites(SD_WRITER_WAIT_MS);
+  sdWriteQueue.resetStats();
+  uint8_t* buffers[FramePool::SLOT_COUNT];
+  for (int i = 0; i < FramePool::SLOT_COUNT; i++) {
+    buffers[i] = frameStorage + i * GLOBAL_MAX_JPEG_SIZE;
+  }
+  sdWriteQueue.attachBuffers(buffers, FramePool::SLOT_COUNT, GLOBAL_MAX_JPEG_SIZE);
+  
+  unsigned long burstStart = millis();
+  LatencyStats fetchTime;
+  bool sdStalled = false;
+  for (int k = 0; k < shots; k++) {
+    // 等待空闲缓冲区（写卡比拍照慢时的背压），SD卡卡住或出错时放弃剩下的张数
+    int buffer;
+    unsigned long waitStart = millis();
+    while ((buffer = sdWriteQueue.acquireBuffer()) < 0 && millis() - waitStart < SD_WRITER_WAIT_MS) {
+      delay(1);
+    }
+    if (buffer < 0) {
+      serialPrintf("[Burst] SD writer stalled, aborting after %d shots\n", k);
+      sdStalled = true;
+      break;
+    }
+    
+    uint32_t shotStart = micros();
+    size_t size = fetchBurstShot(sdWriteQueue.bufferData(buffer), sdWriteQueue.bufferCapacity());
+    if (size == 0) {
+      sdWriteQueue.cancelBuffer(buffer);
+      continue;
+    }
+    fetchTime.add(micros() - shotStart);
+    
+    char path[WRITE_BEHIND_PATH_MAX];
+    snprintf(path, sizeof(path), "%s_%02d.jpg", prefix, k + 1);
+    sdWriteQueue.submit(buffer, path, size, shotStart);
+    xTaskNotifyGive(sdWriterTaskHandle);
+    
+    char progress[OVERLAY_TEXT_MAX];
+    snprintf(progress, sizeof(progress), "Burst %d/%d", k + 1, shots);
+    showLiveMessage(progress, 0);
+    compositeLiveOverlay(0, 0, 0, 0);
+  }
+  
+  // 等待最后几张写完，之后帧池的槽归还给流水线
+  if (!waitSdWrites(SD_WRITER_WAIT_MS)) {
+    serialPrintf("[Burst] SD writes still pending after %d ms\n", SD_WRITER_WAIT_MS);
+    sdStalled = true;
+  }
+  sdWriteQueue.detachBuffers();
+  unsigned long elapsed = millis() - burstStart;
+  
+  serialPrintf("[Burst] %u/%d saved in %lu ms (%.2f shots/s), fetch avg %lu ms, "
+               "shot-to-saved avg %lu ms max %lu ms, SD write avg %lu ms max %lu ms, "
+               "max depth %d, stalls %u, failed %u\n",
+               sdWriteQueue.written, shots, elapsed,
+               elapsed ? sdWriteQueue.written * 1000.0f / elapsed : 0.0f,
+               (unsigned long)(fetchTime.averageUs() / 1000),
+               (unsigned long)(sdWriteQueue.jobLatency.averageUs() / 1000),
+               (unsigned long)(sdWriteQueue.jobLatency.maxUs / 1000),
+               (unsigned long)(sdWriteQueue.writeTime.averageUs() / 1000),
+               (unsigned long)(sdWriteQueue.writeTime.maxUs / 1000),
+               sdWriteQueue.maxDepth, sdWriteQueue.stalls, sdWriteQueue.failed);
+  char summary[OVERLAY_TEXT_MAX];
+  if (sdStalled) {
+    snprintf(summary, sizeof(summary), "Burst aborted: SD card stalled (%u/%d saved)",
+             sdWriteQueue.written, shots);
+  } else {
+    snprintf(summary, sizeof(summary), "Burst %u/%d saved, %.1f/s", sdWriteQueue.written, shots,
+             elapsed ? sdWriteQueue.written * 1000.0f / elapsed : 0.0f);
+  }
+  showLiveMessage(summary);
+  compositeLiveOverlay(0, 0, 0, 0);
+  
+  // 恢复串流分辨率和质量
+  queueCameraControl("framesize", streamResolution());
+  queueCameraControl("quality", streamQuality());
+  resolutionSwitch.request(streamResolution(), millis());
+  flushCameraControls(15000);
+  appState.isRestartStream = true;
+  
+  return !sdStalled && sdWriteQueue.written > 0;
+}
+
+// serviceStream函数的前向声明
+int serviceStream(uint32_t deadlineUs);
+
+// 快速快门：不断开串流、不切换分辨率，保存按下快门后解析完成的下一帧
+// 调用前流水线已暂停，由loop直接驱动串流读取
+bool captureStreamFrame(const char* path) {
+  uint32_t baseline = framePool.framesPublished;
+  unsigned long start = millis();
+  while (framePool.framesPublished == baseline) {
+    if (millis() - start > FAST_SHUTTER_TIMEOUT_MS) {
+      serialPrintf("[Fast] No frame within %d ms\n", FAST_SHUTTER_TIMEOUT_MS);
+      return false;
+    }
+    if (serviceStream(micros() + STREAM_INGEST_BUDGET_US) == 0) {
+      delay(1);
+    }
+  }
+  
+  // 解码任务已停驻，loop暂时作为帧池的消费者
+  const FrameSlot* frame = framePool.acquire();
+  if (!frame) {
+    return false;
+  }
+  
+  // 帧已由解析器确认完整，拷贝一份交给写入任务直接写到最终文件名，loop不等待写卡
+  serialPrintf("[Fast] Frame %u queued, %u bytes, wait %lu ms\n",
+               frame->seq, (unsigned)frame->size, millis() - start);
+  return queueSdWrite(path, frame->data, frame->size, WRITE_JOB_CLOSE);
+}
+
+// 切换快速快门模式（串流分辨率在进入/退出时切换一次，之后拍照不再重连）
+// 串流保持连接，每帧按SOF得到新尺寸；相机不出新分辨率的帧时由接收任务超时重连
+void setFastShutterMode(bool enabled) {
+  isFastShutterMode = enabled;
+  queueCameraControl("framesize", streamResolution());
+  queueCameraControl("quality", streamQuality());
+  resolutionSwitch.request(streamResolution(), millis());
+  flushCameraControls(5000);
+  serialPrintf("Fast shutter mode: %d\n", isFastShutterMode);
+}
+
+// 输出流解析统计（由接收任务的调度器每STREAM_STATS_PERIOD_US调用一次）
+void logStreamStats() {
+  static unsigned long lastStatsTime = 0;
+  static uint64_t lastBytes = 0;
+  static uint32_t lastFrames = 0;
+
+  unsigned long now = millis();
+  unsigned long elapsed = now - lastStatsTime;
+  // 取走解码任务累计的本窗口延迟（原子交换，不与解码任务的写入冲突）
+  LatencyStats latency = frameLatency.take();
+  LatencyStats decode = decodeTime.take();
+  if (lastStatsTime != 0 && elapsed > 0) {
+    float mbps = (streamReader.bytesScanned - lastBytes) / (elapsed * 1000.0f);
+    float fps = (streamReader.framesCompleted - lastFrames) * 1000.0f / elapsed;
+    serialPrintf("[Stream] %.2f MB/s, %.1f fps, overflow %u, replaced %u, by length %u, by scan %u, malformed %u\n",
+                 mbps, fps, (unsigned)streamReader.framesOverflowed,
+                 (unsigned)framePool.framesReplaced, (unsigned)streamReader.framesByLength,
+                 (unsigned)streamReader.framesByScan, (unsigned)streamReader.partsMalformed);
+    serialPrintf("[Pipeline] latency avg %u us, max %u us, drawn %u\n",
+                 (unsigned)latency.averageUs(), (unsigned)latency.maxUs,
+                 (unsigned)latency.count);
+    serialPrintf("[Preview] scale 1/%d, decode avg %u us, max %u us\n",
+                 lastPlacement.scale, (unsigned)decode.averageUs(),
+                 (unsigned)decode.maxUs);
+    serialPrintf("[Watchdog] stalls %u (with data %u), drops %u, connect failures %u, "
+                 "recover avg %u ms, max %u ms, longest freeze %u ms\n",
+                 (unsigned)streamWatchdog.stalls, (unsigned)streamWatchdog.stallsWithData,
+                 (unsigned)streamWatchdog.drops, (unsigned)streamWatchdog.connectFailures,
+                 (unsigned)(streamWatchdog.recoverTime.averageUs() / 1000),
+                 (unsigned)(streamWatchdog.recoverTime.maxUs / 1000),
+                 (unsigned)streamWatchdog.longestFreezeMs);
+    if (resolutionSwitch.requests > 0) {
+      serialPrintf("[Res] switches %u, live avg %u ms max %u ms (%u), reconnect avg %u ms max %u ms (%u), "
+                   "old frames %u, fallbacks %u\n",
+                   (unsigned)resolutionSwitch.requests,
+                   (unsigned)(resolutionSwitch.liveLatency.averageUs() / 1000),
+                   (unsigned)(resolutionSwitch.liveLatency.maxUs / 1000),
+                   (unsigned)resolutionSwitch.liveLatency.count,
+                   (unsigned)(resolutionSwitch.reconnectLatency.averageUs() / 1000),
+                   (unsigned)(resolutionSwitch.reconnectLatency.maxUs / 1000),
+                   (unsigned)resolutionSwitch.reconnectLatency.count,
+                   (unsigned)resolutionSwitch.oldFrames, (unsigned)resolutionSwitch.fallbacks);
+    }
+    serialPrintf("[Adapt] level %d (framesize %d, quality %d), up %u, down %u, failed probes %u, "
+                 "held by RSSI %u, by decode %u\n",
+                 previewBitrate.level(), previewBitrate.currentLevel().framesize,
+                 previewBitrate.currentLevel().quality, (unsigned)previewBitrate.stepsUp,
+                 (unsigned)previewBitrate.stepsDown, (unsigned)previewBitrate.failedProbes,
+                 (unsigned)previewBitrate.rssiHeld, (unsigned)previewBitrate.decodeHeld);
+  }
+
+  lastStatsTime = now;
+  lastBytes = streamReader.bytesScanned;
+  lastFrames = streamReader.framesCompleted;
+}
+
+// 处理MJPEG流直到截止时刻deadlineUs（micros()），返回本次读取的字节数
+int processMjpegStream(WiFiClient& client, uint32_t deadlineUs) {
+  static uint8_t chunk[MJPEG_READ_CHUNK_SIZE];
+
+  // 解析器始终写入帧池当前的生产者槽
+  FrameSlot& slot = framePool.writeSlot();
+  if (streamReader.frameData() != slot.data) {
+    streamReader.setBuffer(slot.data, framePool.slotCapacity());
+  }
+
+  // 按时间而不是字节数分段：每次调用的耗时不随链路速度和read()开销变化
   int processed = 0;
 
-  while (client.available() && processed < MAX_BYTES_PER_CALL) {
-    uint8_t data = client.read();
-    processed++;
-
-    // SOI检测 (FF D8)
-    if (lastByte == 0xFF && data == 0xD8) {
-      // 检测到SOI，无条件清空所有状态，确保jpegBuffer从SOI开始
-      jpegIndex = 0;
-      jpegBuffer[jpegIndex++] = 0xFF;
-      jpegBuffer[jpegIndex++] = 0xD8;
-      inFrame = true;
-    } else if (inFrame) {
-      // 帧内处理
-      jpegBuffer[jpegIndex++] = data;
-
-      // 如果帧太长则直接丢弃
-      if (jpegIndex >= GLOBAL_MAX_JPEG_SIZE) {
-        jpegIndex = 0;
-        inFrame = false;
-        lastByte = 0;
-        continue;
-      }
+  while ((int32_t)(micros() - deadlineUs) < 0) {
+    int available = client.available();
+    if (available <= 0) {
+      break;
+    }
 
-      // EOI检测 (FF D9)
-      if (lastByte == 0xFF && data == 0xD9) {
-        // 如果上一帧还未被消费则直接丢弃
-        if (!appState.jpegReady) {
-          memcpy(appState.jpegData, jpegBuffer, jpegIndex);
-          appState.jpegDataSize = jpegIndex;
-          appState.jpegReady = true;
+    // 批量读取，避免逐字节调用read()
+    int toRead = min(available, (int)sizeof(chunk));
+    int bytesRead = client.read(chunk, toRead);
+    if (bytesRead <= 0) {
+      break;
+    }
+    processed += bytesRead;
+    streamWatchdog.noteBytes(bytesRead);
+
+    size_t offset = 0;
+    while (offset < (size_t)bytesRead) {
+      offset += streamReader.feed(chunk + offset, bytesRead - offset);
+
+      if (streamReader.frameReady()) {
+        // 每帧从SOF取尺寸，串流中途切换分辨率时显示端按新尺寸摆放
+        FrameSlot& done = framePool.writeSlot();
+        int width = 0, height = 0;
+        parseJpegSize(done.data, streamReader.frameSize(), width, height);
+        done.width = width;
+        done.height = height;
+        if (resolutionSwitch.frame(width, height, millis())) {
+          serialPrintf("[Res] First %dx%d frame %lu ms after request (%s)\n", width, height,
+                       (unsigned long)resolutionSwitch.lastLatencyMs,
+                       resolutionSwitch.lastWasLive ? "live" : "reconnect");
+        }
+        
+        // 发布完成的帧（若上一帧尚未显示则被替换），切换到新的空闲槽继续写入
+        FrameSlot& next = framePool.publish(streamReader.frameSize(), micros());
+        streamReader.consumeFrame();
+        streamReader.setBuffer(next.data, framePool.slotCapacity());
+        streamWatchdog.noteFrame(millis());
+        
+        // 唤醒解码任务
+        if (decodeTaskHandle) {
+          xTaskNotifyGive(decodeTaskHandle);
         }
-        jpegIndex = 0;
-        inFrame = false;
       }
     }
-
-    lastByte = data;
   }
+
+  return processed;
 }
 
 // 初始化硬件
@@ -446,6 +1178,26 @@ void initHardware() {
   M5Cardputer.begin();
   Serial.begin(115200);
   
+  // 初始化帧池
+  framePool.init(frameStorage, GLOBAL_MAX_JPEG_SIZE);
+  
+  // SD卡写回队列和写入任务（initWiFi中就会保存相机状态，需先于流水线启动）
+  sdWriteQueue.setCopyLimit(SD_WRITER_COPY_LIMIT);
+  statusTelemetry.begin(TELEMETRY_FREE_SPACE_PERIOD_MS, TELEMETRY_BATTERY_PERIOD_MS);
+  streamWatchdog.begin(STREAM_STALL_MS, STREAM_BACKOFF_MIN_MS, STREAM_BACKOFF_MAX_MS);
+  PreviewAdaptConfig previewConfig;
+  previewConfig.targetFps = PREVIEW_TARGET_FPS;
+  previewBitrate.begin(previewLadder, sizeof(previewLadder) / sizeof(previewLadder[0]),
+                       PREVIEW_LADDER_START, previewConfig);
+  xTaskCreatePinnedToCore(sdWriterTask, "sdwriter", PIPELINE_TASK_STACK, nullptr, 1,
+                          &sdWriterTaskHandle, PIPELINE_DECODE_CORE);
+  
+  // 初始化控制通道互斥锁（initWiFi中就会发送控制命令）
+  controlMutex = xSemaphoreCreateMutex();
+  
+  // 状态文字叠加层（解码任务启动前定义好字段）
+  initStatusOverlays();
+  
   // 初始化LCD显示
   M5Cardputer.Display.setRotation(1);
   M5Cardputer.Display.fillScreen(BLACK);
@@ -478,10 +1230,141 @@ void initHardware() {
     return;
   }
   
-  isSDInitialized = true;
-  M5Cardputer.Display.setCursor(10, 25);
-  M5Cardputer.Display.println("SD card initialized successfully!");
-  Serial.println("SD card initialized successfully!");
+  isSDInitialized = true;
+  M5Cardputer.Display.setCursor(10, 25);
+  M5Cardputer.Display.println("SD card initialized successfully!");
+  Serial.println("SD card initialized successfully!");
+}
+
+// 查找命令对应的统计项
+ControlMetric* findControlMetric(const String& name) {
+  for (size_t i = 0; i < CONTROL_METRICS_COUNT; i++) {
+    if (name == controlMetrics[i].name) {
+      return &controlMetrics[i];
+    }
+  }
+  return nullptr;
+}
+
+// 通过控制通道发送GET请求，返回HTTP状态码，response非空时返回响应内容
+// 连接失效（相机关闭空闲连接等）时断开重连并重试一次
+int sendControlRequest(const String& path, const String& metricName, String* response, uint16_t timeout = 10000) {
+  // 控制任务和UI都会发送请求，共用连接需要互斥
+  xSemaphoreTake(controlMutex, portMAX_DELAY);
+  
+  String url = String(CAMERA_BASE_URL) + path;
+  unsigned long startUs = micros();
+  int code = -1;
+  
+  for (int attempt = 0; attempt < 2; attempt++) {
+    controlHttp.setReuse(true);
+    controlHttp.begin(controlClient, url);
+    controlHttp.addHeader("User-Agent", "M5Cardputer");
+    controlHttp.setTimeout(timeout);
+    
+    code = controlHttp.GET();
+    if (code > 0) {
+      break;
+    }
+    
+    serialPrintf("[Ctrl] %s failed (%d), reconnecting\n", metricName.c_str(), code);
+    controlHttp.end();
+    controlClient.stop();
+  }
+  
+  logHttpResponseHeaders("ctrl", code, controlHttp);
+  
+  // 读完响应体，连接才能被下一次请求复用
+  String body = code > 0 ? controlHttp.getString() : String();
+  if (response) {
+    *response = body;
+  }
+  controlHttp.end();
+  
+  ControlMetric* metric = findControlMetric(metricName);
+  if (metric) {
+    metric->latency.add(micros() - startUs);
+    if (code != 200) {
+      metric->failures++;
+    }
+  }
+  
+  xSemaphoreGive(controlMutex);
+  return code;
+}
+
+// 发送/api/v1/control参数设置命令
+int sendCameraControl(const String& var, int value, String* response = nullptr) {
+  return sendControlRequest(String("/api/v1/control?var=") + var + "&val=" + value, var, response);
+}
+
+// 参数更新入队并唤醒控制任务（不阻塞）
+void queueCameraControl(const char* var, int value) {
+  if (!controlQueue.set(var, value)) {
+    serialPrintf("[Ctrl] queue full, dropped %s=%d\n", var, value);
+    return;
+  }
+  if (controlTaskHandle) {
+    xTaskNotifyGive(controlTaskHandle);
+  }
+}
+
+// 等待队列中的参数全部发出，返回期间是否全部成功
+bool flushCameraControls(unsigned long timeoutMs) {
+  uint32_t failedBefore = controlQueue.failed;
+  if (controlTaskHandle) {
+    xTaskNotifyGive(controlTaskHandle);
+  }
+  
+  unsigned long start = millis();
+  while (!controlQueue.idle()) {
+    if (millis() - start >= timeoutMs) {
+      serialPrintf("[Ctrl] flush timeout, %d pending\n", controlQueue.pending());
+      return false;
+    }
+    delay(1);
+  }
+  return controlQueue.failed == failedBefore;
+}
+
+// 控制任务：被唤醒后一次性发出队列中所有挂起的参数更新（复用keep-alive连接）
+void cameraControlTask(void* param) {
+  for (;;) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    
+    ControlUpdate update;
+    while (controlQueue.pop(update)) {
+      int code = sendCameraControl(update.var, update.value);
+      controlQueue.complete(code == 200);
+      serialPrintf("[Ctrl] %s=%d -> HTTP %d\n", update.var, update.value, code);
+    }
+  }
+}
+
+// 输出各控制命令的延迟直方图
+void logControlLatency() {
+  serialPrintf("[Ctrl] queue: requested %u, issued %u, coalesced %u, failed %u\n",
+               (unsigned)controlQueue.requested, (unsigned)controlQueue.issued,
+               (unsigned)controlQueue.coalesced, (unsigned)controlQueue.failed);
+  for (size_t i = 0; i < CONTROL_METRICS_COUNT; i++) {
+    const ControlMetric& m = controlMetrics[i];
+    if (m.latency.stats.count == 0) {
+      continue;
+    }
+    serialPrintf("[Ctrl] %s: n=%u fail=%u avg %u us p50<%u ms p95<%u ms max %u us\n",
+                 m.name, (unsigned)m.latency.stats.count, (unsigned)m.failures,
+                 (unsigned)m.latency.stats.averageUs(),
+                 (unsigned)m.latency.percentileMs(50), (unsigned)m.latency.percentileMs(95),
+                 (unsigned)m.latency.stats.maxUs);
+    for (int b = 0; b < LatencyHistogram::BUCKET_COUNT; b++) {
+      if (b < LatencyHistogram::BUCKET_COUNT - 1) {
+        serialPrintf("[Ctrl]   <%u ms: %u\n",
+                     (unsigned)LatencyHistogram::bucketLimitMs(b), (unsigned)m.latency.buckets[b]);
+      } else {
+        serialPrintf("[Ctrl]   >=500 ms: %u\n", (unsigned)m.latency.buckets[b]);
+      }
+    }
+  }
 }
 
 // 设置相机分辨率
@@ -491,15 +1374,7 @@ bool setCameraResolution(int resolution) {
   M5Cardputer.Display.printf("Setting camera resolution to %d...\n", resolution);
   Serial.printf("Setting camera resolution to %d...\n", resolution);
   
-  HTTPClient http;
-  String url = String("http://192.168.4.1/api/v1/control?var=framesize&val=") + resolution;
-  
-  http.begin(url);
-  // 使用与Python代码一致的最小化请求头
-  http.addHeader("User-Agent", "M5Cardputer");
-  
-  int code = http.GET();
-  logHttpResponseHeaders("res", code, http);
+  int code = sendCameraControl("framesize", resolution);
   
   M5Cardputer.Display.setCursor(10, 115);
   
@@ -507,20 +1382,13 @@ bool setCameraResolution(int resolution) {
     serialPrintf("[Res] HTTP %d\n", code);
     // logLine(String("[Res] HTTP ") + code);
     M5Cardputer.Display.println("Resolution setup failed!");
-    http.end();
     return false;
   }
   
-  http.end();
   serialPrintf("Camera resolution set to %d successfully\n", resolution);
   // logLine("Camera resolution set successfully");
   M5Cardputer.Display.println("Camera resolution set!");
   
-  // 清除图像尺寸缓存（因为分辨率改变了）
-  appState.sizeCached = false;
-  appState.cachedImgWidth = 0;
-  appState.cachedImgHeight = 0;
-  
   return true;
 }
 
@@ -530,93 +1398,36 @@ bool setCameraQuality(int quality) {
   displayLine(String("Setting quality to ") + quality + "...");
   Serial.printf("Setting camera quality to %d...\n", quality);
   
-  HTTPClient http;
-  String url = String("http://192.168.4.1/api/v1/control?var=quality&val=") + quality;
-  
-  http.begin(url);
-  // 使用与Python代码一致的最小化请求头
-  http.addHeader("User-Agent", "M5Cardputer");
-  
-  int code = http.GET();
-  logHttpResponseHeaders("qual", code, http);
+  int code = sendCameraControl("quality", quality);
   
   if (code != 200) {
     serialPrintf("[Qual] HTTP %d\n", code);
     // logLine(String("[Qual] HTTP ") + code);
     displayLine("Quality setup failed!");
-    http.end();
     return false;
   }
   
-  http.end();
   serialPrintf("Camera quality set to %d successfully\n", quality);
   // logLine("Camera quality set successfully");
   displayLine("Camera quality set!");
   return true;
 }
 
-// 设置相机特效
-bool setCameraSpecialEffect(int effect) {
-  // 在屏幕上显示相机特效设置信息
-  displayLine(String("Setting effect to ") + effect + "...");
-  Serial.printf("Setting camera effect to %d...\n", effect);
-  
-  HTTPClient http;
-  String url = String("http://192.168.4.1/api/v1/control?var=special_effect&val=") + effect;
-  
-  http.begin(url);
-  // 使用与Python代码一致的最小化请求头
-  http.addHeader("User-Agent", "M5Cardputer");
-  
-  int code = http.GET();
-  logHttpResponseHeaders("effect", code, http);
-  
-  if (code != 200) {
-    serialPrintf("[Effect] HTTP %d\n", code);
-    // logLine(String("[Effect] HTTP ") + code);
-    displayLine("Effect setup failed!");
-    http.end();
-    return false;
-  }
-  
-  http.end();
-  serialPrintf("Camera effect set to %d successfully\n", effect);
-  // logLine("Camera effect set successfully");
-  displayLine("Camera effect set!");
-  return true;
-}
-
 // 获取相机配置并保存到SD卡
 bool getCameraConfig() {
   // 在屏幕上显示获取配置信息
   displayLine("Getting camera status...");
   Serial.println("Getting camera status...");
   
-  HTTPClient http;
-  String url = "http://192.168.4.1/api/v1/status";
-  
-  http.begin(url);
-  http.addHeader("User-Agent", "M5Cardputer");
-  http.setTimeout(15000);
-  
-  int code = http.GET();
-  logHttpResponseHeaders("status", code, http);
+  String statusData;
+  int code = sendControlRequest("/api/v1/status", "status", &statusData, 15000);
   
   if (code != 200) {
     serialPrintf("[Config] HTTP %d\n", code);
     displayLine("Failed to get status!");
-    http.end();
     return false;
   }
   
-  // 获取响应数据长度
-  int contentLength = http.getSize();
-  serialPrintf("Content length: %d bytes\n", contentLength);
-  
-  // 获取响应数据
-  String statusData = http.getString();
-  http.end();
-  
   // 调试：打印从摄像头获取的原始状态数据
   Serial.printf("Raw status data length: %d\n", statusData.length());
   Serial.printf("Raw status data from camera: %s\n", statusData.c_str());
@@ -640,18 +1451,9 @@ bool getCameraConfig() {
     SD.mkdir("/images");
   }
   
-  // 保存配置到SD卡
-  File statusFile = SD.open("/images/status.txt", FILE_WRITE);
-  if (!statusFile) {
-    serialPrintf("Failed to open status file\n");
-    displayLine("Failed to open file!");
-    return false;
-  }
-  
-  size_t bytesWritten = statusFile.print(statusData);
-  statusFile.close();
-  
-  if (bytesWritten != statusData.length()) {
+  // 保存配置到SD卡（交给写入任务）
+  if (!queueSdWrite("/images/status.txt", (const uint8_t*)statusData.c_str(), statusData.length(),
+                    WRITE_JOB_CLOSE | WRITE_JOB_SYNC)) {
     serialPrintf("Failed to write status data\n");
     displayLine("Failed to write!");
     return false;
@@ -674,7 +1476,8 @@ bool loadCameraStatus() {
     return false;
   }
   
-  // 读取status.txt文件
+  // 读取status.txt文件（先等待排队中的写入完成）
+  waitSdWrites(SD_WRITER_WAIT_MS);
   File statusFile = SD.open("/images/status.txt", FILE_READ);
   if (!statusFile) {
     serialPrintf("Failed to open status.txt for reading\n");
@@ -752,22 +1555,9 @@ bool loadCameraStatus() {
   return true;
 }
 
-// 创建timelapse目录
-bool createTimelapseDir() {
-  if (!isSDInitialized) {
-    serialPrintf("SD card not initialized, cannot create timelapse directory\n");
-    return false;
-  }
-  
-  // 创建/images/timelapse主目录
-  if (!SD.exists("/images/timelapse")) {
-    if (!SD.mkdir("/images/timelapse")) {
-      serialPrintf("Failed to create /images/timelapse directory\n");
-      return false;
-    }
-  }
-  
-  // 查找最大的会话编号
+// 扫描/images/timelapse下的会话目录，返回最大编号（没有时为-1）
+// 只在计数文件丢失或损坏时用于重建
+int scanMaxTimelapseSession() {
   int maxSession = -1;
   File root = SD.open("/images/timelapse");
   if (root) {
@@ -789,15 +1579,47 @@ bool createTimelapseDir() {
     }
     root.close();
   }
+  return maxSession;
+}
+
+// 创建timelapse目录
+bool createTimelapseDir() {
+  if (!isSDInitialized) {
+    serialPrintf("SD card not initialized, cannot create timelapse directory\n");
+    return false;
+  }
   
-  // 新会话编号为最大编号+1，如果为空则为0
-  currentTimelapseSession = maxSession + 1;
+  // 创建/images/timelapse主目录
+  if (!SD.exists("/images/timelapse")) {
+    if (!SD.mkdir("/images/timelapse")) {
+      serialPrintf("Failed to create /images/timelapse directory\n");
+      return false;
+    }
+  }
   
-  // 生成子目录名称
-  char dirName[32];
-  snprintf(dirName, sizeof(dirName), "/images/timelapse/%d", currentTimelapseSession);
+  // 会话编号从持久化计数器取（不遍历目录），计数文件都无效时才扫描重建
+  if (!timelapseSessionCounter.isLoaded() &&
+      !loadCounter(timelapseSessionCounter, "/images/timelapse")) {
+    timelapseSessionCounter.reset(scanMaxTimelapseSession() + 1);
+    serialPrintf("Session counter rebuilt by scan, next %u\n",
+                 (unsigned)timelapseSessionCounter.peek());
+  }
   
-  currentTimelapseDir = String(dirName);
+  for (int attempt = 0; attempt < 2; attempt++) {
+    currentTimelapseSession = reserveCounter(timelapseSessionCounter, "/images/timelapse");
+    
+    // 生成子目录名称
+    char dirName[32];
+    snprintf(dirName, sizeof(dirName), "/images/timelapse/%d", currentTimelapseSession);
+    currentTimelapseDir = String(dirName);
+    
+    // 目录已存在说明计数器落后于卡上内容（例如换了卡），扫描重建后再取一次
+    if (!SD.exists(currentTimelapseDir)) {
+      break;
+    }
+    serialPrintf("%s already exists, rescanning\n", currentTimelapseDir.c_str());
+    timelapseSessionCounter.reset(scanMaxTimelapseSession() + 1);
+  }
   
   // 创建子目录
   if (!SD.mkdir(currentTimelapseDir)) {
@@ -824,8 +1646,6 @@ uint64_t getSDCardFreeSpace() {
 
 // 获取电池电量百分比
 int getBatteryPercentage() {
-  M5Cardputer.update();
-  
   float voltage = M5Cardputer.Power.getBatteryVoltage();
   
   // 假设电池电压范围：3.0V（0%）到4.2V（100%）
@@ -837,51 +1657,319 @@ int getBatteryPercentage() {
   return (int)percentage;
 }
 
+// 在当前会话目录下开始第part个AVI文件：写入文件头、JUNK头和空索引，
+// 再写最后一个字节，让文件一次扩展到预分配大小（之后每帧都不再分配簇）
+bool openTimelapseAvi(int part) {
+  int width = 0, height = 0;
+  framesizeDimensions(CAMERA_RESOLUTION_TIMELAPSE, width, height);
+  
+  // 预分配不超过剩余空间的一半，按扇区对齐（剩余空间取状态栏遥测的缓存，到了采样周期才遍历FAT）
+  uint64_t allocated = (uint64_t)TIMELAPSE_AVI_PREALLOC_MB * 1024 * 1024;
+  refreshStatusTelemetry();
+  uint64_t freeBytes = statusTelemetry.freeSpace();
+  if (allocated > freeBytes / 2) {
+    allocated = (freeBytes / 2) & ~(uint64_t)(AVI_HEADER_SIZE - 1);
+  }
+  timelapseAviPath[0] = '\0';
+  if (!timelapseAvi.begin(width, height, 1000000 / TIMELAPSE_AVI_PLAYBACK_FPS, (uint32_t)allocated)) {
+    serialPrintf("[AVI] Not enough space for a new file\n");
+    return false;
+  }
+  
+  char path[WRITE_BEHIND_PATH_MAX];
+  snprintf(path, sizeof(path), "%s/TL_%d_%02d.avi", currentTimelapseDir.c_str(), currentTimelapseSession, part);
+  
+  uint8_t header[AVI_HEADER_SIZE];
+  uint8_t gap[AVI_CHUNK_HEADER_SIZE];
+  uint8_t index[AVI_CHUNK_HEADER_SIZE];
+  uint8_t zero = 0;
+  timelapseAvi.buildInitial(header, gap, index);
+  
+  unsigned long start = millis();
+  uint32_t failedBefore = sdWriteQueue.failed;
+  // 第一次写入创建文件并保持打开，之后都是同一文件上的定位写入
+  bool ok = queueSdWrite(path, header, sizeof(header), 0) &&
+            queueSdWrite(path, gap, sizeof(gap), WRITE_JOB_SEEK, timelapseAvi.nextChunkOffset()) &&
+            queueSdWrite(path, &zero, 1, WRITE_JOB_SEEK, timelapseAvi.allocated() - 1) &&
+            queueSdWrite(path, index, sizeof(index), WRITE_JOB_SEEK | WRITE_JOB_SYNC, timelapseAvi.indexOffset());
+  ok = waitSdWrites(TIMELAPSE_AVI_WAIT_MS) && ok && sdWriteQueue.failed == failedBefore;
+  if (!ok) {
+    serialPrintf("[AVI] Failed to create %s\n", path);
+    return false;
+  }
+  
+  strncpy(timelapseAviPath, path, sizeof(timelapseAviPath));
+  timelapseAviPart = part;
+  serialPrintf("[AVI] %s preallocated %u KB in %lu ms\n", path,
+               (unsigned)(timelapseAvi.allocated() / 1024), millis() - start);
+  return true;
+}
+
+// 提交刚写入AVI的一帧：块头、索引项和文件头按AviFrameCommit的顺序交给写入任务，最后一项落盘
+bool commitTimelapseAviFrame(uint32_t size) {
+  AviFrameCommit commit;
+  timelapseAvi.commitFrame(size, commit);
+  const char* path = timelapseAviPath;
+  return queueSdWrite(path, commit.tail, commit.tailLen, WRITE_JOB_SEEK, commit.tailOffset) &&
+         queueSdWrite(path, commit.chunk, sizeof(commit.chunk), WRITE_JOB_SEEK, commit.chunkOffset) &&
+         queueSdWrite(path, commit.entry, sizeof(commit.entry), WRITE_JOB_SEEK, commit.entryOffset) &&
+         queueSdWrite(path, commit.index, sizeof(commit.index), WRITE_JOB_SEEK, commit.indexOffset) &&
+         queueSdWrite(path, commit.header, sizeof(commit.header), WRITE_JOB_SEEK | WRITE_JOB_SYNC, 0);
+}
+
+// 结束当前AVI：空间允许时把文件末尾索引区中的索引搬到movi之后并更新文件头，
+// 关闭后截断预分配的剩余部分。每一步之后文件都是有效的AVI
+bool closeTimelapseAvi() {
+  if (timelapseAviPath[0] == '\0') {
+    return true;
+  }
+  char path[WRITE_BEHIND_PATH_MAX];
+  strncpy(path, timelapseAviPath, sizeof(path));
+  timelapseAviPath[0] = '\0';
+  unsigned long start = millis();
+  uint32_t failedBefore = sdWriteQueue.failed;
+  
+  // 写入任务先关闭文件，之后由这里读取索引区
+  bool ok = queueSdWrite(path, nullptr, 0, WRITE_JOB_SEEK | WRITE_JOB_CLOSE, 0) &&
+            waitSdWrites(TIMELAPSE_AVI_WAIT_MS);
+  
+  if (ok && timelapseAvi.canCompact()) {
+    // 目标在源之前，每块读完后再写，不会覆盖还没读的索引（缓冲区借用帧池生产者槽，流已停止）
+    File file = SD.open(path, FILE_READ);
+    uint8_t* buffer = framePool.writeSlot().data;
+    size_t total = (size_t)timelapseAvi.frameCount() * AVI_INDEX_ENTRY_SIZE;
+    for (size_t done = 0; ok && done < total;) {
+      size_t n = min(total - done, (size_t)CAPTURE_WRITE_CHUNK_SIZE);
+      ok = file && file.seek(timelapseAvi.indexEntriesOffset() + done) && file.read(buffer, n) == n &&
+           queueSdWrite(path, buffer, n, WRITE_JOB_SEEK, timelapseAvi.finalEntriesOffset() + done) &&
+           waitSdWrites(TIMELAPSE_AVI_WAIT_MS);
+      done += n;
+    }
+    if (file) {
+      file.close();
+    }
+    
+    if (ok) {
+      uint8_t gap[AVI_CHUNK_HEADER_SIZE];
+      uint8_t index[AVI_CHUNK_HEADER_SIZE];
+      uint8_t header[AVI_HEADER_SIZE];
+      uint32_t gapOffset;
+      timelapseAvi.finish(gap, gapOffset, index, header);
+      ok = queueSdWrite(path, gap, sizeof(gap), WRITE_JOB_SEEK, gapOffset) &&
+           queueSdWrite(path, index, sizeof(index), WRITE_JOB_SEEK, timelapseAvi.indexOffset()) &&
+           queueSdWrite(path, header, sizeof(header), WRITE_JOB_SEEK | WRITE_JOB_SYNC | WRITE_JOB_CLOSE, 0);
+    }
+    ok = waitSdWrites(TIMELAPSE_AVI_WAIT_MS) && ok;
+  }
+  
+  if (!ok || sdWriteQueue.failed != failedBefore) {
+    // 写到一半的索引搬移不影响文件的有效性，只是没有去掉预分配的空间
+    serialPrintf("[AVI] Failed to finish %s, file keeps its preallocated size\n", path);
+    return false;
+  }
+  
+  String fullPath = String(SD_MOUNT_POINT) + path;
+  if (truncate(fullPath.c_str(), timelapseAvi.finalSize()) != 0) {
+    serialPrintf("[AVI] Truncate failed, file keeps %u KB preallocated\n",
+                 (unsigned)(timelapseAvi.allocated() / 1024));
+  }
+  statusTelemetry.invalidateFreeSpace();
+  serialPrintf("[AVI] %s closed: %u frames, %u KB, %lu ms\n", path, (unsigned)timelapseAvi.frameCount(),
+               (unsigned)(timelapseAvi.finalSize() / 1024), millis() - start);
+  return true;
+}
+
+// 定义timelapse界面和预览界面的状态字段（位置与原来直接绘制的文字相同）
+void initStatusOverlays() {
+  timelapseOverlay.reset();
+  tlFieldPhotos = timelapseOverlay.addField(5, 5, 100, 10);
+  tlFieldNext = timelapseOverlay.addField(5, 20, 100, 10);
+  tlFieldInterval = timelapseOverlay.addField(5, 35, 100, 10);
+  tlFieldSpace = timelapseOverlay.addField(SCREEN_WIDTH - 65, 5, 60, 10, OVERLAY_ALIGN_RIGHT);
+  tlFieldBattery = timelapseOverlay.addField(SCREEN_WIDTH - 65, 20, 60, 10, OVERLAY_ALIGN_RIGHT);
+  
+  liveOverlay.reset();
+  liveFieldMessage = liveOverlay.addField(10, 5, SCREEN_WIDTH - 20, 10);
+  liveOverlayMutex = xSemaphoreCreateMutex();
+}
+
+// 用黑底重画一个字段（调用方负责startWrite/endWrite）
+void paintOverlayField(const OverlayField& f) {
+  M5Cardputer.Display.fillRect(f.x, f.y, f.w, f.h, TFT_BLACK);
+  if (!f.text[0]) {
+    return;
+  }
+  M5Cardputer.Display.setTextSize(1);
+  M5Cardputer.Display.setTextColor(TFT_WHITE, TFT_BLACK);
+  int x = f.x;
+  if (f.align == OVERLAY_ALIGN_RIGHT) {
+    x = f.x + f.w - M5Cardputer.Display.textWidth(f.text);
+  }
+  M5Cardputer.Display.setCursor(x, f.y);
+  M5Cardputer.Display.print(f.text);
+}
+
+// 在预览画面上显示一条提示，LIVE_MESSAGE_MS后清除（durationMs为0时一直显示到下一条）
+void showLiveMessage(const char* text, uint32_t durationMs) {
+  xSemaphoreTake(liveOverlayMutex, portMAX_DELAY);
+  if (durationMs) {
+    liveOverlay.showFor(liveFieldMessage, text, millis(), durationMs);
+  } else {
+    liveOverlay.set(liveFieldMessage, text);
+  }
+  xSemaphoreGive(liveOverlayMutex);
+}
+
+// 把预览叠加层合成到屏幕上：刚画过的区域(x, y, w, h)盖住的字段和变化/到期的字段才重画
+// 解码任务在每帧之后调用；流水线暂停时由loop调用（传入空区域）
+void compositeLiveOverlay(int x, int y, int w, int h) {
+  xSemaphoreTake(liveOverlayMutex, portMAX_DELAY);
+  liveOverlay.invalidateRect(x, y, w, h);
+  liveOverlay.expire(millis());
+  if (liveOverlay.dirty()) {
+    M5Cardputer.Display.startWrite();
+    liveOverlay.paint(paintOverlayField);
+    M5Cardputer.Display.endWrite();
+  }
+  xSemaphoreGive(liveOverlayMutex);
+}
+
+// 剩余空间和电量到了采样周期才重新读取，记录每次采样的耗时
+void refreshStatusTelemetry() {
+  uint32_t now = millis();
+  if (statusTelemetry.freeSpaceDue(now)) {
+    uint32_t start = micros();
+    uint64_t freeBytes = getSDCardFreeSpace();
+    statusTelemetry.setFreeSpace(freeBytes, now, micros() - start);
+  }
+  if (statusTelemetry.batteryDue(now)) {
+    uint32_t start = micros();
+    int percent = getBatteryPercentage();
+    statusTelemetry.setBattery(percent, now, micros() - start);
+  }
+}
+
+// 遥测job（loop中周期运行）：只有timelapse界面显示剩余空间和电量，其他模式不采样
+bool telemetryJob(void* ctx, uint32_t deadlineUs) {
+  if (!isTimelapseMode) {
+    return false;
+  }
+  uint32_t now = millis();
+  if (!statusTelemetry.freeSpaceDue(now) && !statusTelemetry.batteryDue(now)) {
+    return false;
+  }
+  refreshStatusTelemetry();
+  return true;
+}
+
 // 更新timelapse模式显示界面
 void updateTimelapseDisplay() {
   if (isScreenOff) {
     return;
   }
+  uint32_t overlayStart = micros();
   
-  M5Cardputer.Display.setTextColor(TFT_WHITE, TFT_BLACK);
-  M5Cardputer.Display.setTextSize(1);
-  
-  // 左上角：已拍摄张数和倒计时
-  M5Cardputer.Display.setCursor(5, 5);
-  M5Cardputer.Display.printf("Photos: %d", timelapsePhotoCount);
+  // 左上角：已拍摄张数、倒计时和拍摄间隔（=/-调整）
+  timelapseOverlay.setf(tlFieldPhotos, "Photos: %d", timelapsePhotoCount);
   
-  unsigned long timeSinceLastShot = millis() - timelapseLastShotTime;
-  int countdown;
-  
-  if (timeSinceLastShot >= timelapseInterval) {
-    countdown = 0;
+  uint32_t untilNext = timelapseSchedule.msUntilDue(millis());
+  if (untilNext == 0) {
+    timelapseOverlay.set(tlFieldNext, "Capturing");
   } else {
-    countdown = (timelapseInterval - timeSinceLastShot) / 1000;
+    timelapseOverlay.setf(tlFieldNext, "Next: %lus", (unsigned long)((untilNext + 999) / 1000));
   }
   
-  M5Cardputer.Display.setCursor(5, 20);
-  if (timeSinceLastShot >= timelapseInterval) {
-    M5Cardputer.Display.fillRect(5, 20, 100, 10, TFT_BLACK);
-    M5Cardputer.Display.printf("Capturing");
+  if (timelapseIntervalMs < 1000) {
+    timelapseOverlay.setf(tlFieldInterval, "Every %lums", (unsigned long)timelapseIntervalMs);
   } else {
-    M5Cardputer.Display.fillRect(5, 20, 100, 10, TFT_BLACK);
-    M5Cardputer.Display.printf("Next: %ds", countdown);
+    timelapseOverlay.setf(tlFieldInterval, "Every %lus", (unsigned long)(timelapseIntervalMs / 1000));
+  }
+  
+  // 右上角：存储卡剩余容量和电量百分比（读缓存，由telemetry job按周期采样）
+  timelapseOverlay.setf(tlFieldSpace, "%.1fMB", statusTelemetry.freeSpace() / (1024.0f * 1024.0f));
+  timelapseOverlay.setf(tlFieldBattery, "%d%%", statusTelemetry.battery());
+  
+  // 只把变化的字段推送到LCD
+  if (timelapseOverlay.dirty()) {
+    M5Cardputer.Display.startWrite();
+    timelapseOverlay.paint(paintOverlayField);
+    M5Cardputer.Display.endWrite();
+  }
+  
+  // 刷新耗时（含到期的采样）；不缓存时每次刷新的耗时约为 绘制 + 两项采样
+  statusOverlayTime.add(micros() - overlayStart);
+  if (statusOverlayTime.count >= STATUS_OVERLAY_LOG_FRAMES) {
+    serialPrintf("[Status] overlay avg %lu us max %lu us, repainted %lu/%lu fields (%lu px) |"
+                 " free-space sample avg %lu us max %lu us (%lu) |"
+                 " battery sample avg %lu us max %lu us (%lu)\n",
+                 (unsigned long)statusOverlayTime.averageUs(), (unsigned long)statusOverlayTime.maxUs,
+                 (unsigned long)timelapseOverlay.paintedFields,
+                 (unsigned long)(statusOverlayTime.count * timelapseOverlay.count()),
+                 (unsigned long)timelapseOverlay.paintedPixels,
+                 (unsigned long)statusTelemetry.freeSpaceCost.averageUs(),
+                 (unsigned long)statusTelemetry.freeSpaceCost.maxUs,
+                 (unsigned long)statusTelemetry.freeSpaceCost.count,
+                 (unsigned long)statusTelemetry.batteryCost.averageUs(),
+                 (unsigned long)statusTelemetry.batteryCost.maxUs,
+                 (unsigned long)statusTelemetry.batteryCost.count);
+    statusOverlayTime.reset();
+    timelapseOverlay.paintedFields = 0;
+    timelapseOverlay.paintedPixels = 0;
   }
-  
-  // 右上角：存储卡剩余容量和电量百分比
-  uint64_t freeSpace = getSDCardFreeSpace();
-  float freeSpaceMB = freeSpace / (1024.0f * 1024.0f);
-  int battery = getBatteryPercentage();
-  
-  String spaceStr = String(freeSpaceMB, 1) + "MB";
-  int spaceStrWidth = M5Cardputer.Display.textWidth(spaceStr);
-  M5Cardputer.Display.setCursor(SCREEN_WIDTH - spaceStrWidth - 5, 5);
-  M5Cardputer.Display.printf("%s", spaceStr.c_str());
-  
-  String batteryStr = String(battery) + "%";
-  int batteryStrWidth = M5Cardputer.Display.textWidth(batteryStr);
-  M5Cardputer.Display.setCursor(SCREEN_WIDTH - batteryStrWidth - 5, 20);
-  M5Cardputer.Display.printf("%s", batteryStr.c_str());
+}
+
+// 低功耗timelapse：切换WiFi省电模式（醒着时MAX_MODEM在多个DTIM周期内关闭射频，连接保持；light sleep期间不保持）
+void setTimelapseWifiPowerSave(bool lowPower) {
+  if (lowPower) {
+    esp_wifi_get_ps(&savedWifiPowerSave);
+    esp_wifi_set_ps(WIFI_PS_MAX_MODEM);
+  } else {
+    esp_wifi_set_ps(savedWifiPowerSave);
+  }
+}
+
+// 确认WiFi连着，没有连着（light sleep醒来后）时重连，重连时间计入这一张醒着的时间
+bool ensureTimelapseWifi() {
+  if (WiFi.status() == WL_CONNECTED) {
+    return true;
+  }
+  unsigned long waitStart = millis();
+  WiFi.reconnect();
+  while (WiFi.status() != WL_CONNECTED && millis() - waitStart < TIMELAPSE_WIFI_WAIT_MS) {
+    delay(50);
+  }
+  bool connected = WiFi.status() == WL_CONNECTED;
+  timelapseAwake.reconnected(millis() - waitStart);
+  if (!connected) {
+    serialPrintf("[Timelapse] WiFi not reconnected after %d ms\n", TIMELAPSE_WIFI_WAIT_MS);
+  }
+  return connected;
+}
+
+// 低功耗timelapse：距离下一张足够久时light sleep到计划时刻前，返回睡了多少毫秒（0表示没睡）
+// 睡眠期间所有任务暂停、millis()由RTC补偿，计划时刻不受影响；SD写入任务还有数据时不睡
+// light sleep会关掉射频，WiFi连接保持不住：睡前主动断开，醒来后立即重连，
+// 提前唤醒的时间包括预计的重连时间，重连完拍摄仍落在计划时刻上
+uint32_t timelapseLightSleep(uint32_t untilDueMs) {
+  uint32_t wakeEarlyMs = TIMELAPSE_WAKE_EARLY_MS + timelapseAwake.expectedReconnectMs(TIMELAPSE_WIFI_RECONNECT_MS);
+  if (untilDueMs < wakeEarlyMs + TIMELAPSE_SLEEP_MIN_MS || !sdWriteQueue.idle()) {
+    return 0;
+  }
+  Serial.flush();
+  WiFi.disconnect();
+  esp_sleep_enable_timer_wakeup((uint64_t)(untilDueMs - wakeEarlyMs) * 1000);
+  gpio_wakeup_enable(TIMELAPSE_WAKE_GPIO, GPIO_INTR_LOW_LEVEL);
+  esp_sleep_enable_gpio_wakeup();
+  
+  int64_t sleepStart = esp_timer_get_time();
+  esp_light_sleep_start();
+  uint32_t sleptMs = (uint32_t)((esp_timer_get_time() - sleepStart) / 1000);
+  
+  gpio_wakeup_disable(TIMELAPSE_WAKE_GPIO);
+  esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+  timelapseAwake.slept(sleptMs);
+  ensureTimelapseWifi();
+  return sleptMs;
 }
 
 // 启动timelapse模式
@@ -920,10 +2008,9 @@ void startTimelapseMode() {
   
   serialPrintf("Timelapse directory created successfully\n");
   
-  // 停止MJPEG流以防止资源冲突
+  // 停止MJPEG流以防止资源冲突（stop()同步关闭连接，无需额外等待）
   streamHttp.end();
   streamClient.stop();
-  delay(500);
   
   // 设置timelapse分辨率和质量
   serialPrintf("Setting timelapse resolution...\n");
@@ -937,11 +2024,20 @@ void startTimelapseMode() {
     serialPrintf("Failed to set high quality\n");
     return;
   }
+  captureFreshness.expectFramesize(CAMERA_RESOLUTION_TIMELAPSE);
+  
+  // 进入timelapse时重新采样剩余空间（AVI预分配和状态栏都用这次的结果）
+  statusTelemetry.invalidateFreeSpace();
+  
+  // AVI模式：会话目录下预分配第一个文件（失败时退回每张一个文件）
+  if (isTimelapseAviMode && !openTimelapseAvi(0)) {
+    serialPrintf("Failed to create timelapse AVI, saving JPEG files\n");
+    isTimelapseAviMode = false;
+  }
   
   // 初始化timelapse状态
   isTimelapseMode = true;
   timelapsePhotoCount = 0;
-  timelapseLastShotTime = millis();
   timelapseStartTime = millis();
   lastUserActionTime = millis();
   isScreenOff = false;
@@ -958,9 +2054,22 @@ void startTimelapseMode() {
   M5Cardputer.Display.setTextSize(1);
   M5Cardputer.Display.setCursor(10, 90);
   M5Cardputer.Display.println("Press BtnA to exit");
+  M5Cardputer.Display.setCursor(10, 105);
+  M5Cardputer.Display.println(isTimelapseAviMode ? "Recording to AVI" : "Saving JPEG files");
+  if (isTimelapseLowPower) {
+    M5Cardputer.Display.setCursor(10, 120);
+    M5Cardputer.Display.println("Low power: BtnA wakes screen");
+    setTimelapseWifiPowerSave(true);
+  }
   delay(2000);
   
-  serialPrintf("Timelapse mode started\n");
+  // 从提示画面结束时开始计时，第一张在一个间隔之后
+  timelapseSchedule.start(millis(), timelapseIntervalMs, TIMELAPSE_OVERRUN, TIMELAPSE_MAX_CATCH_UP);
+  timelapseAwake.reset(millis());
+  refreshStatusTelemetry();  // 第一次刷新显示前先采样，之后由telemetry job按周期采样
+  timelapseOverlay.invalidateAll();
+  serialPrintf("Timelapse mode started, interval %lu ms, low power %d\n", (unsigned long)timelapseIntervalMs,
+               isTimelapseLowPower);
 }
 
 // 停止timelapse模式
@@ -970,12 +2079,22 @@ void stopTimelapseMode() {
   isTimelapseMode = false;
   isScreenOff = false;
   
-  // 恢复低分辨率和低质量（串流模式）
-  serialPrintf("Restoring low resolution...\n");
-  setCameraResolution(CAMERA_RESOLUTION_LOW);
+  if (isTimelapseLowPower) {
+    setTimelapseWifiPowerSave(false);
+  }
+  
+  // 结束AVI文件（写入最终索引并截断）
+  if (isTimelapseAviMode) {
+    closeTimelapseAvi();
+  }
+  
+  // 恢复串流分辨率和低质量（串流模式）
+  serialPrintf("Restoring stream resolution...\n");
+  setCameraResolution(streamResolution());
+  resolutionSwitch.request(streamResolution(), millis());
   
-  serialPrintf("Restoring low quality...\n");
-  setCameraQuality(0);
+  serialPrintf("Restoring stream quality...\n");
+  setCameraQuality(streamQuality());
   
   // 标记需要重启视频流
   appState.isRestartStream = true;
@@ -998,204 +2117,85 @@ void stopTimelapseMode() {
   serialPrintf("Timelapse mode stopped. Total photos: %d\n", timelapsePhotoCount);
 }
 
-// 拍摄timelapse照片
-bool captureTimelapsePhoto() {
-  serialPrintf("Capturing timelapse photo %d...\n", timelapsePhotoCount + 1);
-  
-  // 获取最新图像数据
-  HTTPClient http;
-  
-  // 第一次请求：触发拍摄（忽略返回的旧图像数据）
-  const char* captureUrl = "http://192.168.4.1/api/v1/capture";
-  http.begin(captureUrl);
-  http.addHeader("User-Agent", "M5Cardputer");
-  http.setTimeout(15000);
-  
-  serialPrintf("[Timelapse] First request (trigger): GET %s\n", captureUrl);
-  int code = http.GET();
-  
-  // 关闭第一次请求
-  http.end();
-  
-  // 等待相机处理新图像
-  delay(500);
-  
-  // 第二次请求：获取新的图像数据
-  http.begin(captureUrl);
-  http.addHeader("User-Agent", "M5Cardputer");
-  http.setTimeout(15000);
-  
-  serialPrintf("[Timelapse] Second request (fetch): GET %s\n", captureUrl);
-  code = http.GET();
-  
-  if (code != 200) {
-    serialPrintf("[Timelapse] HTTP %d\n", code);
-    http.end();
-    // 即使拍摄失败，也要重置倒计时，避免卡在0秒
-    timelapseLastShotTime = millis();
-    return false;
-  }
-  
-  String ct = http.header("Content-Type");
-  serialPrintf("[Timelapse] CT: %s\n", ct.c_str());
-  
-  // 验证内容类型是否为JPEG，但允许空内容类型（相机API可能不设置它）
-  if (!ct.isEmpty() && !ct.startsWith("image/jpeg")) {
-    serialPrintf("[Timelapse] Unexpected content-type: %s\n", ct.c_str());
-    http.end();
-    timelapseLastShotTime = millis();
-    return false;
-  }
-  
-  // 读取JPEG数据
-  WiFiClient* s = http.getStreamPtr();
-  s->setNoDelay(true);
-  s->setTimeout(10000);
-  int len = http.getSize();
-  
-  serialPrintf("[Timelapse] Content length: %d\n", len);
-  
-  // 查找当前会话中最大的照片编号
-  int maxPhotoNum = -1;
-  File sessionDir = SD.open(currentTimelapseDir);
-  if (sessionDir) {
-    File file = sessionDir.openNextFile();
-    while (file) {
-      if (file.isDirectory()) {
-        file = sessionDir.openNextFile();
-        continue;
-      }
-      
-      String fileName = file.name();
-      // 文件名格式：IMG_XXXX_YYYY.jpg，提取YYYY作为编号
-      int lastSlash = fileName.lastIndexOf('/');
-      if (lastSlash >= 0) {
-        fileName = fileName.substring(lastSlash + 1);
-      }
-      
-      if (fileName.startsWith("IMG_") && fileName.endsWith(".jpg")) {
-        // 找到第二个下划线的位置
-        int firstUnderscore = fileName.indexOf('_');
-        int secondUnderscore = fileName.indexOf('_', firstUnderscore + 1);
-        
-        if (secondUnderscore > 0) {
-          String numStr = fileName.substring(secondUnderscore + 1, fileName.length() - 4);
-          int photoNum = numStr.toInt();
-          if (photoNum > maxPhotoNum) {
-            maxPhotoNum = photoNum;
-          }
-        }
-      }
-      
-      file = sessionDir.openNextFile();
-    }
-    sessionDir.close();
-  }
-  
-  // 新照片编号为最大编号+1
-  int photoNum = maxPhotoNum + 1;
-  
-  // 生成文件名：IMG_XXXX_YYYY.jpg
-  char filename[64];
-  snprintf(filename, sizeof(filename), "%s/IMG_%d_%04d.jpg",
-           currentTimelapseDir.c_str(), currentTimelapseSession, photoNum);
-  
-  // 保存照片到SD卡
-  File photoFile = SD.open(filename, FILE_WRITE);
-  if (!photoFile) {
-    serialPrintf("[Timelapse] Failed to create photo file\n");
-    http.end();
-    // 即使文件创建失败，也要重置倒计时，避免卡在0秒
-    timelapseLastShotTime = millis();
-    return false;
-  }
-  
-  uint8_t* buffer = new uint8_t[1024];
-  size_t totalWritten = 0;
-  
-  while (http.connected() && (len < 0 || totalWritten < (size_t)len)) {
-    size_t available = s->available();
-    if (available > 0) {
-      int readSize = s->readBytes(buffer, min(available, (size_t)1024));
-      photoFile.write(buffer, readSize);
-      totalWritten += readSize;
-    }
-  }
-  
-  delete[] buffer;
-  photoFile.close();
-  http.end();
-  
-  serialPrintf("[Timelapse] Written: %d bytes\n", totalWritten);
-  
-  if (len > 0 && totalWritten != (size_t)len) {
-    serialPrintf("[Timelapse] Incomplete photo: %d/%d bytes\n", totalWritten, len);
-    // 即使数据不完整，也要重置倒计时，避免卡在0秒
-    timelapseLastShotTime = millis();
-    return false;
-  }
-  
-  timelapsePhotoCount++;
-  timelapseLastShotTime = millis();
-  
-  serialPrintf("[Timelapse] Photo saved: %s\n", filename);
-  serialPrintf("[Timelapse] Total photos: %d\n", timelapsePhotoCount);
-  serialPrintf("[Timelapse] Next photo in 5 seconds\n");
-  
-  return true;
-}
-
-// 通用的设置相机参数函数
-bool setCameraParameter(const String& paramName, int value) {
-  // 在屏幕上显示参数设置信息
-  M5Cardputer.Display.setCursor(10, 205);
-  M5Cardputer.Display.printf("Setting %s to %d...\n", paramName.c_str(), value);
-  Serial.printf("Setting %s to %d...\n", paramName.c_str(), value);
-  
-  HTTPClient http;
-  String url = String("http://192.168.4.1/api/v1/control?var=") + paramName + "&val=" + value;
-  
-  http.begin(url);
-  http.addHeader("User-Agent", "M5Cardputer");
-  http.setTimeout(10000);
+// 拍摄timelapse照片
+bool captureTimelapsePhoto() {
+  serialPrintf("Capturing timelapse photo %d...\n", timelapsePhotoCount + 1);
   
-  int code = http.GET();
-  logHttpResponseHeaders("param", code, http);
+  unsigned long shotStart = millis();
   
-  // 调试：打印HTTP响应内容长度和内容
-  int contentLength = http.getSize();
-  Serial.printf("HTTP Content length for %s: %d bytes\n", paramName.c_str(), contentLength);
+  // 获取最新图像数据：只发一次请求，分辨率不符（旧帧）时才轮询重试
+  // 帧头借用帧池的生产者槽（timelapse期间流已停止）
+  HTTPClient http;
+  uint8_t* head = framePool.writeSlot().data;
+  size_t headLen = 0;
+  int len = 0;
+  bool gotFresh = false;
+  
+  for (int attempt = 1; attempt <= CAPTURE_MAX_ATTEMPTS && !gotFresh; attempt++) {
+    if (attempt > 1) {
+      delay(CAPTURE_RETRY_BASE_MS << (attempt - 2));
+    }
+    
+    CaptureVerdict verdict;
+    if (!openCaptureRequest(http, "Timelapse", head, CAPTURE_HEAD_SIZE, headLen, len, verdict)) {
+      return false;
+    }
+    gotFresh = (verdict != CAPTURE_STALE);
+  }
   
-  String response = http.getString();
-  Serial.printf("HTTP Response length for %s: %d bytes\n", paramName.c_str(), response.length());
-  Serial.printf("HTTP Response for %s: %s\n", paramName.c_str(), response.c_str());
+  if (!gotFresh) {
+    serialPrintf("[Timelapse] No fresh frame after %d requests\n", CAPTURE_MAX_ATTEMPTS);
+    return false;
+  }
   
-  M5Cardputer.Display.setCursor(10, 220);
+  serialPrintf("[Timelapse] Remaining length: %d\n", len);
   
-  if (code != 200) {
-    serialPrintf("[%s] HTTP %d\n", paramName.c_str(), code);
-    M5Cardputer.Display.println("Param setup failed!");
+  char filename[64];
+  FrameFingerprint fp;
+  if (isTimelapseAviMode) {
+    // 直接写到AVI中下一帧的位置，校验通过后才写块头和索引，失败的帧由下一帧覆盖
+    // 上次换文件失败时再试一次
+    if (timelapseAviPath[0] == '\0') {
+      openTimelapseAvi(timelapseAviPart + 1);
+    }
+    snprintf(filename, sizeof(filename), "%s#%u", timelapseAviPath, (unsigned)timelapseAvi.frameCount());
+    size_t capacity = timelapseAviPath[0] ? timelapseAvi.frameCapacity() : 0;
+    bool written = capacity > 0 &&
+                   streamCaptureToFile(http, "Timelapse", timelapseAviPath, timelapseAvi.nextDataOffset(),
+                                       capacity, head, headLen, len, fp);
     http.end();
-    return false;
+    if (!written || !commitTimelapseAviFrame(fp.size)) {
+      return false;
+    }
+  } else {
+    // 每次进入timelapse都是新会话目录，照片编号就是已保存的张数，无需遍历目录
+    int photoNum = timelapsePhotoCount;
+    
+    // 生成文件名：IMG_XXXX_YYYY.jpg
+    snprintf(filename, sizeof(filename), "%s/IMG_%d_%04d.jpg",
+             currentTimelapseDir.c_str(), currentTimelapseSession, photoNum);
+    
+    // 保存照片到SD卡：边收边交给写入任务，校验通过后重命名
+    bool written = streamCaptureToFile(http, "Timelapse", CAPTURE_TEMP_PATH, -1, 0, head, headLen, len, fp);
+    http.end();
+    if (!written || !commitCaptureFile(filename)) {
+      SD.remove(CAPTURE_TEMP_PATH);
+      statusTelemetry.invalidateFreeSpace();
+      return false;
+    }
   }
   
-  http.end();
-  serialPrintf("%s set to %d successfully\n", paramName.c_str(), value);
-  M5Cardputer.Display.println("Param set!");
+  timelapsePhotoCount++;
+  
+  unsigned long shotMs = millis() - shotStart;
+  shutterLatency.add(shotMs * 1000);
+  serialPrintf("[Timelapse] Photo saved: %s (%lu ms)\n", filename, shotMs);
+  serialPrintf("[Timelapse] Total photos: %d\n", timelapsePhotoCount);
   
-  // 更新对应的全局变量
-  if (paramName == "brightness") {
-    currentBrightness = value;
-    Serial.printf("Updated currentBrightness to %d\n", currentBrightness);
-  } else if (paramName == "contrast") {
-    currentContrast = value;
-    Serial.printf("Updated currentContrast to %d\n", currentContrast);
-  } else if (paramName == "saturation") {
-    currentSaturation = value;
-    Serial.printf("Updated currentSaturation to %d\n", currentSaturation);
-  } else if (paramName == "sharpness") {
-    currentSharpness = value;
-    Serial.printf("Updated currentSharpness to %d\n", currentSharpness);
+  // 当前AVI放不下下一帧时在两次拍摄之间换文件，不占用下一次拍摄的时间
+  if (isTimelapseAviMode && timelapseAvi.frameCapacity() < TIMELAPSE_AVI_FRAME_MAX) {
+    closeTimelapseAvi();
+    openTimelapseAvi(timelapseAviPart + 1);
   }
   
   return true;
@@ -1222,6 +2222,9 @@ void showStatusFile() {
   // 先重新获取最新配置并保存到SD卡
   getCameraConfig();
   
+  // 输出控制命令延迟直方图
+  logControlLatency();
+  
   // 从SD卡加载相机状态并更新全局变量
   loadCameraStatus();
   
@@ -1241,6 +2244,7 @@ void showStatusFile() {
     streamHttp.end();
   }
   
+  waitSdWrites(SD_WRITER_WAIT_MS);
   File statusFile = SD.open("/images/status.txt", FILE_READ);
   if (!statusFile) {
     M5Cardputer.Display.fillScreen(BLACK);
@@ -1392,7 +2396,7 @@ bool initWiFi() {
   displayLine("Connecting WiFi...");
   Serial.println("Connecting WiFi...");
   
-  WiFi.begin("UnitCamS3-WiFi", "");
+  WiFi.begin(CAMERA_WIFI_SSID, CAMERA_WIFI_PASSWORD);
   int retry = 0;
   
   while (WiFi.status() != WL_CONNECTED && retry < 20) {
@@ -1442,65 +2446,569 @@ bool initWiFi() {
   return true;
 }
 
-// 主循环
-void loop() {
-  M5Cardputer.update();
+// 维护MJPEG流连接并读取数据直到截止时刻（接收任务中调用），返回读取的字节数
+// 连接断开、被要求重启或看门狗判定卡住时断开，按看门狗的退避时间重连，不在这里阻塞等待
+int serviceStream(uint32_t deadlineUs) {
+  // 检查WiFi连接状态
+  if (WiFi.status() == WL_CONNECTED) {
+    if (appState.isRestartStream) {
+      // 主动重启（拍照之后等）：控制命令返回时相机已完成切换，不再固定等待
+      appState.isRestartStream = false;
+      streamHttp.end();
+      streamClient.stop();
+      streamWatchdog.restart(millis(), STREAM_RESTART_SETTLE_MS);
+    } else if (streamWatchdog.isStreaming()) {
+      if (streamClient.connected()) {
+        // 处理流数据
+        int processed = processMjpegStream(streamClient, deadlineUs);
+        if (streamWatchdog.stalled(millis())) {
+          serialPrintf("[Stream] No frame for %d ms, reconnecting\n", STREAM_STALL_MS);
+          streamHttp.end();
+          streamClient.stop();
+          streamWatchdog.stallDetected(millis());
+        } else if (resolutionSwitch.timedOut(millis(), RESOLUTION_SWITCH_TIMEOUT_MS)) {
+          // 相机在串流中途没有切换到新分辨率：重连一次
+          serialPrintf("[Res] Still %dx%d after %d ms, reconnecting\n", resolutionSwitch.width(),
+                       resolutionSwitch.height(), RESOLUTION_SWITCH_TIMEOUT_MS);
+          streamHttp.end();
+          streamClient.stop();
+          streamWatchdog.restart(millis(), 0);
+        }
+        return processed;
+      }
+      serialPrintf("[Stream] Connection closed, reconnecting\n");
+      streamHttp.end();
+      streamWatchdog.dropped(millis());
+    }
+    
+    if (!streamWatchdog.retryDue(millis())) {
+      return 0;
+    }
+    
+    streamHttp.end();
+    streamClient.stop();
+    streamReader.reset();
+    
+    // logLine("Connecting to MJPEG stream...");
+    String url = CAMERA_BASE_URL "/api/v1/stream";
+    streamHttp.begin(streamClient, url);
+    streamHttp.setConnectTimeout(STREAM_CONNECT_TIMEOUT_MS);
+    streamHttp.addHeader("User-Agent", "M5Cardputer");
+    streamHttp.addHeader("Connection", "keep-alive");
+    const char* streamHeaders[] = {"Content-Type", "Transfer-Encoding"};
+    streamHttp.collectHeaders(streamHeaders, 2);
+    
+    int code = streamHttp.GET();
+    if (code != 200) {
+      // logLine(String("Failed to connect to MJPEG stream: HTTP ") + code);
+      streamHttp.end();
+      streamWatchdog.connectFailed(millis());
+      serialPrintf("[Stream] Connect failed (HTTP %d), retry in %lu ms\n", code,
+                   (unsigned long)streamWatchdog.msUntilRetry(millis()));
+      return 0;
+    }
+    
+    // 从响应头取boundary和分块方式，之后按part长度读取
+    String contentType = streamHttp.header("Content-Type");
+    bool chunked = streamHttp.header("Transfer-Encoding").equalsIgnoreCase("chunked");
+    streamReader.begin(contentType.c_str(), chunked);
+    streamWatchdog.connected(millis());
+    resolutionSwitch.noteReconnect();
+    serialPrintf("[Stream] %s, chunked %d%s\n", contentType.c_str(), chunked,
+                 streamReader.hasBoundary() ? "" : ", no boundary: marker scan");
+    
+    // logLine("MJPEG stream connected successfully");
+  } else {
+    // WiFi未连接，停止当前连接
+    if (streamClient.connected()) {
+      streamClient.stop();
+      streamHttp.end();
+    }
+    // 每5秒检查一次WiFi状态
+    static unsigned long lastWifiCheck = 0;
+    if (millis() - lastWifiCheck > 5000) {
+      lastWifiCheck = millis();
+      // logLine("WiFi disconnected, waiting for network recovery...");
+    }
+  }
   
-  // Timelapse模式处理
-  if (isTimelapseMode) {
-    // 检测任意按键（键盘和BtnA）
-    bool anyKeyPressed = M5Cardputer.Keyboard.isChange() || M5Cardputer.BtnA.wasPressed();
+  return 0;
+}
+
+// JPEGDEC解码回调：把解码出的像素块推送到LCD
+int previewDrawCallback(JPEGDRAW* pDraw) {
+  M5Cardputer.Display.pushImage(pDraw->x, pDraw->y, pDraw->iWidth, pDraw->iHeight, pDraw->pPixels);
+  return 1;
+}
+
+// 按指定比例缩小解码JPEG并绘制到place位置，失败返回false
+bool drawScaledJpeg(const uint8_t* data, size_t size, const PreviewPlacement& place) {
+  if (!previewDecoder.openRAM((uint8_t*)data, size, previewDrawCallback)) {
+    return false;
+  }
+  
+  int options = 0;
+  if (place.scale == 2) {
+    options = JPEG_SCALE_HALF;
+  } else if (place.scale == 4) {
+    options = JPEG_SCALE_QUARTER;
+  } else if (place.scale == 8) {
+    options = JPEG_SCALE_EIGHTH;
+  }
+  
+  previewDecoder.setPixelType(RGB565_LITTLE_ENDIAN);
+  M5Cardputer.Display.startWrite();
+  bool ok = previewDecoder.decode(place.x, place.y, options);
+  M5Cardputer.Display.endWrite();
+  previewDecoder.close();
+  return ok;
+}
+
+// 显示最新一帧（解码任务中调用），返回是否绘制了新帧
+bool drawLatestFrame() {
+  // 显示JPEG帧（取最新发布的帧，槽在下一次acquire前有效）
+  const FrameSlot* frame = framePool.acquire();
+  if (frame) {
+    // 图像尺寸由接收任务从每帧的SOF解析，分辨率在串流中途变化时自动跟随
+    int imgWidth = frame->width;
+    int imgHeight = frame->height;
+    if (imgWidth == 0 || imgHeight == 0) {
+      // 如果无法解析尺寸，默认显示左上角
+      M5Cardputer.Display.drawJpg(frame->data, frame->size, 0, 0);
+      compositeLiveOverlay(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+      frameLatency.add(micros() - frame->stampUs);
+      return true;
+    }
     
-    if (anyKeyPressed) {
-      M5Cardputer.Keyboard.updateKeysState();
-      
-      // 如果屏幕熄灭，先点亮屏幕
-      if (isScreenOff) {
-        isScreenOff = false;
-        M5Cardputer.Display.wakeup();
-        lastUserActionTime = millis();
-        updateTimelapseDisplay();
-      } else {
-        // 更新最后操作时间
-        lastUserActionTime = millis();
-        
-        // 处理BtnA退出timelapse模式（只在屏幕点亮状态下）
-        if (M5Cardputer.BtnA.wasPressed()) {
-          stopTimelapseMode();
-          return;
+    // 根据图像尺寸选择缩放解码比例和显示位置
+    PreviewPlacement place = computePreviewPlacement(imgWidth, imgHeight,
+                                                     SCREEN_WIDTH, SCREEN_HEIGHT, previewMode);
+    
+    // 摆放变化时（分辨率或模式切换）清屏，避免残留边框
+    bool cleared = false;
+    if (place.scale != lastPlacement.scale || place.x != lastPlacement.x || place.y != lastPlacement.y) {
+      M5Cardputer.Display.fillScreen(BLACK);
+      lastPlacement = place;
+      cleared = true;
+    }
+    
+    // 向LCD显示JPEG帧（超出屏幕的部分由pushImage裁切）
+    unsigned long decodeStart = micros();
+    if (!drawScaledJpeg(frame->data, frame->size, place)) {
+      M5Cardputer.Display.drawJpg(frame->data, frame->size, place.x, place.y);
+    }
+    decodeTime.add(micros() - decodeStart);
+    previewDecodeWindow.add(micros() - decodeStart);
+    
+    // 帧画完之后再叠加文字，只重画被这一帧盖住的字段，文字不会闪烁
+    if (cleared) {
+      compositeLiveOverlay(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT);
+    } else {
+      compositeLiveOverlay(place.x, place.y, place.width, place.height);
+    }
+    frameLatency.add(micros() - frame->stampUs);
+    return true;
+  }
+  
+  return false;
+}
+
+// 输出SD卡写入统计（每5秒一次，有写入时）
+void logSdWriterStats() {
+  static unsigned long lastStatsTime = 0;
+  static uint32_t lastSubmitted = 0;
+  if (millis() - lastStatsTime < 5000 || sdWriteQueue.submitted == lastSubmitted) {
+    return;
+  }
+  lastStatsTime = millis();
+  lastSubmitted = sdWriteQueue.submitted;
+  serialPrintf("[Writer] jobs %u ok %u failed %u, depth %d (max %d), stalls %u, "
+               "%u KB/s, write avg %u us max %u us, submit-to-done max %u us\n",
+               (unsigned)sdWriteQueue.submitted, (unsigned)sdWriteQueue.written,
+               (unsigned)sdWriteQueue.failed, sdWriteQueue.depth(), sdWriteQueue.maxDepth,
+               (unsigned)sdWriteQueue.stalls, (unsigned)(sdWriteQueue.bytesPerSecond() / 1024),
+               (unsigned)sdWriteQueue.writeTime.averageUs(), (unsigned)sdWriteQueue.writeTime.maxUs,
+               (unsigned)sdWriteQueue.jobLatency.maxUs);
+}
+
+// SD卡写入任务：按提交顺序写出写回队列中的任务，写完释放数据
+// 没有WRITE_JOB_CLOSE的任务写完后文件保持打开，同一文件的后续追加任务直接接着写；
+// flush策略：WRITE_JOB_SYNC立即flush，否则每SD_WRITER_FLUSH_BYTES或队列空闲时flush
+void sdWriterTask(void* param) {
+  File file;
+  char openPath[WRITE_BEHIND_PATH_MAX] = "";
+  size_t unsyncedBytes = 0;
+  uint32_t openSize = 0;   // 打开的文件当前长度，用于向状态栏报告文件长度的变化
+  
+  for (;;) {
+    WriteJob job;
+    if (!sdWriteQueue.next(job)) {
+      if (file && unsyncedBytes > 0) {
+        file.flush();
+        unsyncedBytes = 0;
+      }
+      logSdWriterStats();
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(50));
+      continue;
+    }
+    
+    uint32_t writeStart = micros();
+    
+    // 换文件或覆盖写时重新打开；定位写入用"r+"打开已有文件（不截断）
+    bool seek = job.flags & WRITE_JOB_SEEK;
+    bool reuse = file && (job.flags & (WRITE_JOB_APPEND | WRITE_JOB_SEEK)) && strcmp(openPath, job.path) == 0;
+    if (!reuse) {
+      if (file) {
+        file.close();
+      }
+      bool truncate = !(job.flags & (WRITE_JOB_APPEND | WRITE_JOB_SEEK));
+      if (truncate) {
+        // 覆盖写（status.txt、计数器的槽）先释放旧文件的空间，之后按新长度计入增长
+        File old = SD.open(job.path, FILE_READ);
+        if (old) {
+          statusTelemetry.noteGrowth(-(int32_t)old.size());
+          old.close();
         }
       }
+      file = SD.open(job.path, seek ? "r+" : truncate ? FILE_WRITE : FILE_APPEND);
+      strncpy(openPath, job.path, sizeof(openPath));
+      unsyncedBytes = 0;
+      openSize = file && !truncate ? file.size() : 0;
     }
     
-    // 检查是否需要息屏（1分钟无操作）
-    if (!isScreenOff && millis() - lastUserActionTime >= screenOffTimeout) {
-      isScreenOff = true;
-      M5Cardputer.Display.sleep();
+    bool ok = false;
+    if (file) {
+      // 连续的定位写入（同一帧的后续分块）已在目标位置，不再seek
+      ok = !seek || file.position() == job.offset || file.seek(job.offset);
+      ok = ok && (job.size == 0 || file.write(job.data, job.size) == job.size);
+      unsyncedBytes += job.size;
+      uint32_t end = file.position();
+      if (end > openSize) {
+        statusTelemetry.noteGrowth((int32_t)(end - openSize));
+        openSize = end;
+      }
+      if (ok && ((job.flags & WRITE_JOB_SYNC) || unsyncedBytes >= SD_WRITER_FLUSH_BYTES)) {
+        file.flush();
+        unsyncedBytes = 0;
+      }
+      if (!ok || (job.flags & WRITE_JOB_CLOSE)) {
+        file.close();
+        unsyncedBytes = 0;
+      }
+    }
+    if (!ok) {
+      serialPrintf("[Writer] Failed to write %s\n", job.path);
+    }
+    sdWriteQueue.complete(job, ok, micros() - writeStart, micros());
+  }
+}
+
+// 接收job：维护串流连接并读取数据直到截止时刻
+bool streamIngestJob(void* ctx, uint32_t deadlineUs) {
+  return serviceStream(deadlineUs) > 0;
+}
+
+// 流统计job（周期运行，不算作有数据要处理）
+bool streamStatsJob(void* ctx, uint32_t deadlineUs) {
+  logStreamStats();
+  return false;
+}
+
+// 码率自适应job（周期运行）：把一个窗口的帧数、字节数、解码耗时和RSSI交给控制器，
+// 换档时把framesize/quality交给控制任务异步发出，串流保持连接（显示端按每帧SOF跟随新尺寸）
+bool previewAdaptJob(void* ctx, uint32_t deadlineUs) {
+  static uint32_t lastMs = 0;
+  static uint32_t lastFrames = 0;
+  static uint64_t lastBytes = 0;
+
+  uint32_t now = millis();
+  PreviewSample sample;
+  sample.windowMs = lastMs ? now - lastMs : 0;
+  sample.frames = streamReader.framesCompleted - lastFrames;
+  sample.bytes = (uint32_t)(streamReader.bytesScanned - lastBytes);
+  sample.decodeAvgUs = previewDecodeWindow.take().averageUs();
+  sample.rssi = WiFi.RSSI();
+  lastMs = now;
+  lastFrames = streamReader.framesCompleted;
+  lastBytes = streamReader.bytesScanned;
+
+  // 快速快门和timelapse的分辨率由各自的模式决定；没有串流时窗口没有意义
+  if (isFastShutterMode || isTimelapseMode || !streamWatchdog.isStreaming()) {
+    previewBitrate.discardWindow();
+    return false;
+  }
+
+  int framesize = previewBitrate.currentLevel().framesize;
+  if (!previewBitrate.update(sample, now)) {
+    return false;
+  }
+  const PreviewLevel& level = previewBitrate.currentLevel();
+  serialPrintf("[Adapt] %u.%u fps, %u KB/s, RSSI %d -> level %d (framesize %d, quality %d)\n",
+               (unsigned)(previewBitrate.lastFpsX10 / 10), (unsigned)(previewBitrate.lastFpsX10 % 10),
+               (unsigned)(sample.bytes / sample.windowMs), sample.rssi, previewBitrate.level(),
+               level.framesize, level.quality);
+  queueCameraControl("framesize", level.framesize);
+  queueCameraControl("quality", level.quality);
+  if (level.framesize != framesize) {
+    resolutionSwitch.request(level.framesize, now);
+  }
+  return true;
+}
+
+// 网络接收任务：运行接收调度器（串流读取、流统计、码率自适应），流水线暂停时停驻
+void streamIngestTask(void* param) {
+  bool paused = false;
+  for (;;) {
+    if (!pipelineGate.enter(PIPELINE_WORKER_INGEST)) {
+      paused = true;
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
     }
     
-    // 更新timelapse显示界面（只在屏幕点亮时）
-    if (!isScreenOff) {
-      updateTimelapseDisplay();
+    // 暂停期间没有读取，不算串流卡住
+    if (paused) {
+      paused = false;
+      streamWatchdog.resumed(millis());
+      previewBitrate.discardWindow();
     }
     
-    // 检查是否需要拍摄照片（5秒间隔）
-    unsigned long timeSinceLastShot = millis() - timelapseLastShotTime;
-    if (timeSinceLastShot >= timelapseInterval) {
-      serialPrintf("[Timelapse] Time since last shot: %lu ms, triggering capture\n", timeSinceLastShot);
-      captureTimelapsePhoto();
+    // 没有数据时让出CPU，避免饿死同核的WiFi任务
+    if (!ingestScheduler.runOnce()) {
+      vTaskDelay(1);
+    }
+  }
+}
+
+// 解码job：解码显示最新一帧，没有新帧时返回false
+bool frameDecodeJob(void* ctx, uint32_t deadlineUs) {
+  return drawLatestFrame();
+}
+
+// 解码显示任务：等待新帧通知后解码并绘制到LCD
+void frameDecodeTask(void* param) {
+  for (;;) {
+    if (!pipelineGate.enter(PIPELINE_WORKER_DECODE)) {
+      vTaskDelay(pdMS_TO_TICKS(5));
+      continue;
     }
     
-    delay(100);
+    if (!decodeScheduler.runOnce()) {
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(20));
+    }
+  }
+}
+
+// 暂停流水线，等待两个任务停驻后UI即可独占网络流和屏幕
+void pausePipeline() {
+  pipelineGate.requestPause();
+  while (!pipelineGate.isPaused(PIPELINE_WORKERS_ALL)) {
+    delay(1);
+  }
+}
+
+// 恢复流水线（timelapse模式下保持暂停）
+void resumePipeline() {
+  if (!isTimelapseMode) {
+    pipelineGate.resume();
+  }
+}
+
+// 输出一个调度器的统计（CPU占比、每轮平均和最坏耗时、各job明细），之后由所在任务清零
+void logSchedulerStats(const char* task, CoopScheduler& sched) {
+  uint32_t busy = sched.busyPermille();
+  serialPrintf("[Sched] %s: busy %u.%u%%, iteration avg %u us, worst %u us, idle %u/%u\n",
+               task, (unsigned)(busy / 10), (unsigned)(busy % 10),
+               (unsigned)sched.iterations.averageUs(), (unsigned)sched.iterations.maxUs,
+               (unsigned)sched.idleIterations, (unsigned)sched.iterations.count);
+  for (int i = 0; i < sched.count(); i++) {
+    const CoopJob& job = sched.job(i);
+    uint32_t share = sched.sharePermille(i);
+    serialPrintf("[Sched]   %s: %u.%u%%, runs %u, max %u us, over budget %u, deferred %u\n",
+                 job.name, (unsigned)(share / 10), (unsigned)(share % 10), (unsigned)job.runs,
+                 (unsigned)job.maxUs, (unsigned)job.overruns, (unsigned)job.deferred);
+  }
+  sched.requestReset();
+}
+
+// 调度统计job（loop中周期运行，读取三个任务的统计）
+bool schedulerReportJob(void* ctx, uint32_t deadlineUs) {
+  logSchedulerStats("ingest", ingestScheduler);
+  logSchedulerStats("decode", decodeScheduler);
+  logSchedulerStats("ui", uiScheduler);
+  return false;
+}
+
+// inputJob函数的前向声明
+bool inputJob(void* ctx, uint32_t deadlineUs);
+
+// timelapseJob函数的前向声明
+bool timelapseJob(void* ctx, uint32_t deadlineUs);
+
+// 登记各任务的job（任务启动之前）
+void initSchedulers() {
+  ingestScheduler.addJob("ingest", 0, STREAM_INGEST_BUDGET_US, 0, streamIngestJob);
+  ingestScheduler.addJob("stream-stats", 1, 1000, STREAM_STATS_PERIOD_US, streamStatsJob);
+#if PREVIEW_ADAPT
+  ingestScheduler.addJob("preview-adapt", 1, 500, PREVIEW_ADAPT_PERIOD_US, previewAdaptJob);
+#endif
+  ingestScheduler.setIterationBudget(INGEST_ITERATION_BUDGET_US);
+  decodeScheduler.addJob("decode", 0, DECODE_BUDGET_US, 0, frameDecodeJob);
+  // 遥测排在timelapse之前，刷新显示时读到的是本轮采样的值
+  uiScheduler.addJob("input", 0, UI_INPUT_BUDGET_US, 0, inputJob);
+  uiScheduler.addJob("telemetry", 0, TELEMETRY_JOB_BUDGET_US, TELEMETRY_JOB_PERIOD_US, telemetryJob);
+  uiScheduler.addJob("timelapse", 0, TIMELAPSE_JOB_BUDGET_US, 0, timelapseJob);
+  uiScheduler.addJob("sched-report", 1, 2000, SCHED_REPORT_PERIOD_US, schedulerReportJob);
+  uiScheduler.setIterationBudget(UI_ITERATION_BUDGET_US);
+}
+
+// 启动接收、解码和控制任务
+void startPipeline() {
+  initSchedulers();
+  xTaskCreatePinnedToCore(cameraControlTask, "control", PIPELINE_TASK_STACK, nullptr, 1,
+                          &controlTaskHandle, PIPELINE_INGEST_CORE);
+  xTaskCreatePinnedToCore(streamIngestTask, "ingest", PIPELINE_TASK_STACK, nullptr, 2,
+                          &ingestTaskHandle, PIPELINE_INGEST_CORE);
+  xTaskCreatePinnedToCore(frameDecodeTask, "decode", PIPELINE_TASK_STACK, nullptr, 1,
+                          &decodeTaskHandle, PIPELINE_DECODE_CORE);
+}
+
+// 主循环（UI和按键处理）
+void loop() {
+  M5Cardputer.update();
+  
+  // 按键、timelapse、遥测和调度统计作为job运行
+  bool worked = uiScheduler.runOnce();
+  
+  if (isTimelapseMode) {
+    // 等到下一个计划时刻或最多TIMELAPSE_LOOP_MS，间隔短于loop周期时也能准时
+    // 低功耗模式息屏后改为light sleep到计划时刻前（BtnA可唤醒）
+    uint32_t wait = timelapseSchedule.msUntilDue(millis());
+    if (wait > 0 && !(isTimelapseLowPower && isScreenOff && timelapseLightSleep(wait))) {
+      delay(wait < TIMELAPSE_LOOP_MS ? wait : TIMELAPSE_LOOP_MS);
+    }
     return;
   }
   
+  // 没有处理按键时让出CPU给同核的解码任务
+  if (!worked) {
+    delay(1);
+  }
+}
+
+// Timelapse模式job（流水线保持暂停，由loop独占屏幕）：按键、息屏、刷新显示，到达计划时刻就拍摄
+bool timelapseJob(void* ctx, uint32_t deadlineUs) {
+  if (!isTimelapseMode) {
+    return false;
+  }
+  pausePipeline();
+  
+  // 检测任意按键（键盘和BtnA）
+  bool anyKeyPressed = M5Cardputer.Keyboard.isChange() || M5Cardputer.BtnA.wasPressed();
+  
+  if (anyKeyPressed) {
+    M5Cardputer.Keyboard.updateKeysState();
+    
+    // 如果屏幕熄灭，先点亮屏幕
+    if (isScreenOff) {
+      isScreenOff = false;
+      M5Cardputer.Display.wakeup();
+      lastUserActionTime = millis();
+      timelapseOverlay.invalidateAll();
+      updateTimelapseDisplay();
+    } else {
+      // 更新最后操作时间
+      lastUserActionTime = millis();
+      
+      // 处理BtnA退出timelapse模式（只在屏幕点亮状态下）
+      if (M5Cardputer.BtnA.wasPressed()) {
+        stopTimelapseMode();
+        return true;
+      }
+      
+      // =/-切换到更长/更短的预设间隔，时间轴从最近一个计划时刻重新起算
+      bool longer = M5Cardputer.Keyboard.isKeyPressed('=');
+      bool shorter = M5Cardputer.Keyboard.isKeyPressed('-');
+      if (longer || shorter) {
+        int preset = 0;
+        while (preset < TIMELAPSE_INTERVAL_PRESET_COUNT - 1 &&
+               timelapseIntervalPresets[preset] < timelapseIntervalMs) {
+          preset++;
+        }
+        if (longer && timelapseIntervalPresets[preset] <= timelapseIntervalMs &&
+            preset < TIMELAPSE_INTERVAL_PRESET_COUNT - 1) {
+          preset++;
+        } else if (shorter && preset > 0) {
+          preset--;
+        }
+        timelapseIntervalMs = timelapseIntervalPresets[preset];
+        timelapseSchedule.setInterval(millis(), timelapseIntervalMs);
+        serialPrintf("[Timelapse] Interval %lu ms\n", (unsigned long)timelapseIntervalMs);
+      }
+    }
+  }
+  
+  // 检查是否需要息屏（1分钟无操作，低功耗模式下10秒）
+  unsigned long screenOffAfter = isTimelapseLowPower ? TIMELAPSE_LOW_POWER_SCREEN_OFF_MS : screenOffTimeout;
+  if (!isScreenOff && millis() - lastUserActionTime >= screenOffAfter) {
+    isScreenOff = true;
+    M5Cardputer.Display.sleep();
+  }
+  
+  // 更新timelapse显示界面（只在屏幕点亮时）
+  if (!isScreenOff) {
+    updateTimelapseDisplay();
+  }
+  
+  // 到达计划时刻就拍摄；无论成败都推进到下一个计划时刻（超时按TIMELAPSE_OVERRUN跳过或补拍）
+  uint32_t now = millis();
+  if (timelapseSchedule.due(now)) {
+    uint32_t skippedBefore = timelapseSchedule.skipped;
+    serialPrintf("[Timelapse] Slot %u, %lu ms after schedule\n", (unsigned)timelapseSchedule.slotIndex(),
+                 (unsigned long)(now - timelapseSchedule.dueMs()));
+    timelapseSchedule.shotStarted(now);
+    if (!isTimelapseLowPower || ensureTimelapseWifi()) {
+      captureTimelapsePhoto();
+    }
+    timelapseSchedule.shotFinished(millis());
+    timelapseAwake.shotDone(millis());
+    if (timelapseSchedule.skipped != skippedBefore) {
+      serialPrintf("[Timelapse] Shot overran the interval, skipped %u slot(s)\n",
+                   (unsigned)(timelapseSchedule.skipped - skippedBefore));
+    }
+    serialPrintf("[Timelapse] Next photo in %lu ms (late avg %lu ms, max %lu ms)\n",
+                 (unsigned long)timelapseSchedule.msUntilDue(millis()),
+                 (unsigned long)(timelapseSchedule.lateness.averageUs() / 1000),
+                 (unsigned long)(timelapseSchedule.lateness.maxUs / 1000));
+    serialPrintf("[Timelapse] Awake %lu ms/shot incl. WiFi reconnect %lu ms (avg %lu ms, duty %lu.%lu%%), "
+                 "est. %lu h on %d mAh\n",
+                 (unsigned long)timelapseAwake.lastAwakeMs,
+                 (unsigned long)timelapseAwake.lastReconnectMs,
+                 (unsigned long)(timelapseAwake.awakePerShot.averageUs() / 1000),
+                 (unsigned long)(timelapseAwake.dutyPermille() / 10),
+                 (unsigned long)(timelapseAwake.dutyPermille() % 10),
+                 (unsigned long)timelapseAwake.batteryHours(POWER_BATTERY_MAH, POWER_AWAKE_MA, POWER_SLEEP_UA),
+                 POWER_BATTERY_MAH);
+  }
+  return true;
+}
+
+// 按键和拍照处理（loop中的input job），返回是否处理了按键或拍照
+bool inputJob(void* ctx, uint32_t deadlineUs) {
+  // timelapse模式下按键由timelapse job处理
+  if (isTimelapseMode) {
+    return false;
+  }
+  bool handled = false;
+  
   // 处理用户按键
   if (M5Cardputer.Keyboard.isChange()) {
     M5Cardputer.Keyboard.updateKeysState();
     serialPrintf("Keyboard state changed\n");
+    handled = true;
     
     // 处理重启键（只在按键变化时触发一次）
     if (M5Cardputer.Keyboard.isKeyPressed('r')) {
+      pausePipeline();
       // logLine("User requested device restart");
       M5Cardputer.Display.fillScreen(BLACK);
       M5Cardputer.Display.setCursor(10, 30);
@@ -1513,41 +3021,77 @@ void loop() {
     // 处理t键启动timelapse模式
     if (M5Cardputer.Keyboard.isKeyPressed('t')) {
       serialPrintf("t key pressed, starting timelapse mode...\n");
+      pausePipeline();
       startTimelapseMode();
-      return;
+      return true;
+    }
+    
+    // 处理v键切换预览模式（缩小完整视野 / 居中裁切）
+    if (M5Cardputer.Keyboard.isKeyPressed('v')) {
+      previewMode = (previewMode == PREVIEW_MODE_FIT) ? PREVIEW_MODE_CROP : PREVIEW_MODE_FIT;
+      serialPrintf("Preview mode: %d\n", previewMode);
+    }
+    
+    // 处理b键连拍（需要SD卡）
+    if (M5Cardputer.Keyboard.isKeyPressed('b') && isSDInitialized) {
+      pausePipeline();
+      if (!SD.exists("/images")) {
+        SD.mkdir("/images");
+      }
+      captureBurst(BURST_SHOT_COUNT);
+    }
+    
+    // 处理a键切换timelapse的保存方式（单个AVI或每张一个JPEG）
+    if (M5Cardputer.Keyboard.isKeyPressed('a')) {
+      isTimelapseAviMode = !isTimelapseAviMode;
+      serialPrintf("Timelapse AVI mode: %d\n", isTimelapseAviMode);
+    }
+    
+    // 处理p键切换低功耗timelapse（息屏后两张之间light sleep）
+    if (M5Cardputer.Keyboard.isKeyPressed('p')) {
+      isTimelapseLowPower = !isTimelapseLowPower;
+      serialPrintf("Timelapse low power mode: %d\n", isTimelapseLowPower);
     }
     
-    // 处理数字键0-6，设置相机特效（只在按键变化时触发一次）
+    // 处理f键切换快速快门模式（拍串流中的下一帧，不切换到高分辨率）
+    if (M5Cardputer.Keyboard.isKeyPressed('f')) {
+      pausePipeline();
+      setFastShutterMode(!isFastShutterMode);
+    }
+    
+    // 处理数字键0-6，设置相机特效（只在按键变化时触发一次，入队后台发送）
     for (int i = 0; i <= 6; i++) {
       char key = '0' + i;
       if (M5Cardputer.Keyboard.isKeyPressed(key)) {
-        setCameraSpecialEffect(i);
+        queueCameraControl("special_effect", i);
         break;
       }
     }
     
     // 处理显示状态信息（只在按键变化时触发一次）
     if (M5Cardputer.Keyboard.isKeyPressed('`')) {
+      pausePipeline();
+      flushCameraControls(5000);
       showStatusFile();
     }
   }
   
-  // 处理参数调节按键（持续检测，带防抖动）
+  // 处理参数调节按键（持续检测，带防抖动；只入队不等待网络）
   unsigned long currentTime = millis();
-  if (currentTime - lastKeyPressTime >= keyDebounceDelay) {
+  if (currentTime - lastKeyPressTime >= keyDebounceDelay && M5Cardputer.Keyboard.isPressed()) {
     bool keyPressed = false;
     
     // 处理亮度调节（; 上键增加，. 下键减少）
     if (M5Cardputer.Keyboard.isKeyPressed(';')) {
       if (currentBrightness < 2) {
         currentBrightness++;
-        setCameraParameter("brightness", currentBrightness);
+        queueCameraControl("brightness", currentBrightness);
         keyPressed = true;
       }
     } else if (M5Cardputer.Keyboard.isKeyPressed('.')) {
       if (currentBrightness > -2) {
         currentBrightness--;
-        setCameraParameter("brightness", currentBrightness);
+        queueCameraControl("brightness", currentBrightness);
         keyPressed = true;
       }
     }
@@ -1556,13 +3100,13 @@ void loop() {
     if (!keyPressed && M5Cardputer.Keyboard.isKeyPressed(',')) {
       if (currentContrast > -2) {
         currentContrast--;
-        setCameraParameter("contrast", currentContrast);
+        queueCameraControl("contrast", currentContrast);
         keyPressed = true;
       }
     } else if (!keyPressed && M5Cardputer.Keyboard.isKeyPressed('/')) {
       if (currentContrast < 2) {
         currentContrast++;
-        setCameraParameter("contrast", currentContrast);
+        queueCameraControl("contrast", currentContrast);
         keyPressed = true;
       }
     }
@@ -1571,13 +3115,13 @@ void loop() {
     if (!keyPressed && M5Cardputer.Keyboard.isKeyPressed('[')) {
       if (currentSaturation > -2) {
         currentSaturation--;
-        setCameraParameter("saturation", currentSaturation);
+        queueCameraControl("saturation", currentSaturation);
         keyPressed = true;
       }
     } else if (!keyPressed && M5Cardputer.Keyboard.isKeyPressed(']')) {
       if (currentSaturation < 2) {
         currentSaturation++;
-        setCameraParameter("saturation", currentSaturation);
+        queueCameraControl("saturation", currentSaturation);
         keyPressed = true;
       }
     }
@@ -1586,13 +3130,13 @@ void loop() {
     if (!keyPressed && M5Cardputer.Keyboard.isKeyPressed('_')) {
       if (currentSharpness > -2) {
         currentSharpness--;
-        setCameraParameter("sharpness", currentSharpness);
+        queueCameraControl("sharpness", currentSharpness);
         keyPressed = true;
       }
     } else if (!keyPressed && M5Cardputer.Keyboard.isKeyPressed('=')) {
       if (currentSharpness < 2) {
         currentSharpness++;
-        setCameraParameter("sharpness", currentSharpness);
+        queueCameraControl("sharpness", currentSharpness);
         keyPressed = true;
       }
     }
@@ -1606,150 +3150,58 @@ void loop() {
   // 处理BtnA按下（拍照）
   if (M5Cardputer.BtnA.wasPressed()) {
     appState.isCaptureReq = true;
+    appState.shutterTime = millis();
   }
   
   // 处理拍摄请求
   if (appState.isCaptureReq) {
     appState.isCaptureReq = false;
+    handled = true;
+    pausePipeline();
     // logLine("Processing capture request...");
-    if (captureSnapshot()) {
-      // logLine("Capture successful");
+    if (isSDInitialized) {
+      // 创建/images目录（如果不存在）
+      if (!SD.exists("/images")) {
+        SD.mkdir("/images");
+      }
       
-      // 保存照片到SD卡
-      if (isSDInitialized) {
-        // logLine("Saving photo to SD card...");
-        
-        // 创建带时间戳的文件名
-        time_t now = time(nullptr);
-        struct tm *timeinfo = localtime(&now);
-        char filename[40];
-        sprintf(filename, "/images/IMG_%04d%02d%02d_%02d%02d%02d.jpg", 
-                timeinfo->tm_year + 1900, timeinfo->tm_mon + 1, timeinfo->tm_mday,
-                timeinfo->tm_hour, timeinfo->tm_min, timeinfo->tm_sec);
+      // 按持久化序号生成文件名
+      char filename[WRITE_BEHIND_PATH_MAX];
+      makeSnapshotName(filename, sizeof(filename) - 4, "IMG");
+      strcat(filename, ".jpg");
+      
+      // 拍照数据直接写入SD卡（快速快门模式取串流中的下一帧）
+      bool saved = isFastShutterMode ? captureStreamFrame(filename) : captureSnapshot(filename);
+      if (saved) {
+        // logLine(String("Photo saved successfully: ") + filename);
         
-        // 打开文件进行写入
-        File file = SD.open(filename, FILE_WRITE);
-        if (!file) {
-          // logLine("Failed to open file");
-        } else {
-          // 写入JPEG数据
-          size_t bytesWritten = file.write(appState.jpegData, appState.jpegDataSize);
-          if (bytesWritten != appState.jpegDataSize) {
-            // logLine("Failed to write to file");
-          } else {
-            // logLine(String("Photo saved successfully: ") + filename);
-            M5Cardputer.Display.setCursor(10, 10);
-            M5Cardputer.Display.println(String("Photo saved: ") + filename);
-          }
-          file.close();
-        }
+        // 快门到保存完成的延迟
+        unsigned long shotMs = millis() - appState.shutterTime;
+        shutterLatency.add(shotMs * 1000);
+        serialPrintf("[Snap] Shutter-to-saved %lu ms (avg %lu ms, max %lu ms), "
+                     "single-request %u/%u, extra requests %u\n",
+                     shotMs, (unsigned long)(shutterLatency.averageUs() / 1000),
+                     (unsigned long)(shutterLatency.maxUs / 1000),
+                     captureFreshness.singleRequestShots, captureFreshness.shots,
+                     captureFreshness.extraRequests);
+        char message[OVERLAY_TEXT_MAX];
+        const char* baseName = strrchr(filename, '/');
+        snprintf(message, sizeof(message), "Saved %s (%lu ms)", baseName ? baseName + 1 : filename, shotMs);
+        showLiveMessage(message);
+        compositeLiveOverlay(0, 0, 0, 0);
       } else {
-        // logLine("SD card not initialized, cannot save photo");
-        M5Cardputer.Display.setCursor(10, 10);
-        M5Cardputer.Display.println("SD card not initialized");
-      }
-    } else {
-      // logLine("Capture failed");
-    }
-  }
-  
-  // 检查WiFi连接状态
-  if (WiFi.status() == WL_CONNECTED) {
-    if (!streamClient.connected()) {
-      if (appState.isRestartStream || !streamHttp.connected()) {
-        appState.isRestartStream = false;
-        
-        // 清除图像尺寸缓存（因为流重启了）
-        appState.sizeCached = false;
-        appState.cachedImgWidth = 0;
-        appState.cachedImgHeight = 0;
-        
-        streamHttp.end();
-        streamClient.stop();
-        
-        // 等待相机完成分辨率切换
-        delay(500);
-        
-        // logLine("Connecting to MJPEG stream...");
-        String url = "http://192.168.4.1/api/v1/stream";
-        streamHttp.begin(streamClient, url);
-        streamHttp.addHeader("User-Agent", "M5Cardputer");
-        streamHttp.addHeader("Connection", "keep-alive");
-        
-        int code = streamHttp.GET();
-        if (code != 200) {
-          // logLine(String("Failed to connect to MJPEG stream: HTTP ") + code);
-          streamHttp.end();
-          delay(2000);
-          return;
-        }
-        
-        // logLine("MJPEG stream connected successfully");
+        // logLine("Capture failed");
       }
     } else {
-      // 处理流数据
-      processMjpegStream(streamClient);
-    }
-  } else {
-    // WiFi未连接，停止当前连接
-    if (streamClient.connected()) {
-      streamClient.stop();
-      streamHttp.end();
-    }
-    // 每5秒检查一次WiFi状态
-    static unsigned long lastWifiCheck = 0;
-    if (millis() - lastWifiCheck > 5000) {
-      lastWifiCheck = millis();
-      // logLine("WiFi disconnected, waiting for network recovery...");
-    }
-  }
-  
-  // 显示JPEG帧
-  if (appState.jpegReady) {
-    int imgWidth, imgHeight;
-    
-    // 尝试使用缓存的图像尺寸
-    if (appState.sizeCached) {
-      imgWidth = appState.cachedImgWidth;
-      imgHeight = appState.cachedImgHeight;
-    } else {
-      // 解析JPEG尺寸
-      if (parseJpegSize(appState.jpegData, appState.jpegDataSize, imgWidth, imgHeight)) {
-        // 缓存图像尺寸
-        appState.cachedImgWidth = imgWidth;
-        appState.cachedImgHeight = imgHeight;
-        appState.sizeCached = true;
-      } else {
-        // 如果无法解析尺寸，默认显示左上角
-        M5Cardputer.Display.drawJpg(appState.jpegData, appState.jpegDataSize, 0, 0);
-        appState.jpegReady = false;
-        return;
-      }
+      // logLine("SD card not initialized, cannot save photo");
+      showLiveMessage("SD card not initialized");
+      compositeLiveOverlay(0, 0, 0, 0);
     }
-    
-    // 计算显示起始位置（居中显示）
-    int x = 0;
-    int y = 0;
-    
-    // 如果图像宽度小于屏幕宽度，居中显示
-    if (imgWidth < SCREEN_WIDTH) {
-      x = (SCREEN_WIDTH - imgWidth) / 2;
-    }
-    
-    // 如果图像高度小于屏幕高度，居中显示
-    if (imgHeight < SCREEN_HEIGHT) {
-      y = (SCREEN_HEIGHT - imgHeight) / 2;
-    }
-    
-    // 向LCD显示JPEG帧
-    // 注意：如果图像大于屏幕，drawJpg会自动裁切显示左上角部分
-    M5Cardputer.Display.drawJpg(appState.jpegData, appState.jpegDataSize, x, y);
-    
-    // 显示后重置就绪标志
-    appState.jpegReady = false;
   }
   
-  //delay(10);
+  // 操作处理完毕，恢复流水线（timelapse模式下保持暂停）
+  resumePipeline();
+  return handled;
 }
 
 // 主函数
@@ -1783,9 +3235,11 @@ void setup() {
     // 清屏，准备显示流画面
     M5Cardputer.Display.fillScreen(BLACK);
     
-    // 显示操作提示
-    M5Cardputer.Display.setCursor(10, 5);
-    M5Cardputer.Display.setTextColor(WHITE);
-    M5Cardputer.Display.println("Press BtnA to capture");
+    // 显示操作提示（叠加在最初几秒的预览画面上）
+    showLiveMessage("Press BtnA to capture");
+    compositeLiveOverlay(0, 0, 0, 0);
   }
+  
+  // 启动接收/解码任务（WiFi未连接时接收任务空转等待）
+  startPipeline();
 }
\ No newline at end of file
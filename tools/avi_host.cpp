@@ -0,0 +1,540 @@
+// timelapse AVI录制的主机端测试（Linux，与固件使用同一个mjpeg_avi.h）
+//   1. 写入吞吐：同样N帧，旧方式每帧写临时文件再重命名到会话目录，新方式追加到一个预分配的AVI，
+//      对比单帧耗时和吞吐，并校验生成的AVI
+//   2. 掉电模拟：在内存中按固件的写入顺序逐条应用写操作（预分配区域填满随机旧数据），
+//      每一条之后都校验文件结构，并检查已提交的帧全部可读（包括结束时搬移索引的过程）
+//   3. --check 校验卡上拷贝下来的AVI（录制中断的文件也应能通过）
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 -Iinclude tools/avi_host.cpp -o avi_host
+//   ./avi_host --dir /tmp/avi_host --frames 500 --frame-kb 40 --fsync
+//   ./avi_host --check /media/sdcard/images/timelapse/3/TL_3_00.avi
+
+#include <chrono>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+#include "latency_stats.h"
+#include "mjpeg_avi.h"
+
+#define WRITE_CHUNK (32 * 1024)   // 与固件CAPTURE_WRITE_CHUNK_SIZE相同
+
+static uint32_t micros() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Options {
+  int frames = 500;
+  int frameKb = 40;
+  int preallocMb = 32;
+  std::string dir = "avi_host_out";
+  std::string check;
+  bool fsync = false;
+};
+
+// 伪JPEG帧：SOI + 随机数据 + EOI，长度在frameSize附近浮动（含奇数长度，覆盖补齐字节）
+static void makeFrame(std::vector<uint8_t>& out, size_t frameSize, uint32_t seed) {
+  size_t size = frameSize * 4 / 5 + (seed * 2654435761u) % (frameSize * 2 / 5 + 1);
+  out.resize(size < 4 ? 4 : size);
+  uint32_t x = seed * 747796405u + 1;
+  for (size_t i = 0; i < out.size(); i++) {
+    x = x * 1103515245u + 12345u;
+    out[i] = (uint8_t)(x >> 16);
+  }
+  out[0] = 0xFF;
+  out[1] = 0xD8;
+  out[out.size() - 2] = 0xFF;
+  out[out.size() - 1] = 0xD9;
+}
+
+// ---- 校验 ----
+
+struct AviReport {
+  bool ok = false;
+  bool finalized = false;     // 文件头、movi、索引的帧数一致且文件长度与RIFF一致
+  std::string error;
+  uint32_t headerFrames = 0;  // avih中的帧数
+  uint32_t moviFrames = 0;    // movi列表内的帧块数
+  uint32_t indexFrames = 0;   // idx1中的有效项数
+  uint32_t width = 0;
+  uint32_t height = 0;
+};
+
+static bool fail(AviReport& r, const std::string& error) {
+  r.ok = false;
+  r.error = error;
+  return false;
+}
+
+// 按RIFF结构解析：RIFF长度之后的数据（预分配的剩余部分）忽略；
+// 录制中掉电时idx1可能比文件头多一项、帧块可能在movi列表之外，这些都允许，
+// 但idx1中的每一项都必须指向一个完整的JPEG帧块
+static bool validateAvi(const uint8_t* file, size_t len, AviReport& r) {
+  r = AviReport();
+  if (len < AVI_HEADER_SIZE || memcmp(file, "RIFF", 4) != 0 || memcmp(file + 8, "AVI ", 4) != 0) {
+    return fail(r, "not a RIFF AVI");
+  }
+  size_t riffEnd = (size_t)aviGet32(file + 4) + AVI_CHUNK_HEADER_SIZE;
+  if (riffEnd > len) {
+    return fail(r, "RIFF size beyond end of file");
+  }
+
+  size_t moviFourcc = 0, idxPos = 0, idxSize = 0;
+  bool hdrl = false;
+  size_t pos = 12;
+  while (pos + AVI_CHUNK_HEADER_SIZE <= riffEnd) {
+    const uint8_t* c = file + pos;
+    size_t size = aviGet32(c + 4);
+    size_t end = pos + AVI_CHUNK_HEADER_SIZE + size + (size & 1);
+    if (end > len) {
+      return fail(r, "chunk at " + std::to_string(pos) + " runs past end of file");
+    }
+    if (memcmp(c, "LIST", 4) == 0 && memcmp(c + 8, "hdrl", 4) == 0) {
+      const uint8_t* avih = c + 12;
+      const uint8_t* strh = avih + 64 + 12;
+      if (memcmp(avih, "avih", 4) != 0 || memcmp(strh, "strh", 4) != 0 ||
+          memcmp(strh + 8, "vids", 4) != 0 || memcmp(strh + 12, "MJPG", 4) != 0) {
+        return fail(r, "bad hdrl");
+      }
+      r.headerFrames = aviGet32(avih + 24);
+      r.width = aviGet32(avih + 40);
+      r.height = aviGet32(avih + 44);
+      hdrl = true;
+    } else if (memcmp(c, "LIST", 4) == 0 && memcmp(c + 8, "movi", 4) == 0) {
+      moviFourcc = pos + 8;
+      size_t moviEnd = pos + AVI_CHUNK_HEADER_SIZE + size;
+      for (size_t p = moviFourcc + 4; p + AVI_CHUNK_HEADER_SIZE <= moviEnd;) {
+        if (memcmp(file + p, "00dc", 4) != 0) {
+          return fail(r, "unexpected chunk in movi at " + std::to_string(p));
+        }
+        size_t n = aviGet32(file + p + 4);
+        p += AVI_CHUNK_HEADER_SIZE + n + (n & 1);
+        r.moviFrames++;
+      }
+    } else if (memcmp(c, "idx1", 4) == 0) {
+      idxPos = pos;
+      idxSize = size;
+    }
+    pos = end;
+  }
+  if (!hdrl || !moviFourcc) {
+    return fail(r, "missing hdrl or movi");
+  }
+  if (!idxPos) {
+    return fail(r, "missing idx1");
+  }
+
+  r.indexFrames = idxSize / AVI_INDEX_ENTRY_SIZE;
+  for (uint32_t i = 0; i < r.indexFrames; i++) {
+    const uint8_t* e = file + idxPos + AVI_CHUNK_HEADER_SIZE + i * AVI_INDEX_ENTRY_SIZE;
+    size_t at = moviFourcc + aviGet32(e + 8);
+    size_t size = aviGet32(e + 12);
+    if (memcmp(e, "00dc", 4) != 0 || at + AVI_CHUNK_HEADER_SIZE + size > len ||
+        memcmp(file + at, "00dc", 4) != 0 || aviGet32(file + at + 4) != size) {
+      return fail(r, "index entry " + std::to_string(i) + " does not match its chunk");
+    }
+    const uint8_t* jpeg = file + at + AVI_CHUNK_HEADER_SIZE;
+    if (size < 4 || jpeg[0] != 0xFF || jpeg[1] != 0xD8 || jpeg[size - 2] != 0xFF || jpeg[size - 1] != 0xD9) {
+      return fail(r, "frame " + std::to_string(i) + " is not a complete JPEG");
+    }
+  }
+  r.finalized = riffEnd == len && r.headerFrames == r.indexFrames && r.moviFrames == r.indexFrames;
+  r.ok = true;
+  return true;
+}
+
+static void printReport(const char* name, const AviReport& r) {
+  if (!r.ok) {
+    printf("%s: INVALID (%s)\n", name, r.error.c_str());
+    return;
+  }
+  printf("%s: ok, %ux%u, %u frames indexed (header %u, movi %u), %s\n", name, r.width, r.height,
+         r.indexFrames, r.headerFrames, r.moviFrames, r.finalized ? "finalized" : "in progress");
+}
+
+// ---- 写入目标：文件（测吞吐）或内存中的写操作记录（掉电模拟） ----
+
+class Sink {
+public:
+  virtual ~Sink() {}
+  virtual bool write(uint32_t offset, const uint8_t* data, size_t len, bool sync) = 0;
+  virtual bool read(uint32_t offset, uint8_t* data, size_t len) = 0;
+  virtual bool preallocate(uint32_t size) = 0;
+  virtual bool truncate(uint32_t size) = 0;
+  virtual void frameCommitted(uint32_t) {}
+};
+
+class FileSink : public Sink {
+public:
+  FileSink(const std::string& path, bool doFsync) : fsyncOnSync(doFsync) {
+    fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  }
+  ~FileSink() {
+    if (fd >= 0) {
+      close(fd);
+    }
+  }
+  bool write(uint32_t offset, const uint8_t* data, size_t len, bool sync) override {
+    bool ok = pwrite(fd, data, len, offset) == (ssize_t)len;
+    if (sync && fsyncOnSync) {
+      ::fsync(fd);
+    }
+    return ok;
+  }
+  bool read(uint32_t offset, uint8_t* data, size_t len) override {
+    return pread(fd, data, len, offset) == (ssize_t)len;
+  }
+  // 与固件在FAT上一次扩展簇链对应，这里真正分配空间（而不是稀疏文件）
+  bool preallocate(uint32_t size) override {
+    return posix_fallocate(fd, 0, size) == 0;
+  }
+  bool truncate(uint32_t size) override {
+    return ftruncate(fd, size) == 0;
+  }
+  int fd;
+
+private:
+  bool fsyncOnSync;
+};
+
+// 写操作记录：size为0且truncate为true表示截断
+struct WriteOp {
+  uint32_t offset;
+  std::vector<uint8_t> data;
+  bool truncate;
+  uint32_t frames;   // 这条操作之后已完整提交的帧数
+};
+
+class RecordingSink : public Sink {
+public:
+  explicit RecordingSink(size_t garbageSeed) : seed(garbageSeed) {}
+  bool write(uint32_t offset, const uint8_t* data, size_t len, bool) override {
+    ensure(offset + len);
+    memcpy(&image[offset], data, len);
+    ops.push_back({offset, std::vector<uint8_t>(data, data + len), false, committed});
+    return true;
+  }
+  bool read(uint32_t offset, uint8_t* data, size_t len) override {
+    memcpy(data, &image[offset], len);
+    return true;
+  }
+  bool preallocate(uint32_t size) override {
+    ensure(size);
+    allocated = size;
+    return true;
+  }
+  bool truncate(uint32_t size) override {
+    image.resize(size);
+    ops.push_back({size, {}, true, committed});
+    return true;
+  }
+  void frameCommitted(uint32_t frames) override {
+    committed = frames;
+  }
+  // 预分配区域的内容不确定：用随机数据模拟卡上残留的旧数据
+  void ensure(size_t size) {
+    while (image.size() < size) {
+      seed = seed * 6364136223846793005ull + 1442695040888963407ull;
+      image.push_back((uint8_t)(seed >> 56));
+    }
+  }
+  std::vector<uint8_t> image;
+  std::vector<WriteOp> ops;
+  uint32_t committed = 0;
+  uint32_t allocated = 0;
+  uint64_t seed;
+};
+
+// ---- 与固件相同的AVI写入流程（openTimelapseAvi / commitTimelapseAviFrame / closeTimelapseAvi） ----
+
+static bool aviOpen(MjpegAviRecorder& avi, Sink& sink, uint32_t allocated) {
+  if (!avi.begin(640, 480, 100000, allocated)) {
+    return false;
+  }
+  uint8_t header[AVI_HEADER_SIZE];
+  uint8_t gap[AVI_CHUNK_HEADER_SIZE];
+  uint8_t index[AVI_CHUNK_HEADER_SIZE];
+  avi.buildInitial(header, gap, index);
+  return sink.write(0, header, sizeof(header), false) &&
+         sink.write(avi.nextChunkOffset(), gap, sizeof(gap), false) &&
+         sink.preallocate(avi.allocated()) &&
+         sink.write(avi.indexOffset(), index, sizeof(index), true);
+}
+
+// 按32KB分块写帧数据；complete为false时只写一半并放弃（模拟校验失败的帧，由下一帧覆盖）
+static bool aviAddFrame(MjpegAviRecorder& avi, Sink& sink, const std::vector<uint8_t>& frame, bool complete) {
+  if (frame.size() > avi.frameCapacity()) {
+    return false;
+  }
+  size_t len = complete ? frame.size() : frame.size() / 2;
+  for (size_t off = 0; off < len; off += WRITE_CHUNK) {
+    size_t n = len - off < WRITE_CHUNK ? len - off : WRITE_CHUNK;
+    if (!sink.write(avi.nextDataOffset() + off, frame.data() + off, n, false)) {
+      return false;
+    }
+  }
+  if (!complete) {
+    return true;
+  }
+  AviFrameCommit commit;
+  avi.commitFrame(frame.size(), commit);
+  bool ok = sink.write(commit.tailOffset, commit.tail, commit.tailLen, false) &&
+            sink.write(commit.chunkOffset, commit.chunk, sizeof(commit.chunk), false) &&
+            sink.write(commit.entryOffset, commit.entry, sizeof(commit.entry), false) &&
+            sink.write(commit.indexOffset, commit.index, sizeof(commit.index), false);
+  sink.frameCommitted(avi.frameCount());
+  return ok && sink.write(0, commit.header, sizeof(commit.header), true);
+}
+
+static bool aviClose(MjpegAviRecorder& avi, Sink& sink) {
+  bool ok = true;
+  if (avi.canCompact()) {
+    std::vector<uint8_t> buffer(WRITE_CHUNK);
+    size_t total = (size_t)avi.frameCount() * AVI_INDEX_ENTRY_SIZE;
+    for (size_t done = 0; ok && done < total; done += WRITE_CHUNK) {
+      size_t n = total - done < WRITE_CHUNK ? total - done : WRITE_CHUNK;
+      ok = sink.read(avi.indexEntriesOffset() + done, buffer.data(), n) &&
+           sink.write(avi.finalEntriesOffset() + done, buffer.data(), n, false);
+    }
+    uint8_t gap[AVI_CHUNK_HEADER_SIZE];
+    uint8_t index[AVI_CHUNK_HEADER_SIZE];
+    uint8_t header[AVI_HEADER_SIZE];
+    uint32_t gapOffset;
+    avi.finish(gap, gapOffset, index, header);
+    ok = ok && sink.write(gapOffset, gap, sizeof(gap), false) &&
+         sink.write(avi.indexOffset(), index, sizeof(index), false) &&
+         sink.write(0, header, sizeof(header), true);
+  }
+  return ok && sink.truncate(avi.finalSize());
+}
+
+// ---- 1. 写入吞吐 ----
+
+static void clearDir(const std::string& dir) {
+  DIR* d = opendir(dir.c_str());
+  if (d) {
+    while (dirent* e = readdir(d)) {
+      if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+        unlink((dir + "/" + e->d_name).c_str());
+      }
+    }
+    closedir(d);
+  }
+  mkdir(dir.c_str(), 0755);
+}
+
+static void printRun(const char* name, const LatencyStats& frameTime, uint64_t bytes, uint32_t elapsedUs) {
+  printf("%-22s %5u frames  avg %6u us  max %7u us  %7.2f MB/s  %6.1f frames/s\n", name,
+         (unsigned)frameTime.count, (unsigned)frameTime.averageUs(), (unsigned)frameTime.maxUs,
+         elapsedUs ? bytes / (double)elapsedUs : 0.0, elapsedUs ? frameTime.count * 1e6 / elapsedUs : 0.0);
+}
+
+// 旧方式：每帧写临时文件（32KB分块）、落盘后重命名为会话目录中的IMG_1_NNNN.jpg
+static void benchFiles(const Options& opt) {
+  std::string session = opt.dir + "/files";
+  clearDir(session);
+  std::string temp = opt.dir + "/.capture.tmp";
+  std::vector<uint8_t> frame;
+  LatencyStats frameTime;
+  uint64_t bytes = 0;
+  uint32_t start = micros();
+  for (int k = 0; k < opt.frames; k++) {
+    makeFrame(frame, opt.frameKb * 1024, k);
+    uint32_t t0 = micros();
+    int fd = open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    for (size_t off = 0; off < frame.size(); off += WRITE_CHUNK) {
+      size_t n = frame.size() - off < WRITE_CHUNK ? frame.size() - off : WRITE_CHUNK;
+      if (write(fd, frame.data() + off, n) != (ssize_t)n) {
+        perror("write");
+        exit(1);
+      }
+    }
+    if (opt.fsync) {
+      ::fsync(fd);
+    }
+    close(fd);
+    char name[64];
+    snprintf(name, sizeof(name), "/IMG_1_%04d.jpg", k);
+    rename(temp.c_str(), (session + name).c_str());
+    frameTime.add(micros() - t0);
+    bytes += frame.size();
+  }
+  printRun("files (old)", frameTime, bytes, micros() - start);
+}
+
+// 新方式：追加到预分配的AVI，写满时换下一个文件（与固件TIMELAPSE_AVI_FRAME_MAX的处理相同）
+static bool benchAvi(const Options& opt) {
+  std::string session = opt.dir + "/avi";
+  clearDir(session);
+  std::vector<uint8_t> frame;
+  LatencyStats frameTime;
+  LatencyStats openTime;
+  LatencyStats closeTime;
+  uint64_t bytes = 0;
+  int part = 0;
+  bool ok = true;
+  std::vector<std::string> paths;
+
+  uint32_t start = micros();
+  MjpegAviRecorder avi;
+  FileSink* sink = nullptr;
+  for (int k = 0; ok && k < opt.frames; k++) {
+    makeFrame(frame, opt.frameKb * 1024, k);
+    if (!sink || avi.frameCapacity() < frame.size()) {
+      uint32_t t0 = micros();
+      if (sink) {
+        ok = aviClose(avi, *sink);
+        delete sink;
+        closeTime.add(micros() - t0);
+      }
+      char name[64];
+      snprintf(name, sizeof(name), "/TL_1_%02d.avi", part++);
+      paths.push_back(session + name);
+      t0 = micros();
+      sink = new FileSink(paths.back(), opt.fsync);
+      ok = ok && sink->fd >= 0 && aviOpen(avi, *sink, (uint32_t)opt.preallocMb * 1024 * 1024);
+      openTime.add(micros() - t0);
+    }
+    uint32_t t0 = micros();
+    ok = ok && aviAddFrame(avi, *sink, frame, true);
+    frameTime.add(micros() - t0);
+    bytes += frame.size();
+  }
+  if (sink) {
+    uint32_t t0 = micros();
+    ok = aviClose(avi, *sink) && ok;
+    delete sink;
+    closeTime.add(micros() - t0);
+  }
+  printRun("avi (new)", frameTime, bytes, micros() - start);
+  printf("  %d file(s), open+preallocate avg %u us, close avg %u us\n", part,
+         (unsigned)openTime.averageUs(), (unsigned)closeTime.averageUs());
+
+  for (const std::string& path : paths) {
+    FILE* f = fopen(path.c_str(), "rb");
+    std::vector<uint8_t> data;
+    if (f) {
+      fseek(f, 0, SEEK_END);
+      data.resize(ftell(f));
+      fseek(f, 0, SEEK_SET);
+      data.resize(fread(data.data(), 1, data.size(), f));
+      fclose(f);
+    }
+    AviReport report;
+    ok = validateAvi(data.data(), data.size(), report) && report.finalized && ok;
+    printReport(path.c_str(), report);
+  }
+  return ok;
+}
+
+// ---- 2. 掉电模拟 ----
+
+// 重放记录的写操作，每一条之后校验；已提交的帧必须都在索引里（最多多出正在提交的一帧）
+static bool replayOps(const RecordingSink& rec, size_t firstOp, const char* name) {
+  RecordingSink replay(rec.seed ^ 0x5bd1e995u);
+  replay.ensure(rec.allocated);
+  uint32_t checked = 0;
+  for (size_t i = 0; i < rec.ops.size(); i++) {
+    const WriteOp& op = rec.ops[i];
+    if (op.truncate) {
+      replay.image.resize(op.offset);
+    } else {
+      replay.ensure(op.offset + op.data.size());
+      memcpy(&replay.image[op.offset], op.data.data(), op.data.size());
+    }
+    if (i < firstOp) {
+      continue;
+    }
+    AviReport r;
+    validateAvi(replay.image.data(), replay.image.size(), r);
+    bool last = i + 1 == rec.ops.size();
+    if (!r.ok || r.indexFrames < op.frames || r.indexFrames > op.frames + 1 || (last && !r.finalized)) {
+      printf("%s: power loss after write %zu/%zu: ", name, i + 1, rec.ops.size());
+      printReport("", r);
+      return false;
+    }
+    checked++;
+  }
+  printf("%-22s %u power-loss points ok (%zu frames, %zu writes)\n", name, checked,
+         (size_t)rec.committed, rec.ops.size());
+  return true;
+}
+
+static bool crashTest(uint32_t allocated, int frames, size_t frameSize, const char* name) {
+  RecordingSink rec(allocated);
+  MjpegAviRecorder avi;
+  if (!aviOpen(avi, rec, allocated)) {
+    return false;
+  }
+  size_t firstOp = rec.ops.size();   // 文件创建完成之后的每一条写入都要能承受掉电
+  std::vector<uint8_t> frame;
+  for (int k = 0; k < frames; k++) {
+    makeFrame(frame, frameSize, k + 1000);
+    // 放不下时最后一帧正好填满空闲区，结束时不能再搬移索引
+    bool last = frame.size() > avi.frameCapacity();
+    if (last) {
+      frame.resize(avi.frameCapacity());
+      frame[frame.size() - 2] = 0xFF;
+      frame[frame.size() - 1] = 0xD9;
+    }
+    // 每7帧有一帧校验失败（只写了一半），下一帧覆盖同一位置
+    if (!aviAddFrame(avi, rec, frame, last || k % 7 != 3) || last) {
+      break;
+    }
+  }
+  return aviClose(avi, rec) && replayOps(rec, firstOp, name);
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--frames") { opt.frames = atoi(value); i++; }
+    else if (arg == "--frame-kb") { opt.frameKb = atoi(value); i++; }
+    else if (arg == "--prealloc-mb") { opt.preallocMb = atoi(value); i++; }
+    else if (arg == "--dir") { opt.dir = value; i++; }
+    else if (arg == "--check") { opt.check = value; i++; }
+    else if (arg == "--fsync") { opt.fsync = true; }
+    else {
+      fprintf(stderr, "usage: %s [--frames N] [--frame-kb K] [--prealloc-mb M] [--dir D] [--fsync]\n"
+                      "       %s --check FILE.avi\n", argv[0], argv[0]);
+      return 2;
+    }
+  }
+
+  if (!opt.check.empty()) {
+    FILE* f = fopen(opt.check.c_str(), "rb");
+    if (!f) {
+      perror(opt.check.c_str());
+      return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      data.insert(data.end(), buf, buf + n);
+    }
+    fclose(f);
+    AviReport report;
+    validateAvi(data.data(), data.size(), report);
+    printReport(opt.check.c_str(), report);
+    return report.ok ? 0 : 1;
+  }
+
+  mkdir(opt.dir.c_str(), 0755);
+  benchFiles(opt);
+  bool ok = benchAvi(opt);
+
+  // 正常结束（索引搬到movi之后）和写满结束（空闲区不够，保留末尾的索引区）两种情况
+  ok = crashTest(2 * 1024 * 1024, 60, 20 * 1024, "crash (compacted)") && ok;
+  ok = crashTest(512 * 1024, 1000, 20 * 1024, "crash (full file)") && ok;
+  return ok ? 0 : 1;
+}
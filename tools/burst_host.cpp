@@ -0,0 +1,261 @@
+// 连拍流水线的Linux版本：与固件使用同一套写回队列/新鲜度检测头文件，
+// 从相机（真实UnitCamS3或tools/mock_unitcam.py）连拍并写入本地目录，
+// 输出每秒张数、单张拍摄耗时、拍摄到写完的延迟和写盘耗时。
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 -pthread -Iinclude tools/burst_host.cpp -o burst_host
+//   ./burst_host --host 127.0.0.1 --port 8080 --shots 20 --dir /tmp/burst
+// --buffers 1 时拍摄与写盘完全串行，可作为对照；--fsync 每张写完后fsync
+// --wait-ms 为等待空闲缓冲区和最后写完的上限（与固件SD_WRITER_WAIT_MS相同，默认5000），
+// 超时即放弃连拍，可配合很大的--write-delay-ms模拟卡住的SD卡
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <condition_variable>
+#include <fcntl.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "capture_freshness.h"
+#include "jpeg_utils.h"
+#include "write_behind.h"
+
+static uint32_t micros() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Options {
+  std::string host = "192.168.4.1";
+  int port = 80;
+  int shots = 10;
+  int buffers = 3;
+  size_t bufferSize = 70 * 1024;
+  int framesize = 10;
+  std::string dir = "burst_out";
+  bool fsync = false;
+  int writeDelayMs = 0;
+  int waitMs = 5000;
+};
+
+// 发送GET请求，把响应体读入buf（最多cap字节），返回状态码，出错返回-1
+static int httpGet(const Options& opt, const std::string& path, uint8_t* buf, size_t cap, size_t& bodyLen) {
+  bodyLen = 0;
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  if (getaddrinfo(opt.host.c_str(), std::to_string(opt.port).c_str(), &hints, &res) != 0) {
+    return -1;
+  }
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+    freeaddrinfo(res);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  freeaddrinfo(res);
+
+  std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + opt.host +
+                    "\r\nUser-Agent: M5Cardputer\r\nConnection: close\r\n\r\n";
+  send(fd, req.data(), req.size(), 0);
+
+  // 先读响应头
+  std::string head;
+  char c;
+  while (head.size() < 4096 && recv(fd, &c, 1, 0) == 1) {
+    head += c;
+    if (head.size() >= 4 && head.compare(head.size() - 4, 4, "\r\n\r\n") == 0) {
+      break;
+    }
+  }
+  int status = -1;
+  sscanf(head.c_str(), "HTTP/1.%*d %d", &status);
+  long contentLength = -1;
+  size_t pos = head.find("Content-Length:");
+  if (pos != std::string::npos) {
+    contentLength = atol(head.c_str() + pos + 15);
+  }
+
+  while (bodyLen < cap && (contentLength < 0 || (long)bodyLen < contentLength)) {
+    ssize_t n = recv(fd, buf + bodyLen, cap - bodyLen, 0);
+    if (n <= 0) {
+      break;
+    }
+    bodyLen += n;
+  }
+  close(fd);
+  if (contentLength >= 0 && (long)bodyLen < contentLength) {
+    return -1;
+  }
+  return status;
+}
+
+// 与固件fetchBurstShot相同：旧帧（分辨率不符或与上一张相同）时重试
+static size_t fetchShot(const Options& opt, CaptureFreshness& freshness, uint8_t* buf, size_t cap) {
+  for (int attempt = 1; attempt <= 4; attempt++) {
+    size_t got = 0;
+    if (httpGet(opt, "/api/v1/capture", buf, cap, got) != 200) {
+      return 0;
+    }
+    if (freshness.checkHeader(buf, got) == CAPTURE_STALE) {
+      continue;
+    }
+    size_t size = trimToEOI(buf, got);
+    if (size == 0) {
+      return 0;
+    }
+    FrameFingerprint fp = fingerprintFrame(buf, size);
+    if (freshness.checkFrame(fp) == CAPTURE_STALE && attempt < 4) {
+      continue;
+    }
+    freshness.accept(fp, attempt);
+    return size;
+  }
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--host") { opt.host = value; i++; }
+    else if (arg == "--port") { opt.port = atoi(value); i++; }
+    else if (arg == "--shots") { opt.shots = atoi(value); i++; }
+    else if (arg == "--buffers") { opt.buffers = atoi(value); i++; }
+    else if (arg == "--buffer-kb") { opt.bufferSize = atoi(value) * 1024; i++; }
+    else if (arg == "--framesize") { opt.framesize = atoi(value); i++; }
+    else if (arg == "--dir") { opt.dir = value; i++; }
+    else if (arg == "--write-delay-ms") { opt.writeDelayMs = atoi(value); i++; }
+    else if (arg == "--wait-ms") { opt.waitMs = atoi(value); i++; }
+    else if (arg == "--fsync") { opt.fsync = true; }
+    else {
+      fprintf(stderr, "usage: %s [--host H] [--port P] [--shots N] [--buffers N] [--buffer-kb K]\n"
+                      "          [--framesize F] [--dir D] [--write-delay-ms MS] [--wait-ms MS] [--fsync]\n", argv[0]);
+      return 2;
+    }
+  }
+  mkdir(opt.dir.c_str(), 0755);
+
+  size_t dummy = 0;
+  uint8_t small[64];
+  if (httpGet(opt, "/api/v1/control?var=framesize&val=" + std::to_string(opt.framesize),
+              small, sizeof(small), dummy) != 200) {
+    fprintf(stderr, "failed to set framesize\n");
+    return 1;
+  }
+  CaptureFreshness freshness;
+  freshness.expectFramesize(opt.framesize);
+
+  std::vector<std::vector<uint8_t>> storage(opt.buffers, std::vector<uint8_t>(opt.bufferSize));
+  std::vector<uint8_t*> pointers;
+  for (auto& b : storage) {
+    pointers.push_back(b.data());
+  }
+  WriteBehindQueue queue;
+  queue.attachBuffers(pointers.data(), (int)pointers.size(), opt.bufferSize);
+
+  // 写入线程（对应固件的sdWriterTask），--write-delay-ms模拟慢速SD卡
+  std::mutex wakeLock;
+  std::condition_variable wake;
+  bool stop = false;
+  std::thread writer([&]() {
+    for (;;) {
+      WriteJob job;
+      if (!queue.next(job)) {
+        std::unique_lock<std::mutex> guard(wakeLock);
+        if (stop) {
+          return;
+        }
+        wake.wait_for(guard, std::chrono::milliseconds(50));
+        continue;
+      }
+      uint32_t start = micros();
+      bool ok = false;
+      int fd = open(job.path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+      if (fd >= 0) {
+        ok = write(fd, job.data, job.size) == (ssize_t)job.size;
+        if (opt.fsync) {
+          ::fsync(fd);
+        }
+        close(fd);
+      }
+      if (opt.writeDelayMs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(opt.writeDelayMs));
+      }
+      queue.complete(job, ok, micros() - start, micros());
+    }
+  });
+
+  LatencyStats fetchTime;
+  uint32_t burstStart = micros();
+  bool stalled = false;
+  for (int k = 0; k < opt.shots; k++) {
+    // 与固件captureBurst相同：等待空闲缓冲区有上限，超时放弃剩下的张数
+    int buffer;
+    uint32_t waitStart = micros();
+    while ((buffer = queue.acquireBuffer()) < 0 && micros() - waitStart < opt.waitMs * 1000u) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (buffer < 0) {
+      fprintf(stderr, "writer stalled, aborting after %d shots\n", k);
+      stalled = true;
+      break;
+    }
+    uint32_t shotStart = micros();
+    size_t size = fetchShot(opt, freshness, queue.bufferData(buffer), queue.bufferCapacity());
+    if (size == 0) {
+      fprintf(stderr, "shot %d failed\n", k + 1);
+      queue.cancelBuffer(buffer);
+      continue;
+    }
+    fetchTime.add(micros() - shotStart);
+
+    char path[WRITE_BEHIND_PATH_MAX];
+    snprintf(path, sizeof(path), "%s/BST_%02d.jpg", opt.dir.c_str(), k + 1);
+    queue.submit(buffer, path, size, shotStart);
+    wake.notify_one();
+  }
+  uint32_t waitStart = micros();
+  while (!queue.idle()) {
+    if (micros() - waitStart >= opt.waitMs * 1000u) {
+      fprintf(stderr, "writes still pending after %d ms\n", opt.waitMs);
+      stalled = true;
+      break;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  double elapsed = (micros() - burstStart) / 1e6;
+  {
+    std::lock_guard<std::mutex> guard(wakeLock);
+    stop = true;
+  }
+  wake.notify_one();
+  writer.join();
+
+  printf("burst      %u/%d saved in %.3f s, %.2f shots/s, %.1f KB/s\n",
+         queue.written, opt.shots, elapsed, queue.written / elapsed,
+         queue.bytesWritten / 1024.0 / elapsed);
+  printf("fetch      avg %.1f ms, max %.1f ms\n",
+         fetchTime.averageUs() / 1000.0, fetchTime.maxUs / 1000.0);
+  printf("shot2disk  avg %.1f ms, max %.1f ms\n",
+         queue.jobLatency.averageUs() / 1000.0, queue.jobLatency.maxUs / 1000.0);
+  printf("write      avg %.1f ms, max %.1f ms\n",
+         queue.writeTime.averageUs() / 1000.0, queue.writeTime.maxUs / 1000.0);
+  printf("queue      buffers %d, max depth %d, stalls %u, failed %u, extra requests %u\n",
+         opt.buffers, queue.maxDepth, queue.stalls, queue.failed, freshness.extraRequests);
+  if (stalled) {
+    printf("burst      aborted: writer stalled\n");
+    return 1;
+  }
+  return queue.failed == 0 && queue.written == (uint32_t)opt.shots ? 0 : 1;
+}
@@ -0,0 +1,154 @@
+#!/usr/bin/env python3
+"""相机接口性能探测（仅依赖Python标准库）
+
+按设备端main.cpp相同的请求方式访问相机（真实UnitCamS3或tools/mock_unitcam.py），
+输出串流帧率/吞吐、拍照往返时间、参数控制延迟，便于在烧录前发现性能回退。
+
+示例：
+  python3 tools/camera_probe.py --host 127.0.0.1 --port 8080 --stream-seconds 10
+"""
+
+import argparse
+import http.client
+import statistics
+import time
+
+
+def summarize(name, samples_ms):
+    if not samples_ms:
+        print("%-10s no samples" % name)
+        return
+    ordered = sorted(samples_ms)
+    p95 = ordered[min(len(ordered) - 1, int(len(ordered) * 0.95))]
+    print("%-10s n=%d min %.1f ms, avg %.1f ms, p95 %.1f ms, max %.1f ms" % (
+        name, len(ordered), ordered[0], statistics.mean(ordered), p95, ordered[-1]))
+
+
+def get(host, port, path, timeout):
+    """单次GET（每次新建连接，与设备端HTTPClient用法一致），返回(状态码, 数据)"""
+    conn = http.client.HTTPConnection(host, port, timeout=timeout)
+    try:
+        conn.request("GET", path, headers={"User-Agent": "M5Cardputer"})
+        resp = conn.getresponse()
+        return resp.status, resp.read()
+    finally:
+        conn.close()
+
+
+def probe_stream(args):
+    """读取MJPEG流并按SOI/EOI切帧（与设备端解析逻辑一致）"""
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    conn.request("GET", "/api/v1/stream", headers={"User-Agent": "M5Cardputer"})
+    resp = conn.getresponse()
+    if resp.status != 200:
+        print("stream     HTTP %d" % resp.status)
+        return
+
+    start = time.monotonic()
+    first_frame_ms = None
+    total_bytes = 0
+    frames = 0
+    frame_sizes = []
+    buf = b""
+    while time.monotonic() - start < args.stream_seconds:
+        chunk = resp.read1(16384) if hasattr(resp, "read1") else resp.read(4096)
+        if not chunk:
+            break
+        total_bytes += len(chunk)
+        buf += chunk
+        while True:
+            soi = buf.find(b"\xff\xd8")
+            if soi < 0:
+                buf = buf[-1:]
+                break
+            eoi = buf.find(b"\xff\xd9", soi + 2)
+            if eoi < 0:
+                buf = buf[soi:]
+                break
+            frames += 1
+            frame_sizes.append(eoi + 2 - soi)
+            if first_frame_ms is None:
+                first_frame_ms = (time.monotonic() - start) * 1000.0
+            buf = buf[eoi + 2:]
+    elapsed = time.monotonic() - start
+    conn.close()
+
+    print("stream     %.1f fps, %.1f KB/s, %d frames, avg %.1f KB/frame, first frame %.1f ms" % (
+        frames / elapsed, total_bytes / elapsed / 1024.0, frames,
+        (statistics.mean(frame_sizes) / 1024.0) if frame_sizes else 0.0,
+        first_frame_ms or 0.0))
+
+
+def probe_capture(args):
+    single = []
+    sequence = []
+    for _ in range(args.captures):
+        # 设备端流程：触发GET、等待、再GET取图
+        t0 = time.monotonic()
+        get(args.host, args.port, "/api/v1/capture", args.timeout)
+        t1 = time.monotonic()
+        time.sleep(args.capture_wait_ms / 1000.0)
+        status, data = get(args.host, args.port, "/api/v1/capture", args.timeout)
+        t2 = time.monotonic()
+        if status != 200 or not data.startswith(b"\xff\xd8"):
+            print("capture    bad response: HTTP %d, %d bytes" % (status, len(data)))
+            continue
+        single.append((t1 - t0) * 1000.0)
+        sequence.append((t2 - t0) * 1000.0)
+    summarize("capture", single)
+    summarize("capture2x", sequence)
+
+
+def probe_control(args):
+    # 每条命令新建连接（旧固件的方式）
+    samples = []
+    for i in range(args.controls):
+        t0 = time.monotonic()
+        status, _ = get(args.host, args.port,
+                        "/api/v1/control?var=brightness&val=%d" % (i % 2), args.timeout)
+        if status == 200:
+            samples.append((time.monotonic() - t0) * 1000.0)
+    summarize("control", samples)
+
+    # 复用keep-alive连接（固件控制通道的方式），断开时重连一次
+    samples = []
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    for i in range(args.controls):
+        t0 = time.monotonic()
+        for attempt in range(2):
+            try:
+                conn.request("GET", "/api/v1/control?var=brightness&val=%d" % (i % 2),
+                             headers={"User-Agent": "M5Cardputer"})
+                resp = conn.getresponse()
+                resp.read()
+                break
+            except (http.client.HTTPException, OSError):
+                conn.close()
+                resp = None
+        if resp is not None and resp.status == 200:
+            samples.append((time.monotonic() - t0) * 1000.0)
+    conn.close()
+    summarize("control-ka", samples)
+
+    status, body = get(args.host, args.port, "/api/v1/status", args.timeout)
+    print("status     HTTP %d, %d bytes" % (status, len(body)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="UnitCamS3 HTTP performance probe")
+    parser.add_argument("--host", default="192.168.4.1")
+    parser.add_argument("--port", type=int, default=80)
+    parser.add_argument("--timeout", type=float, default=15.0)
+    parser.add_argument("--stream-seconds", type=float, default=10.0)
+    parser.add_argument("--captures", type=int, default=5)
+    parser.add_argument("--capture-wait-ms", type=float, default=500.0)
+    parser.add_argument("--controls", type=int, default=20)
+    args = parser.parse_args()
+
+    probe_stream(args)
+    probe_capture(args)
+    probe_control(args)
+
+
+if __name__ == "__main__":
+    main()
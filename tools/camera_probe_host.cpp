@@ -0,0 +1,480 @@
+// 相机接口性能探测的C++版本：与固件使用同一套multipart_reader.h/mjpeg_parser.h/control_queue.h/capture_freshness.h，
+// 按固件的方式访问相机（真实UnitCamS3或tools/mock_unitcam.py），与tools/camera_probe.py输出相同的几项：
+//   stream      串流帧率、吞吐、平均帧大小、首帧时间和最长帧间隔（固件的读取器，每次读4KB；--scan改用标记扫描）
+//   capture     单次/api/v1/capture往返时间，以及按固件的新鲜度检查拿到新帧的时间和请求次数
+//   control     每条命令新建连接（旧固件的方式）的延迟分布
+//   control-ka  复用keep-alive连接（固件控制通道的方式，断开重连一次）的延迟分布
+//   ramp        按住调节键时的连续设置：ControlQueue合并后由发送线程发出，输出合并数和最后一次设置到发完的时间
+// 控制和拍照在串流运行期间进行，与固件的情况相同。串流没有帧、拍照或控制失败时返回非0。
+//
+// 编译与运行：
+//   python3 tools/mock_unitcam.py --port 8080 --control-latency-ms 5 &
+//   g++ -std=c++17 -O2 -pthread -Iinclude tools/camera_probe_host.cpp -o camera_probe_host
+//   ./camera_probe_host --host 127.0.0.1 --port 8080 --stream-seconds 10
+
+#include <atomic>
+#include <chrono>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "capture_freshness.h"
+#include "control_queue.h"
+#include "jpeg_utils.h"
+#include "latency_stats.h"
+#include "mjpeg_parser.h"
+#include "multipart_reader.h"
+
+#define READ_CHUNK_SIZE 4096        // 与固件MJPEG_READ_CHUNK_SIZE相同
+#define FRAME_CAPACITY (70 * 1024)  // 与固件GLOBAL_MAX_JPEG_SIZE相同
+#define CAPTURE_CAPACITY (256 * 1024)
+#define CAPTURE_ATTEMPTS 4          // 与固件fetchBurstShot相同
+
+struct Options {
+  std::string host = "192.168.4.1";
+  int port = 80;
+  int timeoutMs = 15000;
+  double streamSeconds = 10;
+  int captures = 5;
+  int framesize = 6;
+  int controls = 20;
+  int rampSteps = 50;
+  int rampStepMs = 5;
+  bool scan = false;
+};
+
+static uint32_t micros() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+// 连接到相机，返回socket（阻塞，带收发超时），失败返回-1
+static int connectCamera(const Options& opt) {
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  if (getaddrinfo(opt.host.c_str(), std::to_string(opt.port).c_str(), &hints, &res) != 0) {
+    return -1;
+  }
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+    freeaddrinfo(res);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  freeaddrinfo(res);
+  timeval tv = {opt.timeoutMs / 1000, (opt.timeoutMs % 1000) * 1000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+  return fd;
+}
+
+// 读响应头，返回状态码（出错返回-1），头部原文存入head
+static int readHead(int fd, std::string& head) {
+  head.clear();
+  char c;
+  while (head.size() < 4096 && recv(fd, &c, 1, 0) == 1) {
+    head += c;
+    if (head.size() >= 4 && head.compare(head.size() - 4, 4, "\r\n\r\n") == 0) {
+      int status = -1;
+      sscanf(head.c_str(), "HTTP/1.%*d %d", &status);
+      return status;
+    }
+  }
+  return -1;
+}
+
+// 取响应头中某一项的值（不区分大小写），没有时返回空串
+static std::string headerValue(const std::string& head, const char* name) {
+  size_t n = strlen(name);
+  size_t pos = 0;
+  while (pos < head.size()) {
+    size_t end = head.find("\r\n", pos);
+    if (end == std::string::npos) {
+      break;
+    }
+    if (end - pos > n && strncasecmp(head.c_str() + pos, name, n) == 0 && head[pos + n] == ':') {
+      size_t v = head.find_first_not_of(' ', pos + n + 1);
+      return v < end ? head.substr(v, end - v) : "";
+    }
+    pos = end + 2;
+  }
+  return "";
+}
+
+// 与固件控制通道相同的keep-alive连接：连接断开或请求失败时重连并重发一次
+class CameraConnection {
+public:
+  explicit CameraConnection(const Options& o) : opt(o) {}
+
+  ~CameraConnection() {
+    disconnect();
+  }
+
+  // 发送GET，响应体读入body（可为nullptr），返回状态码，出错返回-1
+  int get(const std::string& path, std::vector<uint8_t>* body = nullptr) {
+    for (int attempt = 0; attempt < 2; attempt++) {
+      if (fd < 0) {
+        fd = connectCamera(opt);
+        if (fd < 0) {
+          continue;
+        }
+        connects++;
+      }
+      int status = request(path, body);
+      if (status > 0) {
+        return status;
+      }
+      disconnect();
+    }
+    return -1;
+  }
+
+  uint32_t connects = 0;
+
+private:
+  int request(const std::string& path, std::vector<uint8_t>* body) {
+    std::string req = "GET " + path + " HTTP/1.1\r\nHost: " + opt.host +
+                      "\r\nUser-Agent: M5Cardputer\r\nConnection: keep-alive\r\n\r\n";
+    if (send(fd, req.data(), req.size(), MSG_NOSIGNAL) != (ssize_t)req.size()) {
+      return -1;
+    }
+    std::string head;
+    int status = readHead(fd, head);
+    if (status < 0) {
+      return -1;
+    }
+    std::string length = headerValue(head, "Content-Length");
+    if (length.empty()) {
+      return -1;   // 没有长度无法在同一连接上读下一个响应
+    }
+    size_t remaining = (size_t)atol(length.c_str());
+    if (body) {
+      body->clear();
+    }
+    uint8_t buf[4096];
+    while (remaining > 0) {
+      ssize_t n = recv(fd, buf, remaining < sizeof(buf) ? remaining : sizeof(buf), 0);
+      if (n <= 0) {
+        return -1;
+      }
+      if (body) {
+        body->insert(body->end(), buf, buf + n);
+      }
+      remaining -= n;
+    }
+    if (strcasecmp(headerValue(head, "Connection").c_str(), "close") == 0) {
+      disconnect();
+    }
+    return status;
+  }
+
+  void disconnect() {
+    if (fd >= 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+
+  const Options& opt;
+  int fd = -1;
+};
+
+// 每次新建连接的GET（旧固件HTTPClient的用法），返回状态码，出错返回-1
+static int getOnce(const Options& opt, const std::string& path, std::vector<uint8_t>* body = nullptr) {
+  CameraConnection conn(opt);
+  return conn.get(path, body);
+}
+
+static void printHistogram(const char* name, const LatencyHistogram& h, uint32_t failed) {
+  if (h.stats.count == 0) {
+    printf("%-11s no samples, failed %u\n", name, failed);
+    return;
+  }
+  printf("%-11s n=%u avg %.1f ms, p95 <%u ms, max %.1f ms, failed %u  [", name, h.stats.count,
+         h.stats.averageUs() / 1000.0, h.percentileMs(95), h.stats.maxUs / 1000.0, failed);
+  for (int i = 0; i < LatencyHistogram::BUCKET_COUNT; i++) {
+    if (i < LatencyHistogram::BUCKET_COUNT - 1) {
+      printf("%s<%u:%u", i ? " " : "", LatencyHistogram::bucketLimitMs(i), h.buckets[i]);
+    } else {
+      printf(" >=%u:%u", LatencyHistogram::bucketLimitMs(i - 1), h.buckets[i]);
+    }
+  }
+  printf("] ms\n");
+}
+
+struct StreamResult {
+  int status = -1;
+  uint32_t frames = 0;
+  uint32_t byLength = 0;
+  uint64_t bytes = 0;
+  uint64_t frameBytes = 0;
+  uint32_t firstFrameUs = 0;
+  uint32_t maxGapUs = 0;
+  double seconds = 0;
+};
+
+// 按固件serviceStream的方式读取：每次最多READ_CHUNK_SIZE字节，读到完整帧就取走
+// start为发出串流请求的时刻（首帧时间从请求算起）
+template <typename Parser>
+static void readStream(Parser& parser, int fd, uint32_t start, const std::atomic<bool>& stop, StreamResult& r) {
+  static uint8_t frame[FRAME_CAPACITY];
+  uint8_t chunk[READ_CHUNK_SIZE];
+  parser.setBuffer(frame, sizeof(frame));
+  uint32_t lastFrame = start;
+  while (!stop.load()) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0) {
+      break;
+    }
+    r.bytes += n;
+    size_t offset = 0;
+    while (offset < (size_t)n) {
+      offset += parser.feed(chunk + offset, n - offset);
+      if (parser.frameReady()) {
+        uint32_t now = micros();
+        if (r.frames == 0) {
+          r.firstFrameUs = now - start;
+        } else if (now - lastFrame > r.maxGapUs) {
+          r.maxGapUs = now - lastFrame;
+        }
+        lastFrame = now;
+        r.frames++;
+        r.frameBytes += parser.frameSize();
+        parser.consumeFrame();
+      }
+    }
+  }
+  r.seconds = (micros() - start) / 1e6;
+}
+
+static void runStream(const Options& opt, const std::atomic<bool>& stop, StreamResult& r) {
+  int fd = connectCamera(opt);
+  if (fd < 0) {
+    return;
+  }
+  timeval tv = {1, 0};   // 每秒检查一次是否结束
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::string req = "GET /api/v1/stream HTTP/1.1\r\nHost: " + opt.host +
+                    "\r\nUser-Agent: M5Cardputer\r\nConnection: keep-alive\r\n\r\n";
+  uint32_t start = micros();
+  send(fd, req.data(), req.size(), MSG_NOSIGNAL);
+  std::string head;
+  r.status = readHead(fd, head);
+  if (r.status == 200) {
+    if (opt.scan) {
+      MjpegParser parser;
+      readStream(parser, fd, start, stop, r);
+    } else {
+      MultipartMjpegReader reader;
+      reader.begin(headerValue(head, "Content-Type").c_str(),
+                   strcasecmp(headerValue(head, "Transfer-Encoding").c_str(), "chunked") == 0);
+      readStream(reader, fd, start, stop, r);
+      r.byLength = reader.framesByLength;
+    }
+  }
+  close(fd);
+}
+
+// 与固件fetchBurstShot相同：旧帧（分辨率不符或与上一张相同）时重试，返回请求次数，失败返回0
+static int fetchFresh(const Options& opt, CaptureFreshness& freshness, std::vector<uint8_t>& body,
+                      LatencyHistogram& roundTrip) {
+  for (int attempt = 1; attempt <= CAPTURE_ATTEMPTS; attempt++) {
+    uint32_t start = micros();
+    if (getOnce(opt, "/api/v1/capture", &body) != 200 || body.empty()) {
+      return 0;
+    }
+    roundTrip.add(micros() - start);
+    if (freshness.checkHeader(body.data(), body.size()) == CAPTURE_STALE) {
+      continue;
+    }
+    size_t size = trimToEOI(body.data(), body.size());
+    if (size == 0) {
+      return 0;
+    }
+    FrameFingerprint fp = fingerprintFrame(body.data(), size);
+    if (freshness.checkFrame(fp) == CAPTURE_STALE && attempt < CAPTURE_ATTEMPTS) {
+      continue;
+    }
+    freshness.accept(fp, attempt);
+    return attempt;
+  }
+  return 0;
+}
+
+static bool probeCapture(const Options& opt) {
+  CaptureFreshness freshness;
+  freshness.expectFramesize(opt.framesize);
+  LatencyHistogram roundTrip;
+  LatencyHistogram fresh;
+  uint32_t failed = 0;
+  uint32_t attempts = 0;
+  std::vector<uint8_t> body;
+  body.reserve(CAPTURE_CAPACITY);
+  for (int i = 0; i < opt.captures; i++) {
+    uint32_t start = micros();
+    int n = fetchFresh(opt, freshness, body, roundTrip);
+    if (n == 0) {
+      failed++;
+      continue;
+    }
+    attempts += n;
+    fresh.add(micros() - start);
+  }
+  printHistogram("capture", roundTrip, 0);
+  printHistogram("capture-new", fresh, failed);
+  if (fresh.stats.count) {
+    printf("%-11s %.2f requests per fresh frame\n", "", (double)attempts / fresh.stats.count);
+  }
+  return failed == 0;
+}
+
+static bool probeControl(const Options& opt) {
+  // 每条命令新建连接
+  LatencyHistogram single;
+  uint32_t singleFailed = 0;
+  for (int i = 0; i < opt.controls; i++) {
+    uint32_t start = micros();
+    if (getOnce(opt, "/api/v1/control?var=brightness&val=" + std::to_string(i % 2)) == 200) {
+      single.add(micros() - start);
+    } else {
+      singleFailed++;
+    }
+  }
+  printHistogram("control", single, singleFailed);
+
+  // 复用keep-alive连接
+  CameraConnection conn(opt);
+  LatencyHistogram keepAlive;
+  uint32_t keepAliveFailed = 0;
+  for (int i = 0; i < opt.controls; i++) {
+    uint32_t start = micros();
+    if (conn.get("/api/v1/control?var=brightness&val=" + std::to_string(i % 2)) == 200) {
+      keepAlive.add(micros() - start);
+    } else {
+      keepAliveFailed++;
+    }
+  }
+  printHistogram("control-ka", keepAlive, keepAliveFailed);
+  printf("%-11s %u connection(s) for %d requests\n", "", conn.connects, opt.controls);
+
+  // 按住调节键：每rampStepMs设置一次，发送线程与固件cameraControlTask相同，逐条取出发送
+  ControlQueue queue;
+  LatencyHistogram ramp;
+  std::atomic<bool> producing{true};
+  std::thread sender([&]() {
+    for (;;) {
+      bool done = !producing.load();
+      ControlUpdate update;
+      if (!queue.pop(update)) {
+        if (done) {
+          break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      uint32_t start = micros();
+      bool ok = conn.get(std::string("/api/v1/control?var=") + update.var + "&val=" +
+                         std::to_string(update.value)) == 200;
+      if (ok) {
+        ramp.add(micros() - start);
+      }
+      queue.complete(ok);
+    }
+  });
+  uint32_t lastSet = 0;
+  for (int i = 0; i < opt.rampSteps; i++) {
+    if (i > 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(opt.rampStepMs));
+    }
+    queue.set("brightness", i % 5 - 2);
+    lastSet = micros();
+  }
+  while (!queue.idle()) {
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  uint32_t settleUs = micros() - lastSet;
+  producing.store(false);
+  sender.join();
+  printHistogram("ramp", ramp, queue.failed);
+  printf("%-11s %u set every %d ms, %u sent, %u coalesced, settled %.1f ms after the last set\n", "",
+         queue.requested, opt.rampStepMs, queue.issued, queue.coalesced, settleUs / 1000.0);
+
+  std::vector<uint8_t> status;
+  int code = conn.get("/api/v1/status", &status);
+  printf("%-11s HTTP %d, %zu bytes\n", "status", code, status.size());
+  return keepAliveFailed == 0 && queue.failed == 0 && code == 200;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--host") { opt.host = value; i++; }
+    else if (arg == "--port") { opt.port = atoi(value); i++; }
+    else if (arg == "--timeout-ms") { opt.timeoutMs = atoi(value); i++; }
+    else if (arg == "--stream-seconds") { opt.streamSeconds = atof(value); i++; }
+    else if (arg == "--captures") { opt.captures = atoi(value); i++; }
+    else if (arg == "--framesize") { opt.framesize = atoi(value); i++; }
+    else if (arg == "--controls") { opt.controls = atoi(value); i++; }
+    else if (arg == "--ramp-steps") { opt.rampSteps = atoi(value); i++; }
+    else if (arg == "--ramp-step-ms") { opt.rampStepMs = atoi(value); i++; }
+    else if (arg == "--scan") { opt.scan = true; }
+    else {
+      fprintf(stderr, "usage: %s [--host H] [--port P] [--timeout-ms MS] [--stream-seconds S] [--captures N]\n"
+                      "          [--framesize F] [--controls N] [--ramp-steps N] [--ramp-step-ms MS] [--scan]\n",
+              argv[0]);
+      return 2;
+    }
+  }
+
+  if (getOnce(opt, "/api/v1/control?var=framesize&val=" + std::to_string(opt.framesize)) != 200) {
+    fprintf(stderr, "cannot reach camera at %s:%d\n", opt.host.c_str(), opt.port);
+    return 1;
+  }
+
+  // 串流在后台运行整个探测期间，拍照和控制在串流运行时进行
+  std::atomic<bool> stop{false};
+  StreamResult stream;
+  uint32_t start = micros();
+  std::thread streamer(runStream, std::cref(opt), std::cref(stop), std::ref(stream));
+  std::this_thread::sleep_for(std::chrono::milliseconds(500));
+  bool ok = probeCapture(opt);
+  ok &= probeControl(opt);
+  double elapsed = (micros() - start) / 1e6;
+  if (elapsed < opt.streamSeconds) {
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.streamSeconds - elapsed));
+  }
+  stop.store(true);
+  streamer.join();
+
+  if (stream.status != 200) {
+    printf("%-11s HTTP %d\n", "stream", stream.status);
+    ok = false;
+  } else {
+    double seconds = stream.seconds > 0 ? stream.seconds : 1;
+    printf("%-11s %.1f fps, %.1f KB/s, %u frames, avg %.1f KB/frame, first frame %.1f ms, max gap %.1f ms",
+           "stream", stream.frames / seconds, stream.bytes / seconds / 1024.0, stream.frames,
+           stream.frames ? stream.frameBytes / 1024.0 / stream.frames : 0.0, stream.firstFrameUs / 1000.0,
+           stream.maxGapUs / 1000.0);
+    if (!opt.scan) {
+      printf(", by length %u", stream.byLength);
+    }
+    printf("\n");
+    ok &= stream.frames > 0;
+  }
+  if (!ok) {
+    printf("FAILED\n");
+  }
+  return ok ? 0 : 1;
+}
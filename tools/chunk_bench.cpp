@@ -0,0 +1,119 @@
+// 按块大小测试写盘吞吐（Linux，主机文件系统作为后端）
+// 模拟设备端保存照片：网络数据按TCP分段大小（约1.4KB）陆续到达，
+// 攒满一块后写一次文件，比较1KB（原timelapse逐KB写入）到32KB（簇大小）各种块大小的吞吐和写调用次数。
+// 插上读卡器、把--dir指向SD卡挂载目录并加--fsync，可以更接近真实SD卡的表现。
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 tools/chunk_bench.cpp -o chunk_bench
+//   ./chunk_bench --dir /tmp/chunk_bench --frames 200 --frame-kb 60 --fsync
+
+#include <chrono>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+struct Result {
+  double seconds;
+  uint64_t writes;
+};
+
+static Result runChunkSize(const std::string& dir, size_t chunkSize, int frames, size_t frameSize,
+                           bool doFsync) {
+  std::vector<uint8_t> frame(frameSize);
+  for (size_t i = 0; i < frameSize; i++) {
+    frame[i] = (uint8_t)(i * 131 + 7);
+  }
+  std::vector<uint8_t> chunk(chunkSize);
+  const size_t SEGMENT = 1436;   // 模拟每次从socket读到的数据量
+  uint64_t writes = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for (int f = 0; f < frames; f++) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/IMG_%zu_%04d.jpg", dir.c_str(), chunkSize / 1024, f);
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      perror(path);
+      exit(1);
+    }
+
+    size_t filled = 0;
+    for (size_t off = 0; off < frameSize;) {
+      size_t n = frameSize - off < SEGMENT ? frameSize - off : SEGMENT;
+      // 分段可能跨块边界
+      while (n > 0) {
+        size_t take = chunkSize - filled < n ? chunkSize - filled : n;
+        for (size_t i = 0; i < take; i++) {
+          chunk[filled + i] = frame[off + i];
+        }
+        filled += take;
+        off += take;
+        n -= take;
+        if (filled == chunkSize) {
+          if (write(fd, chunk.data(), filled) != (ssize_t)filled) {
+            perror("write");
+            exit(1);
+          }
+          writes++;
+          filled = 0;
+        }
+      }
+    }
+    if (filled > 0) {
+      if (write(fd, chunk.data(), filled) != (ssize_t)filled) {
+        perror("write");
+        exit(1);
+      }
+      writes++;
+    }
+    if (doFsync) {
+      fsync(fd);
+    }
+    close(fd);
+  }
+  Result r;
+  r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  r.writes = writes;
+
+  for (int f = 0; f < frames; f++) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/IMG_%zu_%04d.jpg", dir.c_str(), chunkSize / 1024, f);
+    unlink(path);
+  }
+  return r;
+}
+
+int main(int argc, char** argv) {
+  std::string dir = "chunk_bench_out";
+  int frames = 200;
+  size_t frameSize = 60 * 1024;
+  bool doFsync = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--dir") { dir = value; i++; }
+    else if (arg == "--frames") { frames = atoi(value); i++; }
+    else if (arg == "--frame-kb") { frameSize = atoi(value) * 1024; i++; }
+    else if (arg == "--fsync") { doFsync = true; }
+    else {
+      fprintf(stderr, "usage: %s [--dir D] [--frames N] [--frame-kb K] [--fsync]\n", argv[0]);
+      return 2;
+    }
+  }
+  mkdir(dir.c_str(), 0755);
+
+  const size_t sizes[] = {1024, 4096, 8192, 16384, 32768};
+  printf("%d frames x %zu KB%s\n", frames, frameSize / 1024, doFsync ? ", fsync per frame" : "");
+  printf("chunk     MB/s   writes/frame  ms/frame\n");
+  for (size_t chunkSize : sizes) {
+    Result r = runChunkSize(dir, chunkSize, frames, frameSize, doFsync);
+    printf("%3zu KB  %7.1f  %12.1f  %8.3f\n", chunkSize / 1024,
+           frames * (double)frameSize / r.seconds / (1024.0 * 1024.0),
+           (double)r.writes / frames, r.seconds * 1000.0 / frames);
+  }
+  return 0;
+}
@@ -0,0 +1,368 @@
+// 协作式调度仿真（主机端，假时钟，与固件使用同一个coop_scheduler.h）
+// 第一部分检查调度器本身：按优先级运行、周期job的节奏、超预算计数、单轮预算的推迟（连续推迟不超过一轮）、
+// CPU占比合计不超过100%、跨任务请求清零统计，时钟起点放在micros()回绕之前。
+// 第二部分按固件接收任务的结构对比两种接收分段方式：旧做法每次最多处理16384字节，新做法处理到截止时刻。
+// 链路按速率和TCP分段大小产生数据（突发链路按固定间隔成批到达），socket最多缓存一个接收窗口；
+// 接收任务每隔一段时间被同核的WiFi任务占用一段时间，期间数据积压。每次read()有固定开销加每字节开销
+// （拥塞时read()开销变大，读的同时数据还在到达）。
+// 输出每种链路下两种做法每轮耗时的平均值和最坏值（loop延迟）、吞吐，以及统计job的实际间隔。
+// 检查：新做法每轮最坏耗时不超过 预算 + 一次read()的耗时，与链路无关；
+// 慢速突发链路上积压超过16KB且read()慢，旧做法一轮处理16KB超出预算，新做法的最坏耗时更低。
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 -Iinclude tools/coop_sched_sim.cpp -o coop_sched_sim
+//   ./coop_sched_sim --seconds 20 --budget-us 2000
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "coop_scheduler.h"
+
+#define READ_CHUNK_SIZE 4096       // 与固件MJPEG_READ_CHUNK_SIZE相同
+#define BYTE_CAP_PER_CALL 16384    // 旧做法每次调用处理的字节上限
+#define STATS_PERIOD_US 5000000    // 与固件流统计的周期相同
+#define IDLE_YIELD_US 1000         // 没有数据时vTaskDelay(1)
+#define SOCKET_WINDOW 11520        // socket缓存的默认上限（TCP接收窗口）
+#define STALL_EVERY_US 200000      // 每隔这么久接收任务被其他任务占用一次
+#define STALL_US 20000             // 每次被占用的时间
+
+struct Options {
+  uint32_t seconds = 20;
+  uint32_t budgetUs = 2000;
+};
+
+// 假时钟：从回绕前3秒开始
+static uint64_t fakeUs = 0;
+static const uint32_t CLOCK_START = 0xFFFFFFFFu - 3000000u;
+
+static uint32_t fakeClock() {
+  return CLOCK_START + (uint32_t)fakeUs;
+}
+
+static int failures = 0;
+
+static void check(bool ok, const char* what) {
+  if (!ok) {
+    printf("FAIL: %s\n", what);
+    failures++;
+  }
+}
+
+// ---------- 第一部分：调度器检查 ----------
+
+struct FixedJob {
+  uint32_t costUs;
+  uint32_t calls = 0;
+  uint32_t lastCallUs = 0;
+  uint32_t maxGapUs = 0;
+  int order = -1;          // 本轮被调用的顺序
+};
+
+static int callSeq = 0;
+
+static bool runFixed(void* ctx, uint32_t) {
+  FixedJob* job = (FixedJob*)ctx;
+  uint32_t now = fakeClock();
+  if (job->calls > 0 && now - job->lastCallUs > job->maxGapUs) {
+    job->maxGapUs = now - job->lastCallUs;
+  }
+  job->lastCallUs = now;
+  job->calls++;
+  job->order = callSeq++;
+  fakeUs += job->costUs;
+  return true;
+}
+
+static void checkScheduler() {
+  fakeUs = 0;
+  CoopScheduler sched(fakeClock);
+  FixedJob telemetry{300};
+  FixedJob ui{200};
+  FixedJob decode{1500};
+  FixedJob ingest{1800};
+
+  // 故意按与优先级相反的顺序添加
+  int telemetryId = sched.addJob("telemetry", 3, 500, 100000, runFixed, &telemetry);
+  int uiId = sched.addJob("ui", 2, 500, 0, runFixed, &ui);
+  int decodeId = sched.addJob("decode", 1, 2000, 0, runFixed, &decode);
+  int ingestId = sched.addJob("ingest", 0, 2000, 0, runFixed, &ingest);
+  check(sched.count() == 4, "job count");
+  check(sched.addJob("bad", 0, 0, 0, nullptr) == -1, "null job rejected");
+
+  // 第一轮：全部运行，顺序为ingest、decode、ui、telemetry
+  callSeq = 0;
+  sched.runOnce();
+  check(ingest.order == 0 && decode.order == 1 && ui.order == 2 && telemetry.order == 3,
+        "jobs run in priority order");
+  check(sched.job(telemetryId).runs == 1, "periodic job runs on first iteration");
+
+  // 运行4秒（跨过时钟回绕）：周期job每100ms一次，间隔不早于周期、不晚于周期+一轮
+  sched.resetStats();
+  uint32_t iterationUs = 1800 + 1500 + 200 + 300;
+  uint64_t until = fakeUs + 4000000;
+  while (fakeUs < until) {
+    sched.runOnce();
+  }
+  const CoopJob& tj = sched.job(telemetryId);
+  check(tj.runs >= 39 && tj.runs <= 41, "periodic job cadence");
+  check(telemetry.maxGapUs <= 100000 + iterationUs, "periodic job not late by more than one iteration");
+  check(sched.job(decodeId).overruns == 0 && sched.job(ingestId).overruns == 0, "no overrun within budget");
+  uint32_t shareSum = 0;
+  for (int i = 0; i < sched.count(); i++) {
+    shareSum += sched.sharePermille(i);
+  }
+  check(shareSum <= 1000 && shareSum >= 990, "shares sum to the busy time (no yield in this loop)");
+  check(sched.busyPermille() >= shareSum && sched.busyPermille() < shareSum + sched.count(),
+        "busy share matches per-job shares (rounding only)");
+  check(sched.iterations.maxUs <= iterationUs, "worst iteration equals the sum of job costs");
+  printf("scheduler: %u iterations, worst %u us, shares ingest %u decode %u ui %u telemetry %u permille\n",
+         (unsigned)sched.iterations.count, (unsigned)sched.iterations.maxUs,
+         (unsigned)sched.sharePermille(ingestId), (unsigned)sched.sharePermille(decodeId),
+         (unsigned)sched.sharePermille(uiId), (unsigned)sched.sharePermille(telemetryId));
+
+  // 超预算：ui一次耗时2ms
+  ui.costUs = 2000;
+  sched.runOnce();
+  check(sched.job(uiId).overruns == 1, "overrun counted");
+  ui.costUs = 200;
+
+  // 单轮预算3.5ms：ingest+decode之后剩余不够ui的预算，ui推迟到下一轮，下一轮必定运行
+  sched.setIterationBudget(3500);
+  sched.resetStats();
+  uint32_t uiCallsBefore = ui.calls;
+  for (int i = 0; i < 100; i++) {
+    sched.runOnce();
+  }
+  const CoopJob& uj = sched.job(uiId);
+  check(uj.deferred > 0, "job deferred by iteration budget");
+  check(uj.runs >= 50 && ui.calls - uiCallsBefore == uj.runs, "deferred job still runs every other iteration");
+  check(sched.job(ingestId).deferred == 0, "first job never deferred");
+  printf("iteration budget 3500 us: ui deferred %u, ran %u of 100 iterations, worst iteration %u us\n",
+         (unsigned)uj.deferred, (unsigned)uj.runs, (unsigned)sched.iterations.maxUs);
+  sched.setIterationBudget(0);
+
+  // 让出CPU的时间计入总时间，占比随之下降
+  sched.resetStats();
+  for (int i = 0; i < 100; i++) {
+    sched.runOnce();
+    fakeUs += iterationUs;
+  }
+  check(sched.busyPermille() >= 480 && sched.busyPermille() <= 520, "yield time lowers the share");
+
+  // 其他任务请求清零：下一轮开始时生效
+  sched.requestReset();
+  check(sched.iterations.count == 100, "reset deferred until next iteration");
+  sched.runOnce();
+  check(sched.iterations.count == 1, "reset applied by the owning task");
+  check(fakeUs > 3000000, "clock wrapped during the run");
+}
+
+// ---------- 第二部分：接收分段对比 ----------
+
+struct LinkProfile {
+  const char* name;
+  double bytesPerUs;    // 链路速率
+  uint32_t segment;     // 每个TCP分段的大小，read()最多读到已到达的分段
+  uint32_t readCallUs;  // 每次read()的固定开销
+  double byteNs;        // 每字节的拷贝和解析开销
+  uint32_t window;      // socket缓存的上限
+  uint32_t burstUs;     // 0：连续到达；否则每隔这么久一批到达（AP聚合、重传后一起交付）
+  bool slowBurst;       // 检查旧做法在这条链路上超出预算（预算小于处理16KB的时间时）
+};
+
+static const LinkProfile profiles[] = {
+  {"slow 0.2 MB/s", 0.2, 536, 40, 30.0, SOCKET_WINDOW, 0, false},
+  {"typical 1 MB/s", 1.0, 1436, 40, 30.0, SOCKET_WINDOW, 0, false},
+  {"fast 2.5 MB/s", 2.5, 1436, 40, 30.0, SOCKET_WINDOW, 0, false},
+  {"congested 1 MB/s", 1.0, 536, 400, 60.0, SOCKET_WINDOW, 0, false},
+  {"burst 4 MB/s", 4.0, 1436, 40, 30.0, SOCKET_WINDOW, 0, false},
+  {"slow bursty 0.5 MB/s", 0.5, 536, 600, 150.0, 32768, 50000, true},
+};
+
+// 模拟的socket：按时间到达的字节（缓存满时发送方停下），read()最多读到已完整到达的分段
+struct FakeSocket {
+  const LinkProfile* link;
+  uint64_t consumed = 0;
+  double arrived = 0;
+  uint64_t updatedUs = 0;
+
+  // 到时刻us为止链路交付的字节数（突发链路按批次取整）
+  double delivered(uint64_t us) const {
+    if (link->burstUs) {
+      us -= us % link->burstUs;
+    }
+    return us * link->bytesPerUs;
+  }
+
+  int available() {
+    arrived += delivered(fakeUs) - delivered(updatedUs);
+    updatedUs = fakeUs;
+    if (arrived > consumed + link->window) {
+      arrived = (double)(consumed + link->window);
+    }
+    uint64_t bytes = (uint64_t)arrived - consumed;
+    return (int)(bytes - bytes % link->segment);
+  }
+
+  int read(int maxBytes) {
+    int n = available();
+    if (n > maxBytes) {
+      n = maxBytes;
+    }
+    fakeUs += link->readCallUs + (uint64_t)(n * link->byteNs / 1000.0);
+    consumed += n;
+    return n;
+  }
+};
+
+struct IngestJob {
+  FakeSocket socket;
+  bool timeBounded;
+  uint32_t maxReadUs = 0;
+};
+
+static bool runIngest(void* ctx, uint32_t deadlineUs) {
+  IngestJob* job = (IngestJob*)ctx;
+  int processed = 0;
+  for (;;) {
+    if (job->timeBounded ? (int32_t)(fakeClock() - deadlineUs) >= 0 : processed >= BYTE_CAP_PER_CALL) {
+      break;
+    }
+    int available = job->socket.available();
+    if (available <= 0) {
+      break;
+    }
+    uint32_t start = fakeClock();
+    int n = job->socket.read(available < READ_CHUNK_SIZE ? available : READ_CHUNK_SIZE);
+    if (fakeClock() - start > job->maxReadUs) {
+      job->maxReadUs = fakeClock() - start;
+    }
+    processed += n;
+  }
+  return processed > 0;
+}
+
+struct StatsJob {
+  uint32_t lastUs = 0;
+  uint32_t calls = 0;
+  uint32_t maxGapUs = 0;
+};
+
+static bool runStats(void* ctx, uint32_t) {
+  StatsJob* job = (StatsJob*)ctx;
+  uint32_t now = fakeClock();
+  if (job->calls > 0 && now - job->lastUs > job->maxGapUs) {
+    job->maxGapUs = now - job->lastUs;
+  }
+  job->lastUs = now;
+  job->calls++;
+  fakeUs += 200;
+  return true;
+}
+
+struct IngestResult {
+  uint32_t avgUs;
+  uint32_t maxUs;       // 最坏一轮的耗时（loop延迟）
+  uint32_t maxReadUs;
+  double mbps;
+  uint32_t share;
+  uint32_t statsMaxGapUs;
+};
+
+static IngestResult runIngestCase(const Options& opt, const LinkProfile& link, bool timeBounded) {
+  fakeUs = 0;
+  CoopScheduler sched(fakeClock);
+  IngestJob ingest{{&link}, timeBounded};
+  StatsJob stats;
+  int ingestId = sched.addJob("ingest", 0, opt.budgetUs, 0, runIngest, &ingest);
+  sched.addJob("stream-stats", 1, 1000, STATS_PERIOD_US, runStats, &stats);
+
+  uint64_t until = (uint64_t)opt.seconds * 1000000;
+  uint64_t nextStall = STALL_EVERY_US;
+  while (fakeUs < until) {
+    if (!sched.runOnce()) {
+      fakeUs += IDLE_YIELD_US;
+    }
+    if (fakeUs >= nextStall) {
+      fakeUs += STALL_US;
+      nextStall += STALL_EVERY_US;
+    }
+  }
+
+  IngestResult r;
+  r.avgUs = sched.iterations.averageUs();
+  r.maxUs = sched.iterations.maxUs;
+  r.maxReadUs = ingest.maxReadUs;
+  r.mbps = ingest.socket.consumed / (double)fakeUs;
+  r.share = sched.sharePermille(ingestId);
+  r.statsMaxGapUs = stats.maxGapUs;
+  return r;
+}
+
+static bool parseArgs(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (arg == "--seconds") {
+      opt.seconds = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--budget-us") {
+      opt.budgetUs = (uint32_t)atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return opt.seconds > 0 && opt.budgetUs > 0;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    printf("usage: %s [--seconds N] [--budget-us N]\n", argv[0]);
+    return 2;
+  }
+
+  checkScheduler();
+
+  printf("\ningest for %u s, byte cap %d vs time budget %u us\n", (unsigned)opt.seconds,
+         BYTE_CAP_PER_CALL, (unsigned)opt.budgetUs);
+  printf("%-20s | %-36s | %-36s\n", "", "byte-bounded", "time-bounded");
+  printf("%-20s | %8s %8s %6s %10s | %8s %8s %6s %10s\n", "link", "avg us", "worst us", "MB/s", "ingest %",
+         "avg us", "worst us", "MB/s", "ingest %");
+  uint32_t byteMin = UINT32_MAX, byteMax = 0, timeMin = UINT32_MAX, timeMax = 0;
+  for (const LinkProfile& link : profiles) {
+    IngestResult b = runIngestCase(opt, link, false);
+    IngestResult t = runIngestCase(opt, link, true);
+    printf("%-20s | %8u %8u %6.2f %9u.%u | %8u %8u %6.2f %9u.%u\n", link.name,
+           (unsigned)b.avgUs, (unsigned)b.maxUs, b.mbps, (unsigned)(b.share / 10), (unsigned)(b.share % 10),
+           (unsigned)t.avgUs, (unsigned)t.maxUs, t.mbps, (unsigned)(t.share / 10), (unsigned)(t.share % 10));
+
+    // 新做法：最坏一轮不超过预算 + 一次read() + 统计job
+    check(t.maxUs <= opt.budgetUs + t.maxReadUs + 200, "time-bounded worst iteration within budget + one read");
+    // 按时间分段不降低吞吐
+    check(t.mbps >= b.mbps * 0.98, "time budget keeps the throughput");
+    check(t.statsMaxGapUs <= STATS_PERIOD_US + t.maxUs + IDLE_YIELD_US + STALL_US, "stats job cadence");
+    // 慢速突发链路上处理16KB要比预算加一次read()还久时：旧做法超出预算，新做法的最坏一轮更短
+    uint32_t readUs = link.readCallUs + (uint32_t)(READ_CHUNK_SIZE * link.byteNs / 1000.0);
+    uint32_t byteCapUs = BYTE_CAP_PER_CALL / READ_CHUNK_SIZE * readUs;
+    if (link.slowBurst && byteCapUs > opt.budgetUs + readUs) {
+      check(b.maxUs > opt.budgetUs + b.maxReadUs, "byte cap overruns the time budget on a slow bursty link");
+      check(t.maxUs < b.maxUs, "time budget cuts the worst iteration on a slow bursty link");
+    }
+
+    byteMin = b.maxUs < byteMin ? b.maxUs : byteMin;
+    byteMax = b.maxUs > byteMax ? b.maxUs : byteMax;
+    timeMin = t.maxUs < timeMin ? t.maxUs : timeMin;
+    timeMax = t.maxUs > timeMax ? t.maxUs : timeMax;
+  }
+  printf("worst iteration across links: byte-bounded %u..%u us, time-bounded %u..%u us\n",
+         (unsigned)byteMin, (unsigned)byteMax, (unsigned)timeMin, (unsigned)timeMax);
+
+  if (failures) {
+    printf("%d check(s) failed\n", failures);
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
@@ -0,0 +1,204 @@
+// 三缓冲帧池的生产者/消费者测试（主机端）：与固件使用同一个frame_pool.h，
+// 生产者线程按流解析器的方式直接写writeSlot()再publish()，消费者线程按解码任务的方式acquire()后读取。
+// 每帧写入时带自身的序号、长度和校验和，内容由序号生成：
+//   头部  [0..3]序号 [4..7]长度，与槽的seq/size比对
+//   数据  按序号生成的伪随机字节（逐字节写入，拉长写帧时间，增加与读取重叠的机会）
+//   尾部  最后4字节为数据的FNV-1a校验和
+// 消费者拿到帧时校验一次，模拟解码耗时后再校验一次（持有期间生产者不能改写这个槽），
+// 并检查序号单调递增（不会拿到旧帧）、最后一帧一定被取到（latest frame wins）、
+// 以及 发布数 = 取走数 + 被替换数。撕裂、乱序或计数不符即失败。
+// 输出每秒帧数、取走/替换比例和发布到取走的延迟。
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 -pthread -Iinclude tools/frame_pool_host.cpp -o frame_pool_host
+//   ./frame_pool_host --frames 200000 --slot-kb 8
+//   ./frame_pool_host --frames 2000 --slot-kb 70 --consumer-us 200
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frame_pool.h"
+#include "latency_stats.h"
+
+#define FRAME_HEADER 8
+#define FRAME_TRAILER 4
+
+struct Options {
+  uint32_t frames = 200000;
+  int slotKb = 8;
+  int producerUs = 0;   // 每帧写完后的额外耗时（模拟网络）
+  int consumerUs = 0;   // 两次校验之间的耗时（模拟解码）
+};
+
+static uint32_t micros() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void spinUs(int us) {
+  if (us <= 0) {
+    return;
+  }
+  uint32_t start = micros();
+  while (micros() - start < (uint32_t)us) {
+  }
+}
+
+static uint32_t fnv1a(const uint8_t* data, size_t n) {
+  uint32_t h = 2166136261u;
+  for (size_t i = 0; i < n; i++) {
+    h = (h ^ data[i]) * 16777619u;
+  }
+  return h;
+}
+
+static void put32(uint8_t* p, uint32_t v) {
+  memcpy(p, &v, 4);
+}
+
+static uint32_t get32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+// 帧长度随序号变化（最短头部+尾部+1字节，最长为整个槽）
+static size_t frameSize(uint32_t seq, size_t capacity) {
+  size_t minSize = FRAME_HEADER + FRAME_TRAILER + 1;
+  return minSize + (seq * 2654435761u) % (capacity - minSize + 1);
+}
+
+static void writeFrame(uint8_t* data, uint32_t seq, size_t size) {
+  put32(data, seq);
+  put32(data + 4, (uint32_t)size);
+  uint32_t x = seq * 2246822519u + 1;
+  for (size_t i = FRAME_HEADER; i < size - FRAME_TRAILER; i++) {
+    x = x * 1103515245u + 12345u;
+    data[i] = (uint8_t)(x >> 16);
+  }
+  put32(data + size - FRAME_TRAILER, fnv1a(data + FRAME_HEADER, size - FRAME_HEADER - FRAME_TRAILER));
+}
+
+// 帧内容与槽的seq/size一致且校验和正确
+static bool checkFrame(const FrameSlot& slot) {
+  if (slot.size < FRAME_HEADER + FRAME_TRAILER + 1) {
+    return false;
+  }
+  const uint8_t* data = slot.data;
+  if (get32(data) != slot.seq || get32(data + 4) != slot.size) {
+    return false;
+  }
+  uint32_t sum = fnv1a(data + FRAME_HEADER, slot.size - FRAME_HEADER - FRAME_TRAILER);
+  return get32(data + slot.size - FRAME_TRAILER) == sum;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--frames") { opt.frames = (uint32_t)atol(value); i++; }
+    else if (arg == "--slot-kb") { opt.slotKb = atoi(value); i++; }
+    else if (arg == "--producer-us") { opt.producerUs = atoi(value); i++; }
+    else if (arg == "--consumer-us") { opt.consumerUs = atoi(value); i++; }
+    else {
+      fprintf(stderr, "usage: %s [--frames N] [--slot-kb K] [--producer-us US] [--consumer-us US]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (opt.frames == 0 || opt.slotKb < 1) {
+    fprintf(stderr, "--frames and --slot-kb must be positive\n");
+    return 2;
+  }
+
+  size_t capacity = (size_t)opt.slotKb * 1024;
+  std::vector<uint8_t> storage(FramePool::SLOT_COUNT * capacity);
+  FramePool pool;
+  pool.init(storage.data(), capacity);
+
+  // 校验本身能发现改写：改一个字节后必须不通过
+  {
+    FrameSlot& slot = pool.writeSlot();
+    slot.seq = 1;
+    slot.size = frameSize(1, capacity);
+    writeFrame(slot.data, slot.seq, slot.size);
+    bool intact = checkFrame(slot);
+    slot.data[slot.size / 2] ^= 0x01;
+    if (!intact || checkFrame(slot)) {
+      printf("FAILED: frame check does not detect a modified byte\n");
+      return 1;
+    }
+  }
+
+  std::atomic<bool> producerDone{false};
+  uint32_t published = 0;
+  uint32_t replaced = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  std::thread producer([&]() {
+    FrameSlot* slot = &pool.writeSlot();
+    for (uint32_t seq = 1; seq <= opt.frames; seq++) {
+      size_t size = frameSize(seq, capacity);
+      writeFrame(slot->data, seq, size);
+      spinUs(opt.producerUs);
+      slot = &pool.publish(size, micros());
+    }
+    published = pool.framesPublished;
+    replaced = pool.framesReplaced;
+    producerDone.store(true, std::memory_order_release);
+  });
+
+  uint32_t torn = 0;           // 取到时内容与seq/size不符
+  uint32_t tornWhileHeld = 0;  // 取到时完整，持有期间被改写
+  uint32_t outOfOrder = 0;     // 序号不大于上一帧
+  uint32_t lastSeq = 0;
+  LatencyStats latency;
+  for (;;) {
+    // 先读完成标志再取帧：标志置位后的这次acquire能看到最后一帧
+    bool done = producerDone.load(std::memory_order_acquire);
+    const FrameSlot* slot = pool.acquire();
+    if (slot == nullptr) {
+      if (done) {
+        break;
+      }
+      std::this_thread::yield();
+      continue;
+    }
+    latency.add(micros() - slot->stampUs);
+    if (slot->seq <= lastSeq) {
+      outOfOrder++;
+    }
+    lastSeq = slot->seq;
+    if (!checkFrame(*slot)) {
+      torn++;
+      continue;
+    }
+    spinUs(opt.consumerUs);
+    if (!checkFrame(*slot)) {
+      tornWhileHeld++;
+    }
+  }
+  producer.join();
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  uint32_t consumed = pool.framesConsumed;
+  printf("%u frames of up to %d KB in %.2f s (%.0f frames/s), producer %d us, consumer %d us\n", published,
+         opt.slotKb, seconds, published / seconds, opt.producerUs, opt.consumerUs);
+  printf("consumed %u (%.1f%%), replaced %u, last seq %u\n", consumed, consumed * 100.0 / published, replaced,
+         lastSeq);
+  printf("publish-to-acquire latency avg %u us, max %u us\n", latency.averageUs(), latency.maxUs);
+  printf("torn %u, torn while held %u, out of order %u\n", torn, tornWhileHeld, outOfOrder);
+
+  bool ok = torn == 0 && tornWhileHeld == 0 && outOfOrder == 0;
+  ok &= published == opt.frames && lastSeq == opt.frames;
+  ok &= consumed + replaced == published;
+  if (!ok) {
+    printf("FAILED\n");
+  }
+  return ok ? 0 : 1;
+}
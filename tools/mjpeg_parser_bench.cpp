@@ -0,0 +1,328 @@
+// MJPEG分块解析器基准（主机端）：原来processMjpegStream的逐字节循环与MjpegParser（memchr批量找0xFF）对比
+// 合成的流按相机的方式排列：multipart头 + JPEG（含DQT/DHT/SOS等段标记、0xFF 0x00填充和RST标记）。
+// 逐字节循环每次处理2048字节（原MAX_BYTES_PER_CALL），MjpegParser按不同的读取块大小喂数据，
+// 帧写进轮换的两个槽，输出MB/s、帧/秒和每字节耗时，第一遍逐帧与原始JPEG比对。
+// 另外用1~64字节的随机块再喂一遍，检查跨块的0xFF待定状态（FF落在块末、D8/D9在下一块开头）。
+// 也可以用--record读取录下的流，以逐字节循环的结果为基准比对
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 -Iinclude tools/mjpeg_parser_bench.cpp -o mjpeg_parser_bench
+//   ./mjpeg_parser_bench --frames 300 --min-kb 8 --max-kb 40
+//   curl -s --max-time 10 http://127.0.0.1:8080/api/v1/stream > stream.bin
+//   ./mjpeg_parser_bench --record stream.bin
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "mjpeg_parser.h"
+
+#define SLOT_CAPACITY (70 * 1024)  // 与固件GLOBAL_MAX_JPEG_SIZE相同
+#define BYTEWISE_PER_CALL 2048     // 原processMjpegStream的MAX_BYTES_PER_CALL
+#define BOUNDARY "123456789000000000000987654321"
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Options {
+  int frames = 300;
+  int minKb = 8;
+  int maxKb = 40;
+  double minSeconds = 0.3;   // 每种组合至少计时这么久
+  std::string record;
+};
+
+static uint32_t nextRandom(uint32_t& seed) {
+  seed = seed * 1103515245u + 12345u;
+  return seed >> 8;
+}
+
+// 合成的JPEG：SOI + 几个带长度的段（段内有0xFF标记）+ 熵编码数据（0xFF后跟0x00，每4KB一个RST）+ EOI
+static Bytes makeJpeg(size_t size, uint32_t& seed) {
+  static const uint8_t segments[] = {0xDB, 0xC0, 0xC4, 0xC4, 0xDA};
+  Bytes jpeg;
+  jpeg.reserve(size + 64);
+  jpeg.push_back(0xFF);
+  jpeg.push_back(0xD8);
+  for (uint8_t marker : segments) {
+    size_t len = 16 + nextRandom(seed) % 48;
+    jpeg.push_back(0xFF);
+    jpeg.push_back(marker);
+    jpeg.push_back((uint8_t)(len >> 8));
+    jpeg.push_back((uint8_t)len);
+    for (size_t i = 2; i < len; i++) {
+      jpeg.push_back((uint8_t)(nextRandom(seed) & 0x7F));
+    }
+  }
+  uint8_t rst = 0;
+  size_t nextRst = jpeg.size() + 4096;
+  while (jpeg.size() < size - 2) {
+    uint8_t b = (uint8_t)nextRandom(seed);
+    jpeg.push_back(b);
+    if (b == 0xFF) {
+      jpeg.push_back(0x00);
+    }
+    if (jpeg.size() >= nextRst) {
+      jpeg.push_back(0xFF);
+      jpeg.push_back(0xD0 + (rst++ & 7));
+      nextRst += 4096;
+    }
+  }
+  jpeg.push_back(0xFF);
+  jpeg.push_back(0xD9);
+  return jpeg;
+}
+
+static Bytes buildStream(const std::vector<Bytes>& jpegs) {
+  Bytes out;
+  for (const Bytes& jpeg : jpegs) {
+    char header[200];
+    int len = snprintf(header, sizeof(header), "\r\n--" BOUNDARY "\r\nContent-Type: image/jpeg\r\n"
+                       "Content-Length: %zu\r\nX-Timestamp: 1700000000.000000\r\n\r\n", jpeg.size());
+    out.insert(out.end(), header, header + len);
+    out.insert(out.end(), jpeg.begin(), jpeg.end());
+  }
+  return out;
+}
+
+// 原processMjpegStream的逐字节循环（去掉WiFiClient，每个字节一次判断和写入）
+class BytewiseParser {
+public:
+  void reset() {
+    index = 0;
+    inFrame = false;
+    lastByte = 0;
+    ready = false;
+  }
+
+  void setBuffer(uint8_t* buffer, size_t capacity) {
+    frameBuffer = buffer;
+    frameCapacity = capacity;
+  }
+
+  // 最多处理BYTEWISE_PER_CALL字节，帧完成时立即返回
+  size_t feed(const uint8_t* data, size_t len) {
+    size_t processed = 0;
+    while (processed < len && processed < BYTEWISE_PER_CALL) {
+      uint8_t b = data[processed++];
+      if (lastByte == 0xFF && b == 0xD8) {
+        index = 0;
+        frameBuffer[index++] = 0xFF;
+        frameBuffer[index++] = 0xD8;
+        inFrame = true;
+      } else if (inFrame) {
+        frameBuffer[index++] = b;
+        if (index >= frameCapacity) {
+          index = 0;
+          inFrame = false;
+          lastByte = 0;
+          continue;
+        }
+        if (lastByte == 0xFF && b == 0xD9) {
+          inFrame = false;
+          ready = true;
+          lastByte = b;
+          return processed;
+        }
+      }
+      lastByte = b;
+    }
+    return processed;
+  }
+
+  bool frameReady() const {
+    return ready;
+  }
+
+  uint8_t* frameData() const {
+    return frameBuffer;
+  }
+
+  size_t frameSize() const {
+    return index;
+  }
+
+  void consumeFrame() {
+    ready = false;
+    index = 0;
+  }
+
+private:
+  uint8_t* frameBuffer = nullptr;
+  size_t frameCapacity = 0;
+  size_t index = 0;
+  bool inFrame = false;
+  uint8_t lastByte = 0;
+  bool ready = false;
+};
+
+struct RunResult {
+  double mbPerSec = 0;
+  double framesPerSec = 0;
+  double nsPerByte = 0;
+  uint32_t frames = 0;
+  uint32_t matched = 0;  // 与期望帧逐字节相同
+};
+
+// 按固件的方式喂数据：每次读最多readSize字节，帧就绪就取走并切换槽。
+// readSize为0时用1~64字节的随机块（只跑一遍，检查跨块状态）
+// collect非空时保存第一遍的每一帧（--record时作为其他解析器的基准）
+template <typename Parser>
+static RunResult run(Parser& parser, const Bytes& stream, size_t readSize, const std::vector<Bytes>* expect,
+                     std::vector<Bytes>* collect, double minSeconds) {
+  static uint8_t slots[2][SLOT_CAPACITY];
+  RunResult r;
+  uint64_t bytes = 0;
+  uint64_t frames = 0;
+  double seconds = 0;
+  int passes = 0;
+  uint32_t seed = 7;
+  while (passes == 0 || (readSize && seconds < minSeconds)) {
+    bool check = passes == 0;
+    int slot = 0;
+    parser.reset();
+    parser.setBuffer(slots[slot], SLOT_CAPACITY);
+    uint32_t count = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos < stream.size();) {
+      size_t want = readSize ? readSize : 1 + nextRandom(seed) % 64;
+      size_t n = stream.size() - pos < want ? stream.size() - pos : want;
+      const uint8_t* chunk = stream.data() + pos;
+      size_t offset = 0;
+      while (offset < n) {
+        offset += parser.feed(chunk + offset, n - offset);
+        if (parser.frameReady()) {
+          if (check) {
+            const uint8_t* f = parser.frameData();
+            size_t size = parser.frameSize();
+            if (expect && count < expect->size() && (*expect)[count].size() == size &&
+                memcmp((*expect)[count].data(), f, size) == 0) {
+              r.matched++;
+            }
+            if (collect) {
+              collect->push_back(Bytes(f, f + size));
+            }
+          }
+          count++;
+          parser.consumeFrame();
+          slot ^= 1;
+          parser.setBuffer(slots[slot], SLOT_CAPACITY);
+        }
+      }
+      pos += n;
+    }
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bytes += stream.size();
+    frames += count;
+    if (check) {
+      r.frames = count;
+    }
+    passes++;
+  }
+  r.mbPerSec = bytes / seconds / 1e6;
+  r.framesPerSec = frames / seconds;
+  r.nsPerByte = seconds * 1e9 / bytes;
+  return r;
+}
+
+static void printRow(const char* name, const RunResult& r, size_t expected, const RunResult* baseline) {
+  printf("%-16s %8.1f MB/s %9.0f frames/s %7.3f ns/B  frames %4u/%zu  intact %4u", name, r.mbPerSec,
+         r.framesPerSec, r.nsPerByte, r.frames, expected, r.matched);
+  if (baseline) {
+    printf("  x%.1f", r.mbPerSec / baseline->mbPerSec);
+  }
+  printf("\n");
+}
+
+// 逐字节循环作为基准，MjpegParser按各种读取块大小跑一遍；所有帧都必须与期望相同
+static bool runAll(const Bytes& stream, std::vector<Bytes>& expect, bool collectBaseline, double minSeconds) {
+  static const size_t readSizes[] = {512, 1436, 4096, 16384};
+  bool ok = true;
+
+  BytewiseParser bytewise;
+  RunResult base = run(bytewise, stream, BYTEWISE_PER_CALL, collectBaseline ? nullptr : &expect,
+                       collectBaseline ? &expect : nullptr, minSeconds);
+  if (collectBaseline) {
+    base.matched = base.frames;
+  }
+  printRow("bytewise", base, expect.size(), nullptr);
+  ok &= base.frames == expect.size() && base.matched == expect.size();
+
+  for (size_t readSize : readSizes) {
+    MjpegParser parser;
+    RunResult r = run(parser, stream, readSize, &expect, nullptr, minSeconds);
+    char name[32];
+    snprintf(name, sizeof(name), "scan %zu B", readSize);
+    printRow(name, r, expect.size(), &base);
+    ok &= r.frames == expect.size() && r.matched == expect.size();
+  }
+
+  MjpegParser parser;
+  RunResult split = run(parser, stream, 0, &expect, nullptr, minSeconds);
+  printf("%-16s frames %4u/%zu  intact %4u\n", "scan 1-64 B", split.frames, expect.size(), split.matched);
+  ok &= split.frames == expect.size() && split.matched == expect.size();
+  return ok;
+}
+
+static bool runRecord(const Options& opt) {
+  FILE* f = fopen(opt.record.c_str(), "rb");
+  if (!f) {
+    perror(opt.record.c_str());
+    return false;
+  }
+  Bytes stream;
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    stream.insert(stream.end(), buf, buf + n);
+  }
+  fclose(f);
+  printf("%s: %zu bytes\n", opt.record.c_str(), stream.size());
+
+  std::vector<Bytes> reference;
+  bool ok = runAll(stream, reference, true, opt.minSeconds);
+  return ok && !reference.empty();
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--frames") { opt.frames = atoi(value); i++; }
+    else if (arg == "--min-kb") { opt.minKb = atoi(value); i++; }
+    else if (arg == "--max-kb") { opt.maxKb = atoi(value); i++; }
+    else if (arg == "--seconds") { opt.minSeconds = atof(value); i++; }
+    else if (arg == "--record") { opt.record = value; i++; }
+    else {
+      fprintf(stderr, "usage: %s [--frames N] [--min-kb K] [--max-kb K] [--seconds S]\n"
+                      "       %s --record FILE [--seconds S]\n", argv[0], argv[0]);
+      return 2;
+    }
+  }
+
+  bool ok;
+  if (!opt.record.empty()) {
+    ok = runRecord(opt);
+  } else {
+    if (opt.frames <= 0 || opt.minKb < 1 || opt.maxKb < opt.minKb || opt.maxKb * 1024 >= SLOT_CAPACITY) {
+      fprintf(stderr, "frame sizes must be 1..%d KB\n", SLOT_CAPACITY / 1024 - 1);
+      return 2;
+    }
+    uint32_t seed = 1;
+    std::vector<Bytes> jpegs;
+    for (int i = 0; i < opt.frames; i++) {
+      size_t kb = opt.minKb + nextRandom(seed) % (opt.maxKb - opt.minKb + 1);
+      jpegs.push_back(makeJpeg(kb * 1024, seed));
+    }
+    Bytes stream = buildStream(jpegs);
+    printf("%d frames of %d-%d KB, %zu bytes\n", opt.frames, opt.minKb, opt.maxKb, stream.size());
+    ok = runAll(stream, jpegs, false, opt.minSeconds);
+  }
+  if (!ok) {
+    printf("FAILED\n");
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,396 @@
+#!/usr/bin/env python3
+"""UnitCamS3 模拟服务器（仅依赖Python标准库）
+
+在电脑上模拟相机的HTTP接口，用于在没有硬件的情况下测试串流/拍照/参数控制的性能：
+  /api/v1/stream   multipart/x-mixed-replace MJPEG流（与相机一样使用chunked传输）
+  /api/v1/capture  单张JPEG
+  /api/v1/control  ?var=<name>&val=<value> 参数设置
+  /api/v1/status   JSON格式的当前参数
+
+帧来源：--frames 指定的目录中的*.jpg（按文件名顺序循环播放），
+未指定时按当前framesize生成纯色灰度JPEG（每帧亮度不同，可正常解码），
+并用COM段填充到 --frame-bytes（按320x240折算，随分辨率等比例放大）。
+
+串流卡住注入：--stall-every 秒数 让每个串流连接每隔这么久停发一次（连接保持），
+--stall-ms 为停发的时间（0表示一直停到客户端断开，模拟相机切换分辨率后串流静默），
+--refuse-ms 为停发之后新的串流请求返回503的时间（用于测试客户端的重连退避）。
+
+串流中切换framesize：--switch-delay-ms 为控制命令返回后仍按旧分辨率出帧的时间，
+--switch-stall 让切换时已经打开的串流连接停发（直到客户端断开），模拟相机不支持在线切换。
+
+链路带宽：--bandwidth-kbps 限制每个串流连接的发送速率（相机来不及发完时帧率自然下降），
+运行中可用模拟服务器专用的控制参数 /api/v1/control?var=bandwidth_kbps&val=<kbps> 修改（0为不限）；
+--quality-bytes 为quality每高一档合成帧增大的百分比（默认0，帧大小与quality无关）。
+
+示例：
+  python3 tools/mock_unitcam.py --port 8080 --fps 25 --jitter-ms 5 --control-latency-ms 30
+  python3 tools/mock_unitcam.py --port 8080 --stall-every 5 --stall-ms 0 --refuse-ms 300
+  python3 tools/mock_unitcam.py --port 8080 --switch-delay-ms 80
+  python3 tools/mock_unitcam.py --port 8080 --bandwidth-kbps 1500 --quality-bytes 50
+"""
+
+import argparse
+import glob
+import json
+import os
+import random
+import select
+import struct
+import threading
+import time
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+from urllib.parse import parse_qs, urlparse
+
+BOUNDARY = "123456789000000000000987654321"
+
+# esp32-camera framesize编号对应的分辨率
+FRAME_SIZES = {
+    0: (96, 96), 1: (160, 120), 2: (128, 128), 3: (176, 144), 4: (240, 176),
+    5: (240, 240), 6: (320, 240), 7: (320, 320), 8: (400, 296), 9: (480, 320),
+    10: (640, 480), 11: (800, 600), 12: (1024, 768), 13: (1280, 720),
+    14: (1280, 1024), 15: (1600, 1200),
+}
+
+
+def _segment(marker, payload):
+    return b"\xff" + bytes([marker]) + struct.pack(">H", len(payload) + 2) + payload
+
+
+def make_gray_jpeg(width, height, level, pad_bytes=0):
+    """生成纯色灰度基线JPEG：所有块只有DC分量，AC直接EOB"""
+    out = bytearray(b"\xff\xd8")
+    out += _segment(0xDB, b"\x00" + b"\x01" * 64)
+    out += _segment(0xC0, struct.pack(">BHHB", 8, height, width, 1) + b"\x01\x11\x00")
+    # DC表：12个长度为4的码字，对应类别0..11
+    out += _segment(0xC4, b"\x00" + bytes([0, 0, 0, 12] + [0] * 12) + bytes(range(12)))
+    # AC表：只有EOB(0x00)，码字为"0"
+    out += _segment(0xC4, b"\x10" + bytes([1] + [0] * 15) + b"\x00")
+
+    # 填充COM段，模拟真实帧大小
+    while pad_bytes > 0:
+        n = min(pad_bytes, 65533)
+        out += _segment(0xFE, b"\x00" * n)
+        pad_bytes -= n + 4
+
+    out += _segment(0xDA, b"\x01\x01\x00\x00\x3f\x00")
+
+    bits = []
+
+    def put(value, length):
+        for i in range(length - 1, -1, -1):
+            bits.append((value >> i) & 1)
+
+    dc = (level - 128) * 8
+    category = abs(dc).bit_length()
+    blocks = ((width + 7) // 8) * ((height + 7) // 8)
+    put(category, 4)
+    if category:
+        put(dc if dc > 0 else dc + (1 << category) - 1, category)
+    put(0, 1)
+    for _ in range(blocks - 1):
+        put(0, 4)
+        put(0, 1)
+    while len(bits) % 8:
+        bits.append(1)
+
+    for i in range(0, len(bits), 8):
+        byte = 0
+        for b in bits[i:i + 8]:
+            byte = (byte << 1) | b
+        out.append(byte)
+        if byte == 0xFF:
+            out.append(0x00)
+
+    out += b"\xff\xd9"
+    return bytes(out)
+
+
+class Camera:
+    """相机状态与帧源（多个请求线程共享）"""
+
+    def __init__(self, args):
+        self.args = args
+        self.lock = threading.Lock()
+        self.status = {
+            "framesize": 6, "quality": 0, "brightness": 0, "contrast": 0,
+            "saturation": 0, "sharpness": 0, "special_effect": 0,
+        }
+        self.files = sorted(glob.glob(os.path.join(args.frames, "*.jpg"))) if args.frames else []
+        self.frame_index = 0
+        self.stale_frame = None
+        self.refuse_until = 0.0
+        self.stream_framesize = self.status["framesize"]  # 串流当前出帧的分辨率
+        self.switch_at = 0.0                               # 到这个时刻才按新framesize出帧
+        self.switch_generation = 0                         # framesize每变化一次加一
+        self.bandwidth_kbps = args.bandwidth_kbps          # 串流连接的发送速率上限，0为不限
+        self.stats = {"stream_frames": 0, "stream_bytes": 0, "captures": 0, "controls": 0,
+                      "stalls": 0, "refused": 0}
+
+    def set_framesize(self, value):
+        with self.lock:
+            if value != self.status["framesize"]:
+                self.switch_generation += 1
+                self.switch_at = time.monotonic() + self.args.switch_delay_ms / 1000.0
+            self.status["framesize"] = value
+
+    def next_frame(self):
+        with self.lock:
+            self.frame_index += 1
+            index = self.frame_index
+            if time.monotonic() >= self.switch_at:
+                self.stream_framesize = self.status["framesize"]
+            framesize = self.stream_framesize
+            quality = self.status["quality"]
+
+        if self.files:
+            with open(self.files[index % len(self.files)], "rb") as f:
+                return f.read()
+
+        width, height = FRAME_SIZES.get(framesize, (320, 240))
+        pad = self.args.frame_bytes * width * height // (320 * 240)
+        pad = pad * (100 + self.args.quality_bytes * quality) // 100
+        return make_gray_jpeg(width, height, 16 + (index * 7) % 224, pad)
+
+    def capture_frame(self):
+        frame = self.next_frame()
+        if not self.args.stale_capture:
+            return frame
+        # 模拟相机帧缓冲：返回上一次请求时拍到的旧帧
+        with self.lock:
+            previous, self.stale_frame = self.stale_frame, frame
+        return previous or frame
+
+    def count(self, key, n=1):
+        with self.lock:
+            self.stats[key] += n
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    camera = None
+
+    def log_message(self, fmt, *args):
+        if self.camera.args.verbose:
+            super().log_message(fmt, *args)
+
+    def _send_chunk(self, data):
+        self._throttle(len(data))
+        self.wfile.write(b"%x\r\n" % len(data) + data + b"\r\n")
+
+    def _throttle(self, nbytes):
+        """按--bandwidth-kbps限速：发送前等到链路空闲"""
+        with self.camera.lock:
+            kbps = self.camera.bandwidth_kbps
+        if kbps <= 0:
+            self.link_free_at = 0.0
+            return
+        now = time.monotonic()
+        start = max(now, getattr(self, "link_free_at", 0.0))
+        self.link_free_at = start + nbytes * 8 / (kbps * 1000.0)
+        if start > now:
+            time.sleep(start - now)
+
+    def _write_paced(self, data):
+        """按--write-size分段写入socket，模拟网络分片"""
+        args = self.camera.args
+        step = args.write_size or len(data)
+        if self.camera.bandwidth_kbps > 0:
+            step = min(step, 4096)  # 限速时分小段发送，速率更平滑
+        for i in range(0, len(data), step):
+            self._send_chunk(data[i:i + step])
+            self.wfile.flush()
+            if args.write_delay_ms:
+                time.sleep(args.write_delay_ms / 1000.0)
+
+    def do_GET(self):
+        url = urlparse(self.path)
+        routes = {
+            "/api/v1/stream": self.handle_stream,
+            "/api/v1/capture": self.handle_capture,
+            "/api/v1/control": self.handle_control,
+            "/api/v1/status": self.handle_status,
+        }
+        handler = routes.get(url.path)
+        if handler is None:
+            self.send_error(404)
+            return
+        handler(parse_qs(url.query))
+
+    def _stall(self, stall_ms):
+        """停发数据：stall_ms为0时一直等到客户端断开"""
+        args = self.camera.args
+        self.camera.count("stalls")
+        end = time.monotonic() + stall_ms / 1000.0
+        alive = True
+        while stall_ms <= 0 or time.monotonic() < end:
+            readable, _, _ = select.select([self.connection], [], [], 0.01)
+            if readable and not self.connection.recv(1024):
+                alive = False
+                break
+        # 停发结束（或客户端断开）后一段时间内拒绝新的串流请求
+        with self.camera.lock:
+            self.camera.refuse_until = time.monotonic() + args.refuse_ms / 1000.0
+        return alive
+
+    def handle_stream(self, query):
+        args = self.camera.args
+        with self.camera.lock:
+            refused = time.monotonic() < self.camera.refuse_until
+        if refused:
+            self.camera.count("refused")
+            self.send_error(503)
+            return
+        self.send_response(200)
+        self.send_header("Content-Type", "multipart/x-mixed-replace;boundary=" + BOUNDARY)
+        self.send_header("Access-Control-Allow-Origin", "*")
+        self.send_header("Connection", "close")
+        self.send_header("Transfer-Encoding", "chunked")
+        self.end_headers()
+
+        interval = 1.0 / args.fps
+        next_time = time.monotonic()
+        next_stall = next_time + args.stall_every if args.stall_every > 0 else None
+        with self.camera.lock:
+            generation = self.camera.switch_generation
+        try:
+            while True:
+                if args.switch_stall:
+                    with self.camera.lock:
+                        switched = self.camera.switch_generation != generation
+                    if switched:
+                        self._stall(0)
+                        break
+                if next_stall is not None and time.monotonic() >= next_stall:
+                    if not self._stall(args.stall_ms):
+                        break
+                    next_time = time.monotonic()
+                    next_stall = next_time + args.stall_every
+                frame = self.camera.next_frame()
+                header = ("\r\n--%s\r\nContent-Type: image/jpeg\r\nContent-Length: %d\r\n"
+                          "X-Timestamp: %.6f\r\n\r\n" % (BOUNDARY, len(frame), time.time()))
+                self._send_chunk(header.encode())
+                self._write_paced(frame)
+                self.camera.count("stream_frames")
+                self.camera.count("stream_bytes", len(frame))
+
+                next_time += interval + random.uniform(-args.jitter_ms, args.jitter_ms) / 1000.0
+                delay = next_time - time.monotonic()
+                if delay > 0:
+                    time.sleep(delay)
+                else:
+                    next_time = time.monotonic()
+        except (BrokenPipeError, ConnectionResetError):
+            pass
+        self.close_connection = True
+
+    def handle_capture(self, query):
+        time.sleep(self.camera.args.capture_latency_ms / 1000.0)
+        frame = self.camera.capture_frame()
+        self.send_response(200)
+        self.send_header("Content-Type", "image/jpeg")
+        self.send_header("Content-Length", str(len(frame)))
+        self.end_headers()
+        self.wfile.write(frame)
+        self.camera.count("captures")
+
+    def handle_control(self, query):
+        time.sleep(self.camera.args.control_latency_ms / 1000.0)
+        name = query.get("var", [""])[0]
+        value = query.get("val", [""])[0]
+        try:
+            value = int(value)
+        except ValueError:
+            self.send_error(400)
+            return
+        if name == "framesize":
+            self.camera.set_framesize(value)
+        elif name == "bandwidth_kbps":
+            with self.camera.lock:
+                self.camera.bandwidth_kbps = value
+        else:
+            with self.camera.lock:
+                self.camera.status[name] = value
+        self.camera.count("controls")
+        self.send_response(200)
+        self.send_header("Content-Length", "0")
+        self.end_headers()
+
+    def handle_status(self, query):
+        with self.camera.lock:
+            body = json.dumps(self.camera.status, separators=(",", ":")).encode()
+        self.send_response(200)
+        self.send_header("Content-Type", "application/json")
+        self.send_header("Content-Length", str(len(body)))
+        self.end_headers()
+        self.wfile.write(body)
+
+
+def report_loop(camera, period):
+    """定期输出服务端统计"""
+    last = dict(camera.stats)
+    while True:
+        time.sleep(period)
+        with camera.lock:
+            now = dict(camera.stats)
+        print("[mock] stream %.1f fps, %.1f KB/s, captures %d, controls %d, stalls %d, refused %d" % (
+            (now["stream_frames"] - last["stream_frames"]) / period,
+            (now["stream_bytes"] - last["stream_bytes"]) / period / 1024.0,
+            now["captures"] - last["captures"],
+            now["controls"] - last["controls"],
+            now["stalls"] - last["stalls"],
+            now["refused"] - last["refused"]), flush=True)
+        last = now
+
+
+def main():
+    parser = argparse.ArgumentParser(description="UnitCamS3 mock HTTP server")
+    parser.add_argument("--host", default="0.0.0.0")
+    parser.add_argument("--port", type=int, default=8080)
+    parser.add_argument("--frames", help="directory of *.jpg frames to replay")
+    parser.add_argument("--frame-bytes", type=int, default=12000,
+                        help="synthetic frame size at 320x240 (scaled by resolution)")
+    parser.add_argument("--fps", type=float, default=25.0)
+    parser.add_argument("--jitter-ms", type=float, default=0.0)
+    parser.add_argument("--write-size", type=int, default=0,
+                        help="split each frame into socket writes of this size (0 = whole frame)")
+    parser.add_argument("--write-delay-ms", type=float, default=0.0,
+                        help="delay between split writes")
+    parser.add_argument("--control-latency-ms", type=float, default=0.0)
+    parser.add_argument("--capture-latency-ms", type=float, default=0.0)
+    parser.add_argument("--stale-capture", action="store_true",
+                        help="capture returns the frame grabbed by the previous request")
+    parser.add_argument("--stall-every", type=float, default=0.0,
+                        help="stop sending on each stream connection every N seconds (0 = never)")
+    parser.add_argument("--stall-ms", type=float, default=0.0,
+                        help="length of an injected stall (0 = until the client disconnects)")
+    parser.add_argument("--refuse-ms", type=float, default=0.0,
+                        help="answer new stream requests with 503 for this long after a stall")
+    parser.add_argument("--switch-delay-ms", type=float, default=0.0,
+                        help="keep streaming the old framesize this long after a framesize change")
+    parser.add_argument("--switch-stall", action="store_true",
+                        help="open streams stop sending after a framesize change")
+    parser.add_argument("--bandwidth-kbps", type=int, default=0,
+                        help="limit each stream connection to this rate (0 = unlimited)")
+    parser.add_argument("--quality-bytes", type=int, default=0,
+                        help="grow synthetic frames by this percentage per quality step")
+    parser.add_argument("--report", type=float, default=5.0, help="stats period in seconds")
+    parser.add_argument("--verbose", action="store_true")
+    args = parser.parse_args()
+
+    camera = Camera(args)
+    Handler.camera = camera
+    server = ThreadingHTTPServer((args.host, args.port), Handler)
+    server.daemon_threads = True
+
+    if args.report > 0:
+        threading.Thread(target=report_loop, args=(camera, args.report), daemon=True).start()
+
+    print("[mock] UnitCamS3 mock listening on %s:%d" % (args.host, args.port), flush=True)
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,280 @@
+// MJPEG流解析对比（主机端）：MjpegParser（逐块找FF D8/FF D9）与MultipartMjpegReader（按part的Content-Length读取）
+// 按固件的方式每次喂4KB，帧写进轮换的两个槽，统计吞吐和每字节耗时，并逐帧与原始JPEG比对。
+// 合成的流有四种：
+//   plain        multipart + Content-Length，不分块
+//   chunked      Transfer-Encoding: chunked，每帧一个分块（esp_http_server的发送方式）
+//   chunked-split 每帧按TCP分段大小拆成多个分块（mock_unitcam.py --write-size），分块长度行落在JPEG中间
+//   no-length    part没有Content-Length，读取器退回标记扫描
+// 也可以用--record读取录下的流（curl -i --raw，含响应头时自动取boundary和分块方式）
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 -Iinclude tools/multipart_bench.cpp -o multipart_bench
+//   ./multipart_bench --frames 300 --min-kb 10 --max-kb 60
+//   curl -s -i --raw --max-time 10 http://127.0.0.1:8080/api/v1/stream > stream.bin
+//   ./multipart_bench --record stream.bin
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "mjpeg_parser.h"
+#include "multipart_reader.h"
+
+#define READ_CHUNK 4096            // 与固件MJPEG_READ_CHUNK_SIZE相同
+#define SLOT_CAPACITY (70 * 1024)  // 与固件GLOBAL_MAX_JPEG_SIZE相同
+#define TCP_SEGMENT 1436
+#define BOUNDARY "123456789000000000000987654321"
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Options {
+  int frames = 300;
+  int minKb = 10;
+  int maxKb = 60;
+  double minSeconds = 0.3;   // 每种组合至少计时这么久
+  std::string record;
+  std::string boundary;      // --record且文件不含响应头时使用
+  bool chunked = false;
+};
+
+// 合成的JPEG：SOI + 熵编码数据（0xFF后跟0x00填充，与真实JPEG相同）+ EOI
+static Bytes makeJpeg(size_t size, uint32_t& seed) {
+  Bytes jpeg;
+  jpeg.reserve(size);
+  jpeg.push_back(0xFF);
+  jpeg.push_back(0xD8);
+  while (jpeg.size() < size - 2) {
+    seed = seed * 1103515245u + 12345u;
+    uint8_t b = (uint8_t)(seed >> 16);
+    jpeg.push_back(b);
+    if (b == 0xFF) {
+      jpeg.push_back(0x00);
+    }
+  }
+  jpeg.push_back(0xFF);
+  jpeg.push_back(0xD9);
+  return jpeg;
+}
+
+static void appendChunk(Bytes& out, const uint8_t* data, size_t n, bool chunked) {
+  if (chunked) {
+    char line[16];
+    int len = snprintf(line, sizeof(line), "%zx\r\n", n);
+    out.insert(out.end(), line, line + len);
+  }
+  out.insert(out.end(), data, data + n);
+  if (chunked) {
+    out.push_back('\r');
+    out.push_back('\n');
+  }
+}
+
+static Bytes buildStream(const std::vector<Bytes>& jpegs, bool chunked, size_t split, bool withLength) {
+  Bytes out;
+  for (const Bytes& jpeg : jpegs) {
+    char header[200];
+    int len = withLength
+        ? snprintf(header, sizeof(header), "\r\n--" BOUNDARY "\r\nContent-Type: image/jpeg\r\n"
+                   "Content-Length: %zu\r\nX-Timestamp: 1700000000.000000\r\n\r\n", jpeg.size())
+        : snprintf(header, sizeof(header), "\r\n--" BOUNDARY "\r\nContent-Type: image/jpeg\r\n"
+                   "X-Timestamp: 1700000000.000000\r\n\r\n");
+    appendChunk(out, (const uint8_t*)header, len, chunked);
+    size_t step = split ? split : jpeg.size();
+    for (size_t off = 0; off < jpeg.size(); off += step) {
+      appendChunk(out, jpeg.data() + off, jpeg.size() - off < step ? jpeg.size() - off : step, chunked);
+    }
+  }
+  return out;
+}
+
+struct RunResult {
+  double nsPerByte = 0;
+  double mbPerSec = 0;
+  uint32_t frames = 0;
+  uint32_t matched = 0;     // 与原始JPEG逐字节相同
+  uint32_t valid = 0;       // 以SOI开头、EOI结尾（--record时没有原始帧可比）
+  uint32_t byLength = 0;
+};
+
+// 按固件processMjpegStream的方式喂数据：每次最多READ_CHUNK字节，帧就绪就发布并切换槽
+template <typename Parser>
+static RunResult run(Parser& parser, const Bytes& stream, const std::vector<Bytes>* expect, double minSeconds) {
+  static uint8_t slots[2][SLOT_CAPACITY];
+  RunResult r;
+  uint64_t bytes = 0;
+  double seconds = 0;
+  int passes = 0;
+  while (seconds < minSeconds || passes == 0) {
+    bool check = passes == 0;
+    int slot = 0;
+    parser.reset();
+    parser.setBuffer(slots[slot], SLOT_CAPACITY);
+    uint32_t frames = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t pos = 0; pos < stream.size();) {
+      size_t n = stream.size() - pos < READ_CHUNK ? stream.size() - pos : READ_CHUNK;
+      const uint8_t* chunk = stream.data() + pos;
+      size_t offset = 0;
+      while (offset < n) {
+        offset += parser.feed(chunk + offset, n - offset);
+        if (parser.frameReady()) {
+          if (check) {
+            const uint8_t* f = parser.frameData();
+            size_t size = parser.frameSize();
+            if (expect && frames < expect->size() && (*expect)[frames].size() == size &&
+                memcmp((*expect)[frames].data(), f, size) == 0) {
+              r.matched++;
+            }
+            if (size >= 4 && f[0] == 0xFF && f[1] == 0xD8 && f[size - 2] == 0xFF && f[size - 1] == 0xD9) {
+              r.valid++;
+            }
+          }
+          frames++;
+          parser.consumeFrame();
+          slot ^= 1;
+          parser.setBuffer(slots[slot], SLOT_CAPACITY);
+        }
+      }
+      pos += n;
+    }
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    bytes += stream.size();
+    if (check) {
+      r.frames = frames;
+    }
+    passes++;
+  }
+  r.nsPerByte = seconds * 1e9 / bytes;
+  r.mbPerSec = bytes / seconds / 1e6;
+  return r;
+}
+
+static RunResult runReader(const Bytes& stream, const std::vector<Bytes>* expect, const char* contentType,
+                           bool chunked, double minSeconds) {
+  MultipartMjpegReader reader;
+  reader.begin(contentType, chunked);
+  uint32_t before = reader.framesByLength;
+  RunResult r = run(reader, stream, expect, minSeconds);
+  int passes = r.frames ? (reader.framesByLength - before) / r.frames : 0;
+  r.byLength = passes ? (reader.framesByLength - before) / passes : 0;
+  return r;
+}
+
+static void printRow(const char* name, const char* parser, const RunResult& r, size_t expected) {
+  printf("%-14s %-10s %8.1f MB/s %7.3f ns/B  frames %4u/%zu  intact %4u  by-length %4u\n", name, parser,
+         r.mbPerSec, r.nsPerByte, r.frames, expected, r.matched, r.byLength);
+}
+
+static bool runRecord(const Options& opt) {
+  FILE* f = fopen(opt.record.c_str(), "rb");
+  if (!f) {
+    perror(opt.record.c_str());
+    return false;
+  }
+  Bytes stream;
+  uint8_t buf[65536];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+    stream.insert(stream.end(), buf, buf + n);
+  }
+  fclose(f);
+
+  // curl -i：取出响应头里的Content-Type和Transfer-Encoding
+  std::string contentType = opt.boundary.empty() ? "" : "multipart/x-mixed-replace;boundary=" + opt.boundary;
+  bool chunked = opt.chunked;
+  if (stream.size() > 5 && memcmp(stream.data(), "HTTP/", 5) == 0) {
+    std::string text(stream.begin(), stream.begin() + (stream.size() < 4096 ? stream.size() : 4096));
+    size_t end = text.find("\r\n\r\n");
+    if (end != std::string::npos) {
+      std::string head = text.substr(0, end);
+      for (char& c : head) {
+        c = (c >= 'A' && c <= 'Z') ? c + 32 : c;
+      }
+      size_t ct = head.find("\ncontent-type:");
+      if (ct != std::string::npos) {
+        size_t eol = text.find("\r\n", ct + 1);
+        size_t value = text.find_first_not_of(' ', ct + 14);
+        contentType = text.substr(value, eol - value);
+      }
+      chunked = head.find("\ntransfer-encoding: chunked") != std::string::npos;
+      stream.erase(stream.begin(), stream.begin() + end + 4);
+    }
+  }
+  printf("%s: %zu bytes, Content-Type '%s', chunked %d\n", opt.record.c_str(), stream.size(),
+         contentType.c_str(), chunked);
+
+  MjpegParser parser;
+  RunResult scan = run(parser, stream, nullptr, opt.minSeconds);
+  RunResult reader = runReader(stream, nullptr, contentType.c_str(), chunked, opt.minSeconds);
+  printf("%-14s %-10s %8.1f MB/s %7.3f ns/B  frames %4u  valid %4u\n", "record", "scan",
+         scan.mbPerSec, scan.nsPerByte, scan.frames, scan.valid);
+  printf("%-14s %-10s %8.1f MB/s %7.3f ns/B  frames %4u  valid %4u  by-length %4u\n", "record", "multipart",
+         reader.mbPerSec, reader.nsPerByte, reader.frames, reader.valid, reader.byLength);
+  return reader.valid == reader.frames && reader.frames >= scan.valid;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--frames") { opt.frames = atoi(value); i++; }
+    else if (arg == "--min-kb") { opt.minKb = atoi(value); i++; }
+    else if (arg == "--max-kb") { opt.maxKb = atoi(value); i++; }
+    else if (arg == "--seconds") { opt.minSeconds = atof(value); i++; }
+    else if (arg == "--record") { opt.record = value; i++; }
+    else if (arg == "--boundary") { opt.boundary = value; i++; }
+    else if (arg == "--chunked") { opt.chunked = true; }
+    else {
+      fprintf(stderr, "usage: %s [--frames N] [--min-kb K] [--max-kb K] [--seconds S]\n"
+                      "       %s --record FILE [--boundary B] [--chunked]\n", argv[0], argv[0]);
+      return 2;
+    }
+  }
+
+  if (!opt.record.empty()) {
+    return runRecord(opt) ? 0 : 1;
+  }
+
+  uint32_t seed = 1;
+  std::vector<Bytes> jpegs;
+  for (int i = 0; i < opt.frames; i++) {
+    seed = seed * 1103515245u + 12345u;
+    size_t kb = opt.minKb + (seed >> 8) % (opt.maxKb - opt.minKb + 1);
+    jpegs.push_back(makeJpeg(kb * 1024, seed));
+  }
+
+  struct Case {
+    const char* name;
+    bool chunked;
+    size_t split;
+    bool withLength;
+  } cases[] = {
+    {"plain", false, 0, true},
+    {"chunked", true, 0, true},
+    {"chunked-split", true, TCP_SEGMENT, true},
+    {"no-length", false, 0, false},
+  };
+
+  const char* contentType = "multipart/x-mixed-replace;boundary=" BOUNDARY;
+  bool ok = true;
+  printf("%d frames of %d-%d KB, %d-byte reads\n", opt.frames, opt.minKb, opt.maxKb, READ_CHUNK);
+  for (const Case& c : cases) {
+    Bytes stream = buildStream(jpegs, c.chunked, c.split, c.withLength);
+    MjpegParser parser;
+    RunResult scan = run(parser, stream, &jpegs, opt.minSeconds);
+    RunResult reader = runReader(stream, &jpegs, contentType, c.chunked, opt.minSeconds);
+    printRow(c.name, "scan", scan, jpegs.size());
+    printRow(c.name, "multipart", reader, jpegs.size());
+    // 读取器必须逐字节还原每一帧；有长度时全部按长度读取
+    ok &= reader.frames == jpegs.size() && reader.matched == jpegs.size();
+    ok &= c.withLength ? reader.byLength == jpegs.size() : reader.byLength == 0;
+  }
+  if (!ok) {
+    printf("FAILED\n");
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,394 @@
+// 双核流水线的Linux版本：与固件使用同一套stream_pipeline.h/frame_pool.h/coop_scheduler.h/multipart_reader.h，
+// 接收线程和解码线程按固件streamIngestTask/frameDecodeTask的结构运行各自的调度器，UI线程周期性地暂停流水线（拍照）。
+// 合成的MJPEG源按--fps把帧放进"socket"（整帧一次到达，--fps 0为不限速），接收job每次读4KB，
+// 每次read()耗时--read-us，读到截止时刻为止，完整帧直接写进帧池的写槽后发布；解码job取最新一帧，耗时--decode-us。
+// --serial为原来loop()的做法作为对照：同一个线程每轮最多读2048字节，读到完整帧就地解码。
+// 输出显示帧率、接收吞吐、发布到显示完成的延迟、源帧到达到显示完成的端到端延迟（限速时）、
+// 暂停请求到两个工作者都停驻的延迟，以及各调度器的每轮最坏耗时。
+// 检查：显示的每一帧与源帧长度和首尾标记一致、序号递增；暂停期间没有帧被发布或显示；没有帧溢出或part错乱。
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 -pthread -Iinclude tools/pipeline_host.cpp -o pipeline_host
+//   ./pipeline_host --seconds 5 --fps 30 --frame-kb 20 --decode-us 25000
+//   ./pipeline_host --seconds 5 --fps 30 --frame-kb 20 --decode-us 25000 --serial
+//   ./pipeline_host --seconds 5 --fps 0 --decode-us 5000
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include "coop_scheduler.h"
+#include "frame_pool.h"
+#include "latency_stats.h"
+#include "multipart_reader.h"
+#include "stream_pipeline.h"
+
+#define READ_CHUNK_SIZE 4096        // 与固件MJPEG_READ_CHUNK_SIZE相同
+#define SERIAL_BYTES_PER_CALL 2048  // 原processMjpegStream的MAX_BYTES_PER_CALL
+#define FRAME_CAPACITY (70 * 1024)  // 与固件GLOBAL_MAX_JPEG_SIZE相同
+#define INGEST_BUDGET_US 2000       // 与固件STREAM_INGEST_BUDGET_US相同
+#define DECODE_BUDGET_US 30000      // 与固件DECODE_BUDGET_US相同
+#define SOURCE_FRAMES 64            // 合成源循环使用的不同帧数
+#define BOUNDARY "123456789000000000000987654321"
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Options {
+  double seconds = 5;
+  uint32_t fps = 30;         // 0：不限速
+  int frameKb = 20;
+  int readUs = 20;           // 每次read()的耗时
+  int decodeUs = 25000;      // 解码+绘制一帧的耗时
+  int pauseEveryMs = 1000;   // 0：不暂停
+  int pauseMs = 100;         // 每次暂停保持的时间（拍照）
+  bool serial = false;
+};
+
+static uint32_t micros() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<microseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+static void spinUs(int us) {
+  uint32_t start = micros();
+  while (micros() - start < (uint32_t)us) {
+  }
+}
+
+static uint32_t nextRandom(uint32_t& seed) {
+  seed = seed * 1103515245u + 12345u;
+  return seed >> 8;
+}
+
+// 合成的JPEG：SOI + 熵编码数据（0xFF后跟0x00填充）+ EOI
+static Bytes makeJpeg(size_t size, uint32_t& seed) {
+  Bytes jpeg;
+  jpeg.reserve(size);
+  jpeg.push_back(0xFF);
+  jpeg.push_back(0xD8);
+  while (jpeg.size() < size - 2) {
+    uint8_t b = (uint8_t)nextRandom(seed);
+    jpeg.push_back(b);
+    if (b == 0xFF) {
+      jpeg.push_back(0x00);
+    }
+  }
+  jpeg.push_back(0xFF);
+  jpeg.push_back(0xD9);
+  return jpeg;
+}
+
+// 合成的MJPEG源：SOURCE_FRAMES个帧组成的multipart流循环发送，第k帧在 start + k * 帧间隔 整帧到达
+class SyntheticSource {
+public:
+  void begin(int frameKb, uint32_t fps, uint32_t nowUs) {
+    uint32_t seed = 1;
+    for (int i = 0; i < SOURCE_FRAMES; i++) {
+      size_t size = (size_t)frameKb * 1024 * (75 + nextRandom(seed) % 51) / 100;
+      Bytes jpeg = makeJpeg(size, seed);
+      char header[200];
+      int len = snprintf(header, sizeof(header), "\r\n--" BOUNDARY "\r\nContent-Type: image/jpeg\r\n"
+                         "Content-Length: %zu\r\n\r\n", jpeg.size());
+      cycle.insert(cycle.end(), header, header + len);
+      cycle.insert(cycle.end(), jpeg.begin(), jpeg.end());
+      frameEnd.push_back(cycle.size());
+      jpegSize.push_back(jpeg.size());
+    }
+    intervalUs = fps ? 1000000 / fps : 0;
+    startUs = nowUs;
+  }
+
+  // 第k帧（从0开始）到达的时刻
+  uint32_t arrivalUs(uint64_t k) const {
+    return startUs + (uint32_t)(k * intervalUs);
+  }
+
+  // 读取已到达的数据，最多max字节；没有数据时返回0
+  size_t read(uint8_t* buf, size_t max, uint32_t nowUs) {
+    uint64_t available = releasedBytes(nowUs);
+    if (pos >= available) {
+      return 0;
+    }
+    size_t offset = (size_t)(pos % cycle.size());
+    size_t n = max;
+    if (n > available - pos) {
+      n = (size_t)(available - pos);
+    }
+    if (n > cycle.size() - offset) {
+      n = cycle.size() - offset;
+    }
+    memcpy(buf, cycle.data() + offset, n);
+    pos += n;
+    return n;
+  }
+
+  size_t expectedSize(uint64_t k) const {
+    return jpegSize[k % SOURCE_FRAMES];
+  }
+
+  uint64_t framesReleased(uint32_t nowUs) const {
+    return intervalUs ? (uint64_t)(nowUs - startUs) / intervalUs + 1 : UINT64_MAX;
+  }
+
+  uint64_t bytesRead() const {
+    return pos;
+  }
+
+private:
+  uint64_t releasedBytes(uint32_t nowUs) const {
+    uint64_t frames = framesReleased(nowUs);
+    if (frames == UINT64_MAX) {
+      return UINT64_MAX;
+    }
+    uint64_t last = frames - 1;
+    return (last / SOURCE_FRAMES) * cycle.size() + frameEnd[last % SOURCE_FRAMES];
+  }
+
+  Bytes cycle;
+  std::vector<size_t> frameEnd;
+  std::vector<size_t> jpegSize;
+  uint32_t intervalUs = 0;
+  uint32_t startUs = 0;
+  uint64_t pos = 0;
+};
+
+static Options opt;
+static SyntheticSource source;
+static MultipartMjpegReader reader;
+static FramePool framePool;
+static PipelineGate pipelineGate;
+static CoopScheduler ingestScheduler(micros);
+static CoopScheduler decodeScheduler(micros);
+static std::atomic<bool> stopping{false};
+
+// 解码端统计（只由解码线程写，结束后读）
+static LatencyStats displayLatency;   // 发布到显示完成
+static LatencyStats endToEnd;         // 源帧到达到显示完成（限速时）
+static uint32_t framesShown = 0;
+static uint32_t framesCorrupt = 0;
+static uint32_t lastShownSeq = 0;
+
+// 读一块数据喂给读取器，完整帧直接在写槽里发布；返回读到的字节数
+static size_t ingestChunk(size_t maxBytes) {
+  static uint8_t chunk[READ_CHUNK_SIZE];
+  size_t n = source.read(chunk, maxBytes < sizeof(chunk) ? maxBytes : sizeof(chunk), micros());
+  if (n == 0) {
+    return 0;
+  }
+  spinUs(opt.readUs);
+  size_t offset = 0;
+  while (offset < n) {
+    offset += reader.feed(chunk + offset, n - offset);
+    if (reader.frameReady()) {
+      FrameSlot& next = framePool.publish(reader.frameSize(), micros());
+      reader.consumeFrame();
+      reader.setBuffer(next.data, framePool.slotCapacity());
+    }
+  }
+  return n;
+}
+
+// 模拟解码并检查帧内容（seq从1开始，与源帧一一对应）
+static void showFrame(const FrameSlot* frame) {
+  spinUs(opt.decodeUs);
+  uint32_t now = micros();
+  framesShown++;
+  displayLatency.add(now - frame->stampUs);
+  if (opt.fps) {
+    endToEnd.add(now - source.arrivalUs(frame->seq - 1));
+  }
+  const uint8_t* d = frame->data;
+  size_t size = frame->size;
+  if (size != source.expectedSize(frame->seq - 1) || size < 4 || d[0] != 0xFF || d[1] != 0xD8 ||
+      d[size - 2] != 0xFF || d[size - 1] != 0xD9 || frame->seq <= lastShownSeq) {
+    framesCorrupt++;
+  }
+  lastShownSeq = frame->seq;
+}
+
+// 接收job：读取直到截止时刻（与固件serviceStream相同的分段方式）
+static bool streamIngestJob(void*, uint32_t deadlineUs) {
+  bool worked = false;
+  while ((int32_t)(deadlineUs - micros()) > 0 && ingestChunk(READ_CHUNK_SIZE) > 0) {
+    worked = true;
+  }
+  return worked;
+}
+
+// 解码job：显示最新一帧，没有新帧时返回false
+static bool frameDecodeJob(void*, uint32_t) {
+  const FrameSlot* frame = framePool.acquire();
+  if (frame == nullptr) {
+    return false;
+  }
+  showFrame(frame);
+  return true;
+}
+
+static void streamIngestTask() {
+  while (!stopping.load()) {
+    if (!pipelineGate.enter(PIPELINE_WORKER_INGEST)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+    if (!ingestScheduler.runOnce()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+static void frameDecodeTask() {
+  while (!stopping.load()) {
+    if (!pipelineGate.enter(PIPELINE_WORKER_DECODE)) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+      continue;
+    }
+    // 固件等待ulTaskNotifyTake（发布时通知），这里短暂休眠代替
+    if (!decodeScheduler.runOnce()) {
+      std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+  }
+}
+
+// 原来的loop()：每轮最多读SERIAL_BYTES_PER_CALL字节，读到完整帧就地解码
+static void serialLoop() {
+  uint32_t nextPause = micros() + opt.pauseEveryMs * 1000u;
+  while (!stopping.load()) {
+    bool worked = false;
+    size_t processed = 0;
+    while (processed < SERIAL_BYTES_PER_CALL) {
+      size_t n = ingestChunk(SERIAL_BYTES_PER_CALL - processed);
+      if (n == 0) {
+        break;
+      }
+      processed += n;
+      worked = true;
+    }
+    const FrameSlot* frame = framePool.acquire();
+    if (frame) {
+      showFrame(frame);
+      worked = true;
+    }
+    // 拍照在同一个loop里执行，期间不读流
+    if (opt.pauseEveryMs && (int32_t)(micros() - nextPause) >= 0) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(opt.pauseMs));
+      nextPause = micros() + opt.pauseEveryMs * 1000u;
+    }
+    if (!worked) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
+}
+
+static void printScheduler(const char* name, const CoopScheduler& sched) {
+  uint32_t busy = sched.busyPermille();
+  printf("  %-7s busy %u.%u%%, iteration avg %u us, worst %u us, over budget %u\n", name,
+         (unsigned)(busy / 10), (unsigned)(busy % 10), (unsigned)sched.iterations.averageUs(),
+         (unsigned)sched.iterations.maxUs, (unsigned)sched.job(0).overruns);
+}
+
+int main(int argc, char** argv) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--seconds") { opt.seconds = atof(value); i++; }
+    else if (arg == "--fps") { opt.fps = (uint32_t)atoi(value); i++; }
+    else if (arg == "--frame-kb") { opt.frameKb = atoi(value); i++; }
+    else if (arg == "--read-us") { opt.readUs = atoi(value); i++; }
+    else if (arg == "--decode-us") { opt.decodeUs = atoi(value); i++; }
+    else if (arg == "--pause-every-ms") { opt.pauseEveryMs = atoi(value); i++; }
+    else if (arg == "--pause-ms") { opt.pauseMs = atoi(value); i++; }
+    else if (arg == "--serial") { opt.serial = true; }
+    else {
+      fprintf(stderr, "usage: %s [--seconds S] [--fps N] [--frame-kb K] [--read-us US] [--decode-us US]\n"
+                      "       [--pause-every-ms MS] [--pause-ms MS] [--serial]\n", argv[0]);
+      return 2;
+    }
+  }
+  if (opt.frameKb < 1 || opt.frameKb * 1024 * 5 / 4 >= FRAME_CAPACITY) {
+    fprintf(stderr, "--frame-kb must be 1..%d\n", FRAME_CAPACITY * 4 / 5 / 1024 - 1);
+    return 2;
+  }
+
+  static uint8_t storage[FramePool::SLOT_COUNT * FRAME_CAPACITY];
+  framePool.init(storage, FRAME_CAPACITY);
+  reader.begin("multipart/x-mixed-replace;boundary=" BOUNDARY, false);
+  reader.setBuffer(framePool.writeSlot().data, framePool.slotCapacity());
+  ingestScheduler.addJob("ingest", 0, INGEST_BUDGET_US, 0, streamIngestJob);
+  decodeScheduler.addJob("decode", 0, DECODE_BUDGET_US, 0, frameDecodeJob);
+
+  LatencyStats pauseAck;       // 暂停请求到两个工作者都停驻
+  uint32_t workWhilePaused = 0;
+  uint32_t start = micros();
+  source.begin(opt.frameKb, opt.fps, start);
+
+  if (opt.serial) {
+    std::thread loop(serialLoop);
+    std::this_thread::sleep_for(std::chrono::duration<double>(opt.seconds));
+    stopping.store(true);
+    loop.join();
+  } else {
+    std::thread ingest(streamIngestTask);
+    std::thread decode(frameDecodeTask);
+    // UI线程：按固件pausePipeline()/resumePipeline()周期性地暂停，检查暂停期间没有工作
+    uint32_t end = start + (uint32_t)(opt.seconds * 1e6);
+    while ((int32_t)(end - micros()) > 0) {
+      uint32_t wait = opt.pauseEveryMs ? opt.pauseEveryMs * 1000u : end - micros();
+      std::this_thread::sleep_for(std::chrono::microseconds(wait));
+      if (!opt.pauseEveryMs || (int32_t)(end - micros()) <= 0) {
+        continue;
+      }
+      uint32_t requested = micros();
+      pipelineGate.requestPause();
+      while (!pipelineGate.isPaused(PIPELINE_WORKERS_ALL)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      pauseAck.add(micros() - requested);
+      uint32_t published = framePool.framesPublished;
+      uint32_t consumed = framePool.framesConsumed;
+      std::this_thread::sleep_for(std::chrono::milliseconds(opt.pauseMs));
+      if (framePool.framesPublished != published || framePool.framesConsumed != consumed) {
+        workWhilePaused++;
+      }
+      pipelineGate.resume();
+    }
+    stopping.store(true);
+    ingest.join();
+    decode.join();
+  }
+  double seconds = (micros() - start) / 1e6;
+
+  // 限速时源在运行期间放出的帧数；最后一帧应当被显示（两帧间隔内）
+  uint32_t released = opt.fps ? (uint32_t)source.framesReleased(micros()) : framePool.framesPublished;
+  printf("%s, %u fps source, %d KB frames, read %d us, decode %d us, pause %d ms every %d ms\n",
+         opt.serial ? "serial loop" : "pipeline", (unsigned)opt.fps, opt.frameKb, opt.readUs, opt.decodeUs,
+         opt.pauseMs, opt.pauseEveryMs);
+  printf("  source  %u frames, parsed %u, shown %u (%.1f fps), replaced before shown %u\n", released,
+         (unsigned)framePool.framesPublished, framesShown, framesShown / seconds,
+         (unsigned)framePool.framesReplaced);
+  printf("  ingest  %.2f MB/s\n", source.bytesRead() / seconds / 1e6);
+  printf("  latency publish-to-shown avg %u us, max %u us", displayLatency.averageUs(), displayLatency.maxUs);
+  if (opt.fps) {
+    printf("; arrival-to-shown avg %u us, max %u us", endToEnd.averageUs(), endToEnd.maxUs);
+  }
+  printf("\n");
+  if (!opt.serial) {
+    printf("  pause   %u, ack avg %u us, max %u us, work while paused %u\n", pauseAck.count,
+           pauseAck.averageUs(), pauseAck.maxUs, workWhilePaused);
+    printScheduler("ingest", ingestScheduler);
+    printScheduler("decode", decodeScheduler);
+  }
+  printf("  corrupt %u, overflowed %u, malformed %u\n", framesCorrupt, (unsigned)reader.framesOverflowed,
+         (unsigned)reader.partsMalformed);
+
+  bool ok = framesShown > 0 && framesCorrupt == 0 && workWhilePaused == 0;
+  ok &= reader.framesOverflowed == 0 && reader.partsMalformed == 0;
+  if (!ok) {
+    printf("FAILED\n");
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,404 @@
+// 预览码率自适应的Linux版本：与固件使用同一套preview_bitrate.h，连接相机（tools/mock_unitcam.py）读取MJPEG流，
+// 每秒把帧数、字节数、解码耗时和RSSI交给控制器，档位变化时与固件一样发出framesize和quality命令。
+// --schedule 按"起始秒:带宽kbps[:RSSI]"分段，通过模拟服务器的bandwidth_kbps参数改变链路带宽；
+// 解码耗时按像素数折算（--decode-ns-per-px），RSSI按分段给定。--fixed 为原来的做法（固定6档、quality 0）作为对照。
+// 输出每段的平均帧率、所在档位和调档次数。
+// 检查（未指定--fixed时）：每段后半段至少75%的窗口停在同一档（收敛、不振荡），
+// 且帧率达到目标的85%（已在最低档、链路实在不够时除外）。
+//
+// 编译与运行：
+//   python3 tools/mock_unitcam.py --port 8080 --quality-bytes 50 &
+//   g++ -std=c++17 -O2 -Iinclude tools/preview_bitrate_host.cpp -o preview_bitrate_host
+//   ./preview_bitrate_host --host 127.0.0.1 --port 8080
+//   ./preview_bitrate_host --host 127.0.0.1 --port 8080 --fixed
+//   ./preview_bitrate_host --host 127.0.0.1 --port 8080 --schedule 0:6000:-55,30:1500:-55 --seconds 60
+
+#include <chrono>
+#include <errno.h>
+#include <netdb.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "jpeg_utils.h"
+#include "multipart_reader.h"
+#include "preview_bitrate.h"
+
+#define READ_CHUNK_SIZE 4096        // 与固件MJPEG_READ_CHUNK_SIZE相同
+#define FRAME_CAPACITY (70 * 1024)  // 与固件GLOBAL_MAX_JPEG_SIZE相同
+#define WINDOW_MS 1000              // 与固件PREVIEW_ADAPT_PERIOD_US相同
+
+// 与固件previewLadder相同
+static const PreviewLevel ladder[] = {
+  {3, 0},  // 176x144
+  {4, 0},  // 240x176
+  {6, 0},  // 320x240（原来固定的预览设置）
+  {6, 1},
+  {6, 2},
+};
+static const int LADDER_COUNT = sizeof(ladder) / sizeof(ladder[0]);
+static const int LADDER_START = 2;
+
+static uint32_t millis() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Phase {
+  uint32_t startSec;
+  int kbps;
+  int rssi;
+};
+
+struct Options {
+  std::string host = "192.168.4.1";
+  int port = 80;
+  uint32_t seconds = 120;
+  uint32_t targetFps = 20;
+  uint32_t decodeNsPerPx = 150;
+  bool fixed = false;
+  std::vector<Phase> schedule = {{0, 6000, -55}, {30, 1500, -70}, {60, 800, -78}, {90, 6000, -55}};
+};
+
+// 每段的统计（后半段单独统计，用于判断收敛）
+struct PhaseResult {
+  uint32_t windows = 0;
+  uint32_t frames = 0;
+  uint32_t changes = 0;
+  uint32_t lastChangeSec = 0;  // 段内最后一次调档距段开始的时间
+  uint32_t tailWindows = 0;
+  uint32_t tailFrames = 0;
+  uint32_t tailAtLevel[PREVIEW_MAX_LEVELS] = {0};
+};
+
+// 连接到相机，返回socket（阻塞），失败返回-1
+static int connectCamera(const Options& opt) {
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  if (getaddrinfo(opt.host.c_str(), std::to_string(opt.port).c_str(), &hints, &res) != 0) {
+    return -1;
+  }
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+    freeaddrinfo(res);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+// 发送控制命令，返回状态码，出错返回-1
+static int sendControl(const Options& opt, const char* var, int value) {
+  int fd = connectCamera(opt);
+  if (fd < 0) {
+    return -1;
+  }
+  std::string req = "GET /api/v1/control?var=" + std::string(var) + "&val=" + std::to_string(value) +
+                    " HTTP/1.1\r\nHost: " + opt.host + "\r\nConnection: close\r\n\r\n";
+  send(fd, req.data(), req.size(), 0);
+  char head[256];
+  ssize_t n = recv(fd, head, sizeof(head) - 1, 0);
+  close(fd);
+  if (n <= 0) {
+    return -1;
+  }
+  head[n] = '\0';
+  int status = -1;
+  sscanf(head, "HTTP/1.%*d %d", &status);
+  return status;
+}
+
+// 连接并发送串流请求，读完响应头；返回socket（读超时100ms），失败返回-1
+static int openStream(const Options& opt, std::string& contentType, bool& chunked) {
+  int fd = connectCamera(opt);
+  if (fd < 0) {
+    return -1;
+  }
+  timeval tv = {0, 100000};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::string req = "GET /api/v1/stream HTTP/1.1\r\nHost: " + opt.host +
+                    "\r\nUser-Agent: M5Cardputer\r\nConnection: keep-alive\r\n\r\n";
+  send(fd, req.data(), req.size(), 0);
+
+  std::string head;
+  char c;
+  while (head.size() < 4096 && recv(fd, &c, 1, 0) == 1) {
+    head += c;
+    if (head.size() >= 4 && head.compare(head.size() - 4, 4, "\r\n\r\n") == 0) {
+      break;
+    }
+  }
+  int status = -1;
+  sscanf(head.c_str(), "HTTP/1.%*d %d", &status);
+  if (status != 200) {
+    close(fd);
+    return -1;
+  }
+
+  contentType.clear();
+  chunked = false;
+  size_t pos = 0;
+  while (pos < head.size()) {
+    size_t end = head.find("\r\n", pos);
+    if (end == std::string::npos) {
+      break;
+    }
+    std::string line = head.substr(pos, end - pos);
+    pos = end + 2;
+    if (strncasecmp(line.c_str(), "Content-Type:", 13) == 0) {
+      size_t v = line.find_first_not_of(' ', 13);
+      contentType = v == std::string::npos ? "" : line.substr(v);
+    } else if (strncasecmp(line.c_str(), "Transfer-Encoding:", 18) == 0) {
+      chunked = line.find("chunked") != std::string::npos;
+    }
+  }
+  return fd;
+}
+
+// 与固件applyPreviewLevel相同：先发framesize再发quality，串流保持连接
+static void applyLevel(const Options& opt, const PreviewLevel& level) {
+  if (sendControl(opt, "framesize", level.framesize) != 200 ||
+      sendControl(opt, "quality", level.quality) != 200) {
+    printf("  control request failed\n");
+  }
+}
+
+static int phaseAt(const Options& opt, uint32_t sec) {
+  int index = 0;
+  for (size_t i = 0; i < opt.schedule.size(); i++) {
+    if (opt.schedule[i].startSec <= sec) {
+      index = (int)i;
+    }
+  }
+  return index;
+}
+
+static uint32_t phaseEnd(const Options& opt, int index) {
+  return index + 1 < (int)opt.schedule.size() ? opt.schedule[index + 1].startSec : opt.seconds;
+}
+
+static std::vector<PhaseResult> run(const Options& opt, PreviewBitrateController& controller) {
+  std::vector<PhaseResult> phases(opt.schedule.size());
+  std::vector<uint8_t> frame(FRAME_CAPACITY);
+  uint8_t chunk[READ_CHUNK_SIZE];
+  MultipartMjpegReader reader;
+
+  PreviewAdaptConfig config;
+  config.targetFps = opt.targetFps;
+  controller.begin(ladder, LADDER_COUNT, LADDER_START, config);
+  applyLevel(opt, ladder[LADDER_START]);
+
+  int fd = -1;
+  int phase = -1;
+  uint32_t start = millis();
+  uint32_t windowStart = start;
+  uint32_t windowFrames = 0;
+  uint32_t windowBytes = 0;
+  uint64_t windowDecodeUs = 0;
+
+  while (millis() - start < opt.seconds * 1000) {
+    uint32_t sec = (millis() - start) / 1000;
+    int p = phaseAt(opt, sec);
+    if (p != phase) {
+      phase = p;
+      sendControl(opt, "bandwidth_kbps", opt.schedule[p].kbps);
+      printf("  %3u s: link %d kbps, RSSI %d dBm\n", sec, opt.schedule[p].kbps, opt.schedule[p].rssi);
+    }
+
+    if (fd < 0) {
+      std::string contentType;
+      bool chunked;
+      fd = openStream(opt, contentType, chunked);
+      if (fd < 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        continue;
+      }
+      reader.begin(contentType.c_str(), chunked);
+      reader.setBuffer(frame.data(), frame.size());
+    }
+
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      close(fd);
+      fd = -1;
+      continue;
+    }
+    if (n > 0) {
+      windowBytes += (uint32_t)n;
+      size_t offset = 0;
+      while (offset < (size_t)n) {
+        offset += reader.feed(chunk + offset, n - offset);
+        if (reader.frameReady()) {
+          int width = 0, height = 0;
+          parseJpegSize(reader.frameData(), reader.frameSize(), width, height);
+          reader.consumeFrame();
+          windowFrames++;
+          // 解码耗时按像素数折算
+          windowDecodeUs += (uint64_t)width * height * opt.decodeNsPerPx / 1000;
+        }
+      }
+    }
+
+    uint32_t now = millis();
+    if (now - windowStart < WINDOW_MS) {
+      continue;
+    }
+    PreviewSample sample;
+    sample.windowMs = now - windowStart;
+    sample.frames = windowFrames;
+    sample.bytes = windowBytes;
+    sample.decodeAvgUs = windowFrames ? (uint32_t)(windowDecodeUs / windowFrames) : 0;
+    sample.rssi = opt.schedule[phase].rssi;
+    windowStart = now;
+    windowFrames = 0;
+    windowBytes = 0;
+    windowDecodeUs = 0;
+
+    PhaseResult& r = phases[phase];
+    uint32_t phaseSec = (now - start) / 1000 - opt.schedule[phase].startSec;
+    bool tail = phaseSec * 2 >= phaseEnd(opt, phase) - opt.schedule[phase].startSec;
+    r.windows++;
+    r.frames += sample.frames;
+    if (tail) {
+      r.tailWindows++;
+      r.tailFrames += sample.frames;
+      r.tailAtLevel[controller.level()]++;
+    }
+
+    if (opt.fixed) {
+      continue;
+    }
+    int before = controller.level();
+    if (controller.update(sample, now)) {
+      const PreviewLevel& level = controller.currentLevel();
+      printf("  %3u s: %.1f fps, %u KB/s -> level %d (framesize %d, quality %d)%s\n",
+             (now - start) / 1000, sample.frames * 1000.0 / sample.windowMs,
+             (unsigned)(sample.bytes / sample.windowMs), controller.level(), level.framesize,
+             level.quality, controller.level() > before ? " up" : " down");
+      applyLevel(opt, level);
+      r.changes++;
+      r.lastChangeSec = phaseSec;
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  return phases;
+}
+
+// "起始秒:kbps[:RSSI],..."
+static bool parseSchedule(const char* text, std::vector<Phase>& schedule) {
+  schedule.clear();
+  std::string s = text;
+  size_t pos = 0;
+  while (pos < s.size()) {
+    size_t end = s.find(',', pos);
+    if (end == std::string::npos) {
+      end = s.size();
+    }
+    Phase phase = {0, 0, -55};
+    int fields = sscanf(s.substr(pos, end - pos).c_str(), "%u:%d:%d", &phase.startSec, &phase.kbps, &phase.rssi);
+    if (fields < 2 || (!schedule.empty() && phase.startSec <= schedule.back().startSec)) {
+      return false;
+    }
+    schedule.push_back(phase);
+    pos = end + 1;
+  }
+  return !schedule.empty() && schedule[0].startSec == 0;
+}
+
+static bool parseArgs(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--fixed") {
+      opt.fixed = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (arg == "--host") {
+      opt.host = argv[++i];
+    } else if (arg == "--port") {
+      opt.port = atoi(argv[++i]);
+    } else if (arg == "--seconds") {
+      opt.seconds = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--target-fps") {
+      opt.targetFps = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--decode-ns-per-px") {
+      opt.decodeNsPerPx = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--schedule") {
+      if (!parseSchedule(argv[++i], opt.schedule)) {
+        return false;
+      }
+    } else {
+      return false;
+    }
+  }
+  return opt.seconds > opt.schedule.back().startSec && opt.targetFps > 0;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    printf("usage: %s --host H --port P [--seconds N] [--target-fps N] [--decode-ns-per-px N] "
+           "[--schedule SEC:KBPS[:RSSI],...] [--fixed]\n", argv[0]);
+    return 2;
+  }
+
+  printf("%s, target %u fps, %u s\n", opt.fixed ? "fixed framesize 6 quality 0" : "adaptive",
+         opt.targetFps, opt.seconds);
+  PreviewBitrateController controller;
+  std::vector<PhaseResult> phases = run(opt, controller);
+  // 恢复不限速，方便接着运行下一次
+  sendControl(opt, "bandwidth_kbps", 0);
+
+  int failures = 0;
+  printf("phase  link kbps  fps   tail fps  tail level (share)  changes  settled after\n");
+  for (size_t i = 0; i < phases.size(); i++) {
+    const PhaseResult& r = phases[i];
+    int mode = 0;
+    for (int l = 1; l < LADDER_COUNT; l++) {
+      if (r.tailAtLevel[l] > r.tailAtLevel[mode]) {
+        mode = l;
+      }
+    }
+    double fps = r.windows ? r.frames * 1000.0 / (r.windows * WINDOW_MS) : 0;
+    double tailFps = r.tailWindows ? r.tailFrames * 1000.0 / (r.tailWindows * WINDOW_MS) : 0;
+    uint32_t share = r.tailWindows ? r.tailAtLevel[mode] * 100 / r.tailWindows : 0;
+    printf("%5zu  %9d  %4.1f  %8.1f  %10d (%3u%%)  %7u  %10u s\n", i, opt.schedule[i].kbps, fps, tailFps,
+           opt.fixed ? LADDER_START : mode, opt.fixed ? 100 : share, r.changes, r.lastChangeSec);
+
+    if (opt.fixed || r.tailWindows == 0) {
+      continue;
+    }
+    if (share < 75) {
+      printf("FAIL: phase %zu did not settle (%u%% of the second half at level %d)\n", i, share, mode);
+      failures++;
+    }
+    if (tailFps < opt.targetFps * 0.85 && mode > 0) {
+      printf("FAIL: phase %zu held %.1f fps above the lowest level\n", i, tailFps);
+      failures++;
+    }
+  }
+  printf("windows %u, steps up %u, down %u, failed probes %u, held by RSSI %u, by decode %u\n",
+         controller.windows, controller.stepsUp, controller.stepsDown, controller.failedProbes,
+         controller.rssiHeld, controller.decodeHeld);
+
+  if (failures) {
+    return 1;
+  }
+  if (!opt.fixed) {
+    printf("all checks passed\n");
+  }
+  return 0;
+}
@@ -0,0 +1,300 @@
+// 预览缩放解码基准（主机端）：完整解码后居中裁切到屏幕 与 按preview_scale.h选的比例缩小解码 对比
+// 设备上用JPEGDEC的JPEG_SCALE_HALF/QUARTER/EIGHTH，主机上没有JPEGDEC，改用libjpeg的scale_denom
+// （同样在IDCT阶段缩小，1/8时每个8x8块只取DC），绝对耗时与ESP32不同，比例可作参考。
+// 每帧按三种方式解码并转成RGB565写进240x135的屏幕缓冲：
+//   full+crop  原来的做法：drawJpg按原尺寸解码，超出屏幕的部分丢弃
+//   fit        PREVIEW_MODE_FIT：缩小到完整视野放得进屏幕
+//   crop       PREVIEW_MODE_CROP：仍能铺满屏幕的最小缩放，居中裁切
+// 输出每种方式每帧耗时、帧率、解码像素数和相对full+crop的加速比，
+// 并检查解码器输出的尺寸与computePreviewPlacement算出的宽高一致。
+// 默认用合成的画面（渐变+噪声，按相机的framesize编码）；--frames读取目录下的*.jpg（例如从相机录下的帧）
+//
+// 编译与运行（需要libjpeg开发包）：
+//   g++ -std=c++17 -O2 -Iinclude tools/preview_scale_bench.cpp -o preview_scale_bench -ljpeg
+//   ./preview_scale_bench --quality 80
+//   ./preview_scale_bench --frames /tmp/frames
+
+#include <algorithm>
+#include <chrono>
+#include <dirent.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <strings.h>
+#include <vector>
+#include <jpeglib.h>
+#include "camera_framesize.h"
+#include "preview_scale.h"
+
+#define SCREEN_WIDTH 240   // Cardputer屏幕
+#define SCREEN_HEIGHT 135
+
+typedef std::vector<uint8_t> Bytes;
+
+struct Options {
+  int quality = 80;
+  double minSeconds = 0.3;   // 每种组合至少计时这么久
+  std::string frames;
+};
+
+struct Sample {
+  std::string name;
+  Bytes jpeg;
+};
+
+struct JpegError {
+  jpeg_error_mgr mgr;
+  jmp_buf jump;
+};
+
+static void onJpegError(j_common_ptr cinfo) {
+  longjmp(((JpegError*)cinfo->err)->jump, 1);
+}
+
+// 合成画面：水平/垂直渐变加少量噪声，接近相机画面的压缩率
+static Bytes encodeSynthetic(int width, int height, int quality) {
+  std::vector<uint8_t> rgb((size_t)width * height * 3);
+  uint32_t seed = 1;
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < width; x++) {
+      seed = seed * 1103515245u + 12345u;
+      int noise = (int)((seed >> 16) & 15) - 8;
+      uint8_t* p = &rgb[((size_t)y * width + x) * 3];
+      p[0] = (uint8_t)std::min(255, std::max(0, x * 255 / width + noise));
+      p[1] = (uint8_t)std::min(255, std::max(0, y * 255 / height + noise));
+      p[2] = (uint8_t)std::min(255, std::max(0, ((x / 16 + y / 16) & 1) * 96 + 64 + noise));
+    }
+  }
+
+  jpeg_compress_struct cinfo;
+  jpeg_error_mgr jerr;
+  cinfo.err = jpeg_std_error(&jerr);
+  jpeg_create_compress(&cinfo);
+  unsigned char* out = nullptr;
+  unsigned long outSize = 0;
+  jpeg_mem_dest(&cinfo, &out, &outSize);
+  cinfo.image_width = width;
+  cinfo.image_height = height;
+  cinfo.input_components = 3;
+  cinfo.in_color_space = JCS_RGB;
+  jpeg_set_defaults(&cinfo);
+  jpeg_set_quality(&cinfo, quality, TRUE);
+  jpeg_start_compress(&cinfo, TRUE);
+  while (cinfo.next_scanline < cinfo.image_height) {
+    JSAMPROW row = &rgb[(size_t)cinfo.next_scanline * width * 3];
+    jpeg_write_scanlines(&cinfo, &row, 1);
+  }
+  jpeg_finish_compress(&cinfo);
+  Bytes jpeg(out, out + outSize);
+  jpeg_destroy_compress(&cinfo);
+  free(out);
+  return jpeg;
+}
+
+struct DecodeResult {
+  bool ok = false;
+  int width = 0;    // 解码输出尺寸
+  int height = 0;
+};
+
+// 按1/scale解码，输出按(x, y)摆放到屏幕缓冲（RGB565，超出屏幕的像素丢弃）
+static DecodeResult decodeToScreen(const Bytes& jpeg, int scale, int x, int y, uint16_t* screen) {
+  DecodeResult r;
+  jpeg_decompress_struct cinfo;
+  JpegError jerr;
+  cinfo.err = jpeg_std_error(&jerr.mgr);
+  jerr.mgr.error_exit = onJpegError;
+  if (setjmp(jerr.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return r;
+  }
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+  jpeg_read_header(&cinfo, TRUE);
+  cinfo.out_color_space = JCS_RGB;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = scale;
+  jpeg_start_decompress(&cinfo);
+  r.width = cinfo.output_width;
+  r.height = cinfo.output_height;
+
+  std::vector<uint8_t> row((size_t)cinfo.output_width * 3);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    int sy = y + (int)cinfo.output_scanline;
+    JSAMPROW rows[1] = {row.data()};
+    jpeg_read_scanlines(&cinfo, rows, 1);
+    if (sy < 0 || sy >= SCREEN_HEIGHT) {
+      continue;
+    }
+    for (int ix = 0; ix < r.width; ix++) {
+      int sx = x + ix;
+      if (sx < 0 || sx >= SCREEN_WIDTH) {
+        continue;
+      }
+      const uint8_t* p = &row[ix * 3];
+      screen[sy * SCREEN_WIDTH + sx] = (uint16_t)(((p[0] & 0xF8) << 8) | ((p[1] & 0xFC) << 3) | (p[2] >> 3));
+    }
+  }
+  jpeg_finish_decompress(&cinfo);
+  jpeg_destroy_decompress(&cinfo);
+  r.ok = true;
+  return r;
+}
+
+static bool readSize(const Bytes& jpeg, int& width, int& height) {
+  jpeg_decompress_struct cinfo;
+  JpegError jerr;
+  cinfo.err = jpeg_std_error(&jerr.mgr);
+  jerr.mgr.error_exit = onJpegError;
+  if (setjmp(jerr.jump)) {
+    jpeg_destroy_decompress(&cinfo);
+    return false;
+  }
+  jpeg_create_decompress(&cinfo);
+  jpeg_mem_src(&cinfo, jpeg.data(), jpeg.size());
+  jpeg_read_header(&cinfo, TRUE);
+  width = cinfo.image_width;
+  height = cinfo.image_height;
+  jpeg_destroy_decompress(&cinfo);
+  return true;
+}
+
+struct ModeResult {
+  double usPerFrame = 0;
+  uint64_t pixels = 0;   // 每帧解码输出的像素数
+  bool sizeMatches = true;
+};
+
+static ModeResult runMode(const Bytes& jpeg, int scale, int x, int y, int expectW, int expectH,
+                          double minSeconds) {
+  static uint16_t screen[SCREEN_WIDTH * SCREEN_HEIGHT];
+  ModeResult m;
+  DecodeResult first = decodeToScreen(jpeg, scale, x, y, screen);
+  if (!first.ok) {
+    m.sizeMatches = false;
+    return m;
+  }
+  m.pixels = (uint64_t)first.width * first.height;
+  m.sizeMatches = first.width == expectW && first.height == expectH;
+
+  int frames = 0;
+  double seconds = 0;
+  while (seconds < minSeconds) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 20; i++) {
+      decodeToScreen(jpeg, scale, x, y, screen);
+    }
+    seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    frames += 20;
+  }
+  m.usPerFrame = seconds * 1e6 / frames;
+  return m;
+}
+
+static bool runSample(const Sample& s, double minSeconds) {
+  int width = 0, height = 0;
+  if (!readSize(s.jpeg, width, height)) {
+    printf("%-22s not a readable JPEG\n", s.name.c_str());
+    return false;
+  }
+  printf("%-22s %dx%d, %zu bytes\n", s.name.c_str(), width, height, s.jpeg.size());
+
+  // 原来的做法：原尺寸解码，居中摆放，超出屏幕的丢弃
+  ModeResult full = runMode(s.jpeg, 1, (SCREEN_WIDTH - width) / 2, (SCREEN_HEIGHT - height) / 2, width, height,
+                            minSeconds);
+  printf("  %-10s 1/1 %8.0f us %7.1f fps  %7llu px\n", "full+crop", full.usPerFrame, 1e6 / full.usPerFrame,
+         (unsigned long long)full.pixels);
+  bool ok = full.sizeMatches;
+
+  struct {
+    const char* name;
+    PreviewMode mode;
+  } modes[] = {{"fit", PREVIEW_MODE_FIT}, {"crop", PREVIEW_MODE_CROP}};
+  for (const auto& mode : modes) {
+    PreviewPlacement p = computePreviewPlacement(width, height, SCREEN_WIDTH, SCREEN_HEIGHT, mode.mode);
+    ModeResult m = runMode(s.jpeg, p.scale, p.x, p.y, p.width, p.height, minSeconds);
+    printf("  %-10s 1/%d %8.0f us %7.1f fps  %7llu px  x%.1f%s\n", mode.name, p.scale, m.usPerFrame,
+           1e6 / m.usPerFrame, (unsigned long long)m.pixels, full.usPerFrame / m.usPerFrame,
+           m.sizeMatches ? "" : "  SIZE MISMATCH");
+    ok &= m.sizeMatches;
+  }
+  return ok;
+}
+
+static bool loadFrames(const std::string& dir, std::vector<Sample>& samples) {
+  DIR* d = opendir(dir.c_str());
+  if (!d) {
+    perror(dir.c_str());
+    return false;
+  }
+  std::vector<std::string> names;
+  while (dirent* e = readdir(d)) {
+    std::string name = e->d_name;
+    if (name.size() > 4 && strcasecmp(name.c_str() + name.size() - 4, ".jpg") == 0) {
+      names.push_back(name);
+    }
+  }
+  closedir(d);
+  std::sort(names.begin(), names.end());
+  for (const std::string& name : names) {
+    FILE* f = fopen((dir + "/" + name).c_str(), "rb");
+    if (!f) {
+      continue;
+    }
+    Sample s;
+    s.name = name;
+    uint8_t buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+      s.jpeg.insert(s.jpeg.end(), buf, buf + n);
+    }
+    fclose(f);
+    samples.push_back(s);
+  }
+  return !samples.empty();
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--quality") { opt.quality = atoi(value); i++; }
+    else if (arg == "--seconds") { opt.minSeconds = atof(value); i++; }
+    else if (arg == "--frames") { opt.frames = value; i++; }
+    else {
+      fprintf(stderr, "usage: %s [--quality Q] [--seconds S] [--frames DIR]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  std::vector<Sample> samples;
+  if (!opt.frames.empty()) {
+    if (!loadFrames(opt.frames, samples)) {
+      fprintf(stderr, "no *.jpg frames in %s\n", opt.frames.c_str());
+      return 2;
+    }
+  } else {
+    // 预览、快速快门、连拍/timelapse和拍照用到的framesize
+    static const int framesizes[] = {6, 8, 10, 13};
+    for (int framesize : framesizes) {
+      int width = 0, height = 0;
+      framesizeDimensions(framesize, width, height);
+      char name[32];
+      snprintf(name, sizeof(name), "framesize %d", framesize);
+      samples.push_back({name, encodeSynthetic(width, height, opt.quality)});
+    }
+  }
+
+  printf("screen %dx%d\n", SCREEN_WIDTH, SCREEN_HEIGHT);
+  bool ok = true;
+  for (const Sample& s : samples) {
+    ok &= runSample(s, opt.minSeconds);
+  }
+  if (!ok) {
+    printf("FAILED\n");
+  }
+  return ok ? 0 : 1;
+}
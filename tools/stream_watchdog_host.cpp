@@ -0,0 +1,368 @@
+// 串流卡住检测的Linux版本：与固件使用同一套multipart_reader.h/stream_watchdog.h，
+// 按固件serviceStream的流程连接相机（真实UnitCamS3或tools/mock_unitcam.py）读取MJPEG流，
+// 超过--stall-ms没有新帧即断开并按退避重连。配合模拟服务器的--stall-every注入卡住，
+// 输出卡住次数、恢复时间和最长画面冻结；--legacy为原来的做法（只在连接断开时重连，连接失败等2秒）作为对照。
+// 检查（未指定--legacy时）：每次注入的卡住都被检测到并恢复，最长冻结不超过 stall + 退避上限 + 1秒。
+// --switch-every 秒数 每隔这么久在6（320x240）和8（400x296）之间切换framesize，与固件快速快门模式的切换相同：
+// 串流保持连接，按每帧SOF的尺寸判断切换完成，输出 控制请求到第一帧新分辨率 的延迟；
+// --switch-restart 为原来的做法（断开串流、等500ms、重连）作为对照。
+//
+// 编译与运行：
+//   python3 tools/mock_unitcam.py --port 8080 --stall-every 5 --stall-ms 0 --refuse-ms 300 &
+//   g++ -std=c++17 -O2 -Iinclude tools/stream_watchdog_host.cpp -o stream_watchdog_host
+//   ./stream_watchdog_host --host 127.0.0.1 --port 8080 --seconds 30
+//   ./stream_watchdog_host --host 127.0.0.1 --port 8080 --seconds 30 --legacy
+//   python3 tools/mock_unitcam.py --port 8080 --switch-delay-ms 80 &
+//   ./stream_watchdog_host --host 127.0.0.1 --port 8080 --seconds 30 --switch-every 2
+//   ./stream_watchdog_host --host 127.0.0.1 --port 8080 --seconds 30 --switch-every 2 --switch-restart
+
+#include <chrono>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <strings.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+#include "jpeg_utils.h"
+#include "multipart_reader.h"
+#include "resolution_switch.h"
+#include "stream_watchdog.h"
+
+#define READ_CHUNK_SIZE 4096        // 与固件MJPEG_READ_CHUNK_SIZE相同
+#define FRAME_CAPACITY (70 * 1024)  // 与固件GLOBAL_MAX_JPEG_SIZE相同
+#define SWITCH_TIMEOUT_MS 2000      // 与固件RESOLUTION_SWITCH_TIMEOUT_MS相同
+#define LEGACY_RESTART_MS 500       // 原来重连前固定等待的时间
+
+static uint32_t millis() {
+  using namespace std::chrono;
+  return (uint32_t)duration_cast<milliseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+struct Options {
+  std::string host = "192.168.4.1";
+  int port = 80;
+  uint32_t seconds = 30;
+  uint32_t stallMs = 1500;
+  uint32_t backoffMinMs = 20;
+  uint32_t backoffMaxMs = 2000;
+  bool legacy = false;
+  uint32_t switchEverySec = 0;
+  bool switchRestart = false;
+};
+
+// 连接到相机，返回socket（阻塞），失败返回-1
+static int connectCamera(const Options& opt) {
+  addrinfo hints = {};
+  hints.ai_family = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* res = nullptr;
+  if (getaddrinfo(opt.host.c_str(), std::to_string(opt.port).c_str(), &hints, &res) != 0) {
+    return -1;
+  }
+  int fd = socket(res->ai_family, res->ai_socktype, res->ai_protocol);
+  if (fd < 0 || connect(fd, res->ai_addr, res->ai_addrlen) != 0) {
+    freeaddrinfo(res);
+    if (fd >= 0) {
+      close(fd);
+    }
+    return -1;
+  }
+  freeaddrinfo(res);
+  return fd;
+}
+
+// 发送控制命令，返回状态码，出错返回-1
+static int sendControl(const Options& opt, const char* var, int value) {
+  int fd = connectCamera(opt);
+  if (fd < 0) {
+    return -1;
+  }
+  std::string req = "GET /api/v1/control?var=" + std::string(var) + "&val=" + std::to_string(value) +
+                    " HTTP/1.1\r\nHost: " + opt.host + "\r\nConnection: close\r\n\r\n";
+  send(fd, req.data(), req.size(), 0);
+  char head[256];
+  ssize_t n = recv(fd, head, sizeof(head) - 1, 0);
+  close(fd);
+  if (n <= 0) {
+    return -1;
+  }
+  head[n] = '\0';
+  int status = -1;
+  sscanf(head, "HTTP/1.%*d %d", &status);
+  return status;
+}
+
+// 连接并发送串流请求，读完响应头；返回socket（非阻塞），失败返回-1
+static int openStream(const Options& opt, int& status, std::string& contentType, bool& chunked) {
+  status = -1;
+  int fd = connectCamera(opt);
+  if (fd < 0) {
+    return -1;
+  }
+
+  timeval tv = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  std::string req = "GET /api/v1/stream HTTP/1.1\r\nHost: " + opt.host +
+                    "\r\nUser-Agent: M5Cardputer\r\nConnection: keep-alive\r\n\r\n";
+  send(fd, req.data(), req.size(), 0);
+
+  std::string head;
+  char c;
+  while (head.size() < 4096 && recv(fd, &c, 1, 0) == 1) {
+    head += c;
+    if (head.size() >= 4 && head.compare(head.size() - 4, 4, "\r\n\r\n") == 0) {
+      break;
+    }
+  }
+  sscanf(head.c_str(), "HTTP/1.%*d %d", &status);
+  if (status != 200) {
+    close(fd);
+    return -1;
+  }
+
+  contentType.clear();
+  chunked = false;
+  size_t pos = 0;
+  while (pos < head.size()) {
+    size_t end = head.find("\r\n", pos);
+    if (end == std::string::npos) {
+      break;
+    }
+    std::string line = head.substr(pos, end - pos);
+    pos = end + 2;
+    if (strncasecmp(line.c_str(), "Content-Type:", 13) == 0) {
+      size_t v = line.find_first_not_of(' ', 13);
+      contentType = v == std::string::npos ? "" : line.substr(v);
+    } else if (strncasecmp(line.c_str(), "Transfer-Encoding:", 18) == 0) {
+      chunked = line.find("chunked") != std::string::npos;
+    }
+  }
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+struct RunResult {
+  uint32_t frames = 0;
+  uint32_t reconnects = 0;
+  uint32_t longestFreezeMs = 0;   // 包括运行结束时仍在冻结的时间
+};
+
+static RunResult run(const Options& opt, StreamWatchdog& watchdog, ResolutionSwitch& resolution) {
+  std::vector<uint8_t> frame(FRAME_CAPACITY);
+  uint8_t chunk[READ_CHUNK_SIZE];
+  MultipartMjpegReader reader;
+  RunResult result;
+
+  watchdog.begin(opt.stallMs, opt.backoffMinMs, opt.backoffMaxMs);
+  int fd = -1;
+  uint32_t start = millis();
+  uint32_t lastFrame = start;
+  uint32_t lastReport = start;
+  uint32_t lastFrames = 0;
+  uint32_t lastSwitch = start;
+  int framesize = 6;
+  sendControl(opt, "framesize", framesize);
+
+  while (millis() - start < opt.seconds * 1000) {
+    uint32_t now = millis();
+    if (now - lastReport >= 5000) {
+      printf("  %3u s: %.1f fps, stalls %u, reconnects %u, backoff %u ms\n", (now - start) / 1000,
+             (result.frames - lastFrames) * 1000.0 / (now - lastReport), watchdog.stalls,
+             result.reconnects, watchdog.currentBackoffMs());
+      lastReport = now;
+      lastFrames = result.frames;
+    }
+
+    // 与固件setFastShutterMode相同：发出framesize命令，串流保持连接；对照组断开后等500ms重连
+    if (opt.switchEverySec && now - lastSwitch >= opt.switchEverySec * 1000) {
+      lastSwitch = now;
+      framesize = framesize == 6 ? 8 : 6;
+      resolution.request(framesize, now);
+      if (sendControl(opt, "framesize", framesize) != 200) {
+        printf("  framesize %d: control request failed\n", framesize);
+      }
+      if (opt.switchRestart) {
+        if (fd >= 0) {
+          close(fd);
+          fd = -1;
+        }
+        watchdog.restart(millis(), LEGACY_RESTART_MS);
+      }
+    }
+
+    if (fd < 0) {
+      // 新做法：按看门狗的退避时间重连；旧做法：立即重连，失败等2秒
+      if (!opt.legacy && !watchdog.retryDue(now)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        continue;
+      }
+      int status;
+      std::string contentType;
+      bool chunked;
+      fd = openStream(opt, status, contentType, chunked);
+      if (fd < 0) {
+        watchdog.connectFailed(millis());
+        if (opt.legacy) {
+          std::this_thread::sleep_for(std::chrono::milliseconds(2000));
+        }
+        continue;
+      }
+      result.reconnects++;
+      reader.begin(contentType.c_str(), chunked);
+      reader.setBuffer(frame.data(), frame.size());
+      watchdog.connected(millis());
+      resolution.noteReconnect();
+      continue;
+    }
+
+    pollfd pfd = {fd, POLLIN, 0};
+    poll(&pfd, 1, 10);
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      // 对方关闭连接
+      close(fd);
+      fd = -1;
+      watchdog.dropped(millis());
+      continue;
+    }
+    if (n > 0) {
+      watchdog.noteBytes((uint32_t)n);
+      size_t offset = 0;
+      while (offset < (size_t)n) {
+        offset += reader.feed(chunk + offset, n - offset);
+        if (reader.frameReady()) {
+          int width = 0, height = 0;
+          parseJpegSize(reader.frameData(), reader.frameSize(), width, height);
+          reader.consumeFrame();
+          uint32_t t = millis();
+          if (resolution.frame(width, height, t)) {
+            printf("  first %dx%d frame %u ms after request (%s)\n", width, height, resolution.lastLatencyMs,
+                   resolution.lastWasLive ? "live" : "reconnect");
+          }
+          if (t - lastFrame > result.longestFreezeMs) {
+            result.longestFreezeMs = t - lastFrame;
+          }
+          lastFrame = t;
+          result.frames++;
+          watchdog.noteFrame(t);
+        }
+      }
+    }
+
+    // 旧做法连接还在就一直等
+    if (!opt.legacy && watchdog.stalled(millis())) {
+      close(fd);
+      fd = -1;
+      watchdog.stallDetected(millis());
+    } else if (resolution.timedOut(millis(), SWITCH_TIMEOUT_MS)) {
+      close(fd);
+      fd = -1;
+      watchdog.restart(millis(), 0);
+    }
+  }
+  if (fd >= 0) {
+    close(fd);
+  }
+  uint32_t tail = millis() - lastFrame;
+  if (tail > result.longestFreezeMs) {
+    result.longestFreezeMs = tail;
+  }
+  return result;
+}
+
+static bool parseArgs(int argc, char** argv, Options& opt) {
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--legacy") {
+      opt.legacy = true;
+      continue;
+    }
+    if (arg == "--switch-restart") {
+      opt.switchRestart = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      return false;
+    }
+    if (arg == "--host") {
+      opt.host = argv[++i];
+    } else if (arg == "--port") {
+      opt.port = atoi(argv[++i]);
+    } else if (arg == "--seconds") {
+      opt.seconds = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--stall-ms") {
+      opt.stallMs = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--backoff-min-ms") {
+      opt.backoffMinMs = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--backoff-max-ms") {
+      opt.backoffMaxMs = (uint32_t)atoi(argv[++i]);
+    } else if (arg == "--switch-every") {
+      opt.switchEverySec = (uint32_t)atoi(argv[++i]);
+    } else {
+      return false;
+    }
+  }
+  return opt.seconds > 0 && opt.stallMs > 0 && opt.backoffMinMs > 0 && opt.backoffMaxMs >= opt.backoffMinMs;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  if (!parseArgs(argc, argv, opt)) {
+    printf("usage: %s --host H --port P [--seconds N] [--stall-ms N] [--backoff-min-ms N] "
+           "[--backoff-max-ms N] [--legacy] [--switch-every S] [--switch-restart]\n", argv[0]);
+    return 2;
+  }
+
+  printf("%s, stall after %u ms, backoff %u..%u ms, %u s\n", opt.legacy ? "legacy" : "watchdog",
+         opt.stallMs, opt.backoffMinMs, opt.backoffMaxMs, opt.seconds);
+  StreamWatchdog watchdog;
+  ResolutionSwitch resolution;
+  RunResult r = run(opt, watchdog, resolution);
+
+  printf("frames %u, connects %u, stalls %u (with data %u), drops %u, connect failures %u\n",
+         r.frames, watchdog.connects, watchdog.stalls, watchdog.stallsWithData, watchdog.drops,
+         watchdog.connectFailures);
+  printf("recover avg %u ms, max %u ms (%u recoveries), longest freeze %u ms (watchdog %u ms)\n",
+         watchdog.recoverTime.averageUs() / 1000, watchdog.recoverTime.maxUs / 1000,
+         watchdog.recoverTime.count, r.longestFreezeMs, watchdog.longestFreezeMs);
+
+  if (resolution.requests) {
+    printf("switches %u: live avg %u ms, max %u ms (%u), reconnect avg %u ms, max %u ms (%u), "
+           "old frames %u, fallbacks %u\n", resolution.requests,
+           resolution.liveLatency.averageUs() / 1000, resolution.liveLatency.maxUs / 1000,
+           resolution.liveLatency.count, resolution.reconnectLatency.averageUs() / 1000,
+           resolution.reconnectLatency.maxUs / 1000, resolution.reconnectLatency.count,
+           resolution.oldFrames, resolution.fallbacks);
+  }
+
+  if (opt.legacy) {
+    return 0;
+  }
+  int failures = 0;
+  if (r.frames == 0) {
+    printf("FAIL: no frames received\n");
+    failures++;
+  }
+  if (watchdog.stalls + watchdog.drops > 0 && watchdog.recoverTime.count == 0) {
+    printf("FAIL: never recovered from a stall\n");
+    failures++;
+  }
+  if (r.longestFreezeMs > opt.stallMs + opt.backoffMaxMs + 1000) {
+    printf("FAIL: freeze of %u ms exceeds stall + max backoff + 1 s\n", r.longestFreezeMs);
+    failures++;
+  }
+  if (resolution.requests > 1 && resolution.liveLatency.count + resolution.reconnectLatency.count + 1 < resolution.requests) {
+    printf("FAIL: a framesize switch never produced a new-resolution frame\n");
+    failures++;
+  }
+  if (failures) {
+    return 1;
+  }
+  printf("all checks passed\n");
+  return 0;
+}
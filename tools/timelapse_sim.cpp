@@ -0,0 +1,170 @@
+// timelapse拍摄时刻仿真（主机端，假时钟，与固件使用同一个timelapse_schedule.h）
+// 按固件loop的结构运行：每轮刷新显示（固定开销），到点就拍摄（注入随机的拍摄耗时和偶发超时），
+// 然后等到下一个计划时刻或最多100ms。对比旧做法（上一张拍完后重新计时、固定delay(100)），
+// 输出每种间隔下的张数、跳过数、最后一张相对计划时刻的偏差（累积漂移）和最大延迟。
+// 检查：新调度每张的开始时间都落在 计划时刻 + 一轮loop开销 以内，且不随张数增长；
+// 时钟起点放在millis()回绕之前，同时检查回绕。
+//
+// 编译与运行：
+//   g++ -std=c++17 -O2 -Iinclude tools/timelapse_sim.cpp -o timelapse_sim
+//   ./timelapse_sim --shots 2000 --latency-ms 800 --latency-jitter-ms 1200 --spike-every 50
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "timelapse_schedule.h"
+
+#define LOOP_MS 100          // 与固件TIMELAPSE_LOOP_MS相同
+#define DISPLAY_COST_MS 3    // 每轮刷新显示、读按键的耗时
+
+struct Options {
+  int shots = 2000;
+  uint32_t latencyMs = 800;       // 拍摄耗时下限
+  uint32_t jitterMs = 1200;       // 在下限之上随机增加的耗时
+  int spikeEvery = 50;            // 每N张有一张耗时x4（WiFi重传、换AVI文件等），0为不注入
+};
+
+// 拍摄耗时序列（固定种子，新旧两种做法注入完全相同的耗时）
+class LatencySource {
+public:
+  explicit LatencySource(const Options& o) : opt(o) {}
+  uint32_t next() {
+    seed = seed * 1103515245u + 12345u;
+    uint32_t ms = opt.latencyMs + (opt.jitterMs ? (seed >> 8) % (opt.jitterMs + 1) : 0);
+    count++;
+    if (opt.spikeEvery > 0 && count % opt.spikeEvery == 0) {
+      ms *= 4;
+    }
+    return ms;
+  }
+
+private:
+  const Options& opt;
+  uint32_t seed = 12345;
+  uint32_t count = 0;
+};
+
+struct Result {
+  uint32_t shots = 0;
+  uint32_t skipped = 0;
+  int64_t finalDriftMs = 0;    // 最后一张开始时间 - 第一张计划时刻按间隔推算的时刻
+  uint32_t maxLateMs = 0;      // 按时的张（上一张拍完时还没到点）开始拍摄相对计划时刻的最大延迟
+  uint32_t maxLateFirstHalf = 0;
+  uint32_t maxLateSecondHalf = 0;
+  uint32_t catchUpShots = 0;   // 补拍的张（上一张拍完时已经过点）
+};
+
+// 新调度：与固件loop中timelapse分支相同
+static Result runScheduler(const Options& opt, uint32_t interval, TimelapseOverrun policy, uint32_t clockStart) {
+  LatencySource latency(opt);
+  TimelapseScheduler sched;
+  uint32_t now = clockStart;
+  sched.start(now, interval, policy, 3);
+  uint32_t origin = clockStart;
+  Result r;
+  bool onTime = true;
+  while ((int)sched.shots < opt.shots) {
+    now += DISPLAY_COST_MS;
+    if (sched.due(now)) {
+      uint32_t late = now - sched.dueMs();
+      if (!onTime) {
+        r.catchUpShots++;
+      } else {
+        uint32_t& half = (int)sched.shots < opt.shots / 2 ? r.maxLateFirstHalf : r.maxLateSecondHalf;
+        if (late > half) {
+          half = late;
+        }
+        if (late > r.maxLateMs) {
+          r.maxLateMs = late;
+        }
+      }
+      r.finalDriftMs = (int64_t)(int32_t)(now - (origin + sched.slotIndex() * interval));
+      sched.shotStarted(now);
+      now += latency.next();
+      sched.shotFinished(now);
+      onTime = !sched.due(now);
+    }
+    uint32_t wait = sched.msUntilDue(now);
+    if (wait > 0) {
+      now += wait < LOOP_MS ? wait : LOOP_MS;
+    }
+  }
+  r.shots = sched.shots;
+  r.skipped = sched.skipped;
+  return r;
+}
+
+// 旧做法：拍完（成功或失败）后把基准时间设为当前时间，loop固定delay(100)
+static Result runLegacy(const Options& opt, uint32_t interval, uint32_t clockStart) {
+  LatencySource latency(opt);
+  uint32_t now = clockStart;
+  uint32_t lastShot = now;
+  Result r;
+  while ((int)r.shots < opt.shots) {
+    now += DISPLAY_COST_MS;
+    if (now - lastShot >= interval) {
+      r.shots++;
+      r.finalDriftMs = (int64_t)(int32_t)(now - (clockStart + r.shots * interval));
+      now += latency.next();
+      lastShot = now;
+    }
+    now += LOOP_MS;
+  }
+  return r;
+}
+
+static bool runInterval(const Options& opt, uint32_t interval) {
+  // 起点放在millis()回绕前约1分钟，长间隔的仿真必然跨过回绕
+  const uint32_t clockStart = 0xFFFFFFFFu - 60000;
+  Result legacy = runLegacy(opt, interval, clockStart);
+  Result skip = runScheduler(opt, interval, TIMELAPSE_SKIP, clockStart);
+  Result catchUp = runScheduler(opt, interval, TIMELAPSE_CATCH_UP, clockStart);
+
+  printf("interval %8u ms | legacy: drift %+9.1f s (%+5lld ms/shot) | skip: drift %+lld ms, late max %u ms,"
+         " skipped %4u | catch-up: late max %u ms, caught up %4u, skipped %4u\n",
+         interval, legacy.finalDriftMs / 1000.0, (long long)(legacy.finalDriftMs / opt.shots),
+         (long long)skip.finalDriftMs, skip.maxLateMs, skip.skipped, catchUp.maxLateMs, catchUp.catchUpShots,
+         catchUp.skipped);
+
+  // 新调度：按时的张最多晚一轮显示开销，与张数无关（前后半程相同，没有累积）
+  bool ok = true;
+  for (const Result* r : {&skip, &catchUp}) {
+    ok &= r->maxLateMs <= DISPLAY_COST_MS;
+    ok &= r->maxLateFirstHalf == r->maxLateSecondHalf;
+  }
+  // skip策略下每一张都是按时的，最后一张仍在计划时刻之后一轮显示开销
+  ok &= skip.catchUpShots == 0 && skip.finalDriftMs == DISPLAY_COST_MS;
+  // 间隔远大于拍摄耗时的情况下两种策略都不应跳过或补拍
+  if (interval > (opt.latencyMs + opt.jitterMs) * 4) {
+    ok &= skip.skipped == 0 && catchUp.skipped == 0 && catchUp.catchUpShots == 0;
+  }
+  if (!ok) {
+    printf("  FAILED\n");
+  }
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    const char* value = i + 1 < argc ? argv[i + 1] : "";
+    if (arg == "--shots") { opt.shots = atoi(value); i++; }
+    else if (arg == "--latency-ms") { opt.latencyMs = atoi(value); i++; }
+    else if (arg == "--latency-jitter-ms") { opt.jitterMs = atoi(value); i++; }
+    else if (arg == "--spike-every") { opt.spikeEvery = atoi(value); i++; }
+    else {
+      fprintf(stderr, "usage: %s [--shots N] [--latency-ms L] [--latency-jitter-ms J] [--spike-every N]\n", argv[0]);
+      return 2;
+    }
+  }
+
+  printf("%d shots, capture %u-%u ms, x4 spike every %d shots, loop %d ms + %d ms display\n", opt.shots,
+         opt.latencyMs, opt.latencyMs + opt.jitterMs, opt.spikeEvery, LOOP_MS, DISPLAY_COST_MS);
+  bool ok = true;
+  const uint32_t intervals[] = {500, 1000, 2000, 5000, 10000, 60000, 600000, 3600000};
+  for (uint32_t interval : intervals) {
+    ok &= runInterval(opt, interval);
+  }
+  return ok ? 0 : 1;
+}